@@ -0,0 +1,577 @@
+// BlockCompression.cpp
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace wgpu;
+
+namespace {
+
+bool isBc(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::BC1RGBAUnorm:
+	case TextureFormat::BC1RGBAUnormSrgb:
+	case TextureFormat::BC3RGBAUnorm:
+	case TextureFormat::BC3RGBAUnormSrgb:
+	case TextureFormat::BC7RGBAUnorm:
+	case TextureFormat::BC7RGBAUnormSrgb:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool isEtc2(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::ETC2RGB8Unorm:
+	case TextureFormat::ETC2RGB8UnormSrgb:
+	case TextureFormat::ETC2RGB8A1Unorm:
+	case TextureFormat::ETC2RGB8A1UnormSrgb:
+	case TextureFormat::ETC2RGBA8Unorm:
+	case TextureFormat::ETC2RGBA8UnormSrgb:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool isAstc(TextureFormat format) {
+	return format == TextureFormat::ASTC4x4Unorm || format == TextureFormat::ASTC4x4UnormSrgb;
+}
+
+uint16_t readU16(const uint8_t* data) {
+	return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+void writeU16(uint8_t* data, uint16_t value) {
+	data[0] = value & 0xff;
+	data[1] = value >> 8;
+}
+
+void expand565(uint16_t color, uint8_t rgb[3]) {
+	uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+	rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+	rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+	rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+}
+
+uint16_t pack565(const uint8_t rgb[3]) {
+	uint32_t r = (rgb[0] * 31 + 127) / 255, g = (rgb[1] * 63 + 127) / 255, b = (rgb[2] * 31 + 127) / 255;
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// The 4 colors a BC1 color block picks from. In BC1, c0 <= c1 switches to 3 colors + transparent
+// black; BC3 color blocks always have 4.
+void colorPalette(uint16_t c0, uint16_t c1, bool alwaysFourColors, uint8_t palette[4][4]) {
+	expand565(c0, palette[0]);
+	expand565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+	for (int c = 0; c < 3; ++c) {
+		if (c0 > c1 || alwaysFourColors) {
+			palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+			palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+		}
+		else {
+			palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = (c0 > c1 || alwaysFourColors) ? 255 : 0;
+}
+
+void alphaPalette(uint8_t a0, uint8_t a1, uint8_t palette[8]) {
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1) {
+		for (int i = 1; i < 7; ++i) {
+			palette[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1) / 7);
+		}
+	}
+	else {
+		for (int i = 1; i < 5; ++i) {
+			palette[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1) / 5);
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// 8 bytes: two 565 endpoints, then 2 bit indices row by row
+void decodeColorBlock(const uint8_t* block, bool alwaysFourColors, uint8_t texels[16][4]) {
+	uint8_t palette[4][4];
+	colorPalette(readU16(block), readU16(block + 2), alwaysFourColors, palette);
+	uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+	for (int i = 0; i < 16; ++i) {
+		std::memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4);
+	}
+}
+
+// 8 bytes: two endpoints, then 3 bit indices
+void decodeAlphaBlock(const uint8_t* block, uint8_t texels[16][4]) {
+	uint8_t palette[8];
+	alphaPalette(block[0], block[1], palette);
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; ++i) {
+		indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+	}
+	for (int i = 0; i < 16; ++i) {
+		texels[i][3] = palette[(indices >> (3 * i)) & 7];
+	}
+}
+
+// ETC2 blocks are big endian, bit 63 is the top bit of the first byte
+uint64_t readU64BigEndian(const uint8_t* data) {
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+uint32_t bits(uint64_t value, int high, int low) {
+	return static_cast<uint32_t>((value >> low) & ((uint64_t(1) << (high - low + 1)) - 1));
+}
+
+uint8_t clampByte(int value) {
+	return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+uint8_t expandBits(uint32_t value, int count) {
+	return static_cast<uint8_t>((value << (8 - count)) | (value >> (2 * count - 8)));
+}
+
+void setTexel(uint8_t texel[4], const int rgb[3], uint8_t alpha = 255) {
+	for (int c = 0; c < 3; ++c) {
+		texel[c] = clampByte(rgb[c]);
+	}
+	texel[3] = alpha;
+}
+
+/**
+ * One ETC2 RGB block (ETC1 individual and differential modes, then T, H and planar, picked by
+ * which differential base overflows). With `punchthrough` (RGB8A1) the differential bit tells
+ * whether the block is opaque; if not, index 2 is transparent black and there is no individual mode.
+ */
+void decodeEtc2ColorBlock(const uint8_t* block, bool punchthrough, uint8_t texels[16][4]) {
+	static const int kModifiers[8][2] = {
+		{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+	};
+	static const int kDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+	uint64_t value = readU64BigEndian(block);
+	bool differential = punchthrough || bits(value, 33, 33);
+	bool opaque = !punchthrough || bits(value, 33, 33);
+	// texels are indexed column by column: i = 4 * x + y
+	auto index = [value](int i) { return static_cast<int>((bits(value, i + 16, i + 16) << 1) | bits(value, i, i)); };
+	auto texelAt = [texels](int i) { return texels[4 * (i & 3) + (i >> 2)]; };
+
+	int base[2][3];
+	if (!differential) {
+		for (int c = 0; c < 3; ++c) {
+			base[0][c] = expandBits(bits(value, 63 - 8 * c, 60 - 8 * c), 4);
+			base[1][c] = expandBits(bits(value, 59 - 8 * c, 56 - 8 * c), 4);
+		}
+	}
+	else {
+		int overflow = -1;
+		for (int c = 0; c < 3; ++c) {
+			int first = static_cast<int>(bits(value, 63 - 8 * c, 59 - 8 * c));
+			int delta = static_cast<int>(bits(value, 58 - 8 * c, 56 - 8 * c));
+			int second = first + (delta >= 4 ? delta - 8 : delta);
+			if (second < 0 || second > 31) {
+				overflow = c;
+				break;
+			}
+			base[0][c] = expandBits(first, 5);
+			base[1][c] = expandBits(second, 5);
+		}
+
+		if (overflow == 0 || overflow == 1) {
+			// T (red overflows) and H (green) modes: two colors and a distance make 4 paint colors
+			int first[3], second[3];
+			int distance;
+			if (overflow == 0) {
+				first[0] = (bits(value, 60, 59) << 2) | bits(value, 57, 56);
+				first[1] = bits(value, 55, 52);
+				first[2] = bits(value, 51, 48);
+				second[0] = bits(value, 47, 44);
+				second[1] = bits(value, 43, 40);
+				second[2] = bits(value, 39, 36);
+				distance = kDistances[(bits(value, 35, 34) << 1) | bits(value, 32, 32)];
+			}
+			else {
+				first[0] = bits(value, 62, 59);
+				first[1] = (bits(value, 58, 56) << 1) | bits(value, 52, 52);
+				first[2] = (bits(value, 51, 51) << 3) | bits(value, 49, 47);
+				second[0] = bits(value, 46, 43);
+				second[1] = bits(value, 42, 39);
+				second[2] = bits(value, 38, 35);
+				// the order of the two colors holds the last bit of the distance index
+				int order = (first[0] << 8 | first[1] << 4 | first[2]) >= (second[0] << 8 | second[1] << 4 | second[2]);
+				distance = kDistances[(bits(value, 34, 34) << 2) | (bits(value, 32, 32) << 1) | order];
+			}
+			int paint[4][3];
+			for (int c = 0; c < 3; ++c) {
+				first[c] = expandBits(first[c], 4);
+				second[c] = expandBits(second[c], 4);
+				if (overflow == 0) {
+					paint[0][c] = first[c];
+					paint[1][c] = second[c] + distance;
+					paint[2][c] = second[c];
+					paint[3][c] = second[c] - distance;
+				}
+				else {
+					paint[0][c] = first[c] + distance;
+					paint[1][c] = first[c] - distance;
+					paint[2][c] = second[c] + distance;
+					paint[3][c] = second[c] - distance;
+				}
+			}
+			for (int i = 0; i < 16; ++i) {
+				int paintIndex = index(i);
+				if (!opaque && paintIndex == 2) {
+					std::memset(texelAt(i), 0, 4);
+				}
+				else {
+					setTexel(texelAt(i), paint[paintIndex]);
+				}
+			}
+			return;
+		}
+
+		if (overflow == 2) {
+			// planar: a color at the origin and two more along x and y, interpolated. Always opaque
+			int origin[3] = {
+				expandBits(bits(value, 62, 57), 6),
+				expandBits((bits(value, 56, 56) << 6) | bits(value, 54, 49), 7),
+				expandBits((bits(value, 48, 48) << 5) | (bits(value, 44, 43) << 3) | bits(value, 41, 39), 6)
+			};
+			int horizontal[3] = {
+				expandBits((bits(value, 38, 34) << 1) | bits(value, 32, 32), 6),
+				expandBits(bits(value, 31, 25), 7),
+				expandBits(bits(value, 24, 19), 6)
+			};
+			int vertical[3] = {
+				expandBits(bits(value, 18, 13), 6),
+				expandBits(bits(value, 12, 6), 7),
+				expandBits(bits(value, 5, 0), 6)
+			};
+			for (int y = 0; y < 4; ++y) {
+				for (int x = 0; x < 4; ++x) {
+					int rgb[3];
+					for (int c = 0; c < 3; ++c) {
+						rgb[c] = (x * (horizontal[c] - origin[c]) + y * (vertical[c] - origin[c]) + 4 * origin[c] + 2) >> 2;
+					}
+					setTexel(texels[4 * y + x], rgb);
+				}
+			}
+			return;
+		}
+	}
+
+	// individual and differential modes: two 2x4 (or 4x2 when flipped) halves, each a base color
+	// moved by one of 4 modifiers of its table
+	bool flipped = bits(value, 32, 32);
+	const int* tables[2] = { kModifiers[bits(value, 39, 37)], kModifiers[bits(value, 36, 34)] };
+	for (int i = 0; i < 16; ++i) {
+		int x = i >> 2, y = i & 3;
+		int half = flipped ? (y >= 2) : (x >= 2);
+		int modifierIndex = index(i);
+		int modifier;
+		if (!opaque && modifierIndex == 2) {
+			std::memset(texelAt(i), 0, 4);
+			continue;
+		}
+		else if (!opaque && modifierIndex == 0) {
+			modifier = 0;
+		}
+		else {
+			modifier = tables[half][modifierIndex & 1];
+			if (modifierIndex & 2) modifier = -modifier;
+		}
+		int rgb[3] = { base[half][0] + modifier, base[half][1] + modifier, base[half][2] + modifier };
+		setTexel(texelAt(i), rgb);
+	}
+}
+
+// EAC alpha of ETC2 RGBA8: a base value and 16 3 bit indices into a scaled modifier table
+void decodeEacAlphaBlock(const uint8_t* block, uint8_t texels[16][4]) {
+	static const int kModifiers[16][8] = {
+		{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+		{ -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+		{ -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+		{ -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+		{ -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 },
+		{ -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+		{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 },
+		{ -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 }
+	};
+	uint64_t value = readU64BigEndian(block);
+	int base = static_cast<int>(bits(value, 63, 56));
+	int multiplier = static_cast<int>(bits(value, 55, 52));
+	const int* modifiers = kModifiers[bits(value, 51, 48)];
+	for (int i = 0; i < 16; ++i) {
+		// first texel in the top bits, column by column
+		int modifierIndex = static_cast<int>(bits(value, 47 - 3 * i, 45 - 3 * i));
+		texels[4 * (i & 3) + (i >> 2)][3] = clampByte(base + modifiers[modifierIndex] * multiplier);
+	}
+}
+
+void encodeColorBlock(const uint8_t texels[16][4], uint8_t* block) {
+	uint8_t low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 3; ++c) {
+			low[c] = std::min(low[c], texels[i][c]);
+			high[c] = std::max(high[c], texels[i][c]);
+		}
+	}
+	// pulling the endpoints in a little lowers the error of the colors in between
+	for (int c = 0; c < 3; ++c) {
+		int inset = (high[c] - low[c]) / 16;
+		low[c] = static_cast<uint8_t>(low[c] + inset);
+		high[c] = static_cast<uint8_t>(high[c] - inset);
+	}
+	uint16_t c0 = pack565(high), c1 = pack565(low);
+	if (c0 < c1) std::swap(c0, c1);
+
+	uint8_t palette[4][4];
+	colorPalette(c0, c1, true, palette);
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		for (int i = 0; i < 16; ++i) {
+			int best = 0, bestDistance = 1 << 30;
+			for (int p = 0; p < 4; ++p) {
+				int distance = 0;
+				for (int c = 0; c < 3; ++c) {
+					int d = texels[i][c] - palette[p][c];
+					distance += d * d;
+				}
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= static_cast<uint32_t>(best) << (2 * i);
+		}
+	}
+	writeU16(block, c0);
+	writeU16(block + 2, c1);
+	for (int i = 0; i < 4; ++i) {
+		block[4 + i] = (indices >> (8 * i)) & 0xff;
+	}
+}
+
+void encodeAlphaBlock(const uint8_t texels[16][4], uint8_t* block) {
+	uint8_t low = 255, high = 0;
+	for (int i = 0; i < 16; ++i) {
+		low = std::min(low, texels[i][3]);
+		high = std::max(high, texels[i][3]);
+	}
+	uint8_t palette[8];
+	alphaPalette(high, low, palette);
+	uint64_t indices = 0;
+	if (high != low) {
+		for (int i = 0; i < 16; ++i) {
+			int best = 0, bestDistance = 256;
+			for (int p = 0; p < 8; ++p) {
+				int distance = std::abs(texels[i][3] - palette[p]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= static_cast<uint64_t>(best) << (3 * i);
+		}
+	}
+	block[0] = high;
+	block[1] = low;
+	for (int i = 0; i < 6; ++i) {
+		block[2 + i] = (indices >> (8 * i)) & 0xff;
+	}
+}
+
+} // namespace
+
+TextureCompression TextureCompression::query(Adapter adapter) {
+	TextureCompression compression;
+	compression.bc = adapter.hasFeature(FeatureName::TextureCompressionBC);
+	compression.etc2 = adapter.hasFeature(FeatureName::TextureCompressionETC2);
+	compression.astc = adapter.hasFeature(FeatureName::TextureCompressionASTC);
+	return compression;
+}
+
+bool TextureCompression::supports(TextureFormat format) const {
+	if (isBc(format)) return bc;
+	if (isEtc2(format)) return etc2;
+	if (isAstc(format)) return astc;
+	return true;
+}
+
+uint32_t compressedBlockBytes(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::BC1RGBAUnorm:
+	case TextureFormat::BC1RGBAUnormSrgb:
+	case TextureFormat::ETC2RGB8Unorm:
+	case TextureFormat::ETC2RGB8UnormSrgb:
+	case TextureFormat::ETC2RGB8A1Unorm:
+	case TextureFormat::ETC2RGB8A1UnormSrgb:
+		return 8;
+	case TextureFormat::BC3RGBAUnorm:
+	case TextureFormat::BC3RGBAUnormSrgb:
+	case TextureFormat::BC7RGBAUnorm:
+	case TextureFormat::BC7RGBAUnormSrgb:
+	case TextureFormat::ETC2RGBA8Unorm:
+	case TextureFormat::ETC2RGBA8UnormSrgb:
+	case TextureFormat::ASTC4x4Unorm:
+	case TextureFormat::ASTC4x4UnormSrgb:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+const char* compressedFormatName(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::BC1RGBAUnorm:
+	case TextureFormat::BC1RGBAUnormSrgb:
+		return "BC1";
+	case TextureFormat::BC3RGBAUnorm:
+	case TextureFormat::BC3RGBAUnormSrgb:
+		return "BC3";
+	case TextureFormat::BC7RGBAUnorm:
+	case TextureFormat::BC7RGBAUnormSrgb:
+		return "BC7";
+	case TextureFormat::ETC2RGB8Unorm:
+	case TextureFormat::ETC2RGB8UnormSrgb:
+		return "ETC2 RGB8";
+	case TextureFormat::ETC2RGB8A1Unorm:
+	case TextureFormat::ETC2RGB8A1UnormSrgb:
+		return "ETC2 RGB8A1";
+	case TextureFormat::ETC2RGBA8Unorm:
+	case TextureFormat::ETC2RGBA8UnormSrgb:
+		return "ETC2 RGBA8";
+	case TextureFormat::ASTC4x4Unorm:
+	case TextureFormat::ASTC4x4UnormSrgb:
+		return "ASTC 4x4";
+	default:
+		return "RGBA8";
+	}
+}
+
+bool isSrgbFormat(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::RGBA8UnormSrgb:
+	case TextureFormat::BGRA8UnormSrgb:
+	case TextureFormat::BC1RGBAUnormSrgb:
+	case TextureFormat::BC3RGBAUnormSrgb:
+	case TextureFormat::BC7RGBAUnormSrgb:
+	case TextureFormat::ETC2RGB8UnormSrgb:
+	case TextureFormat::ETC2RGB8A1UnormSrgb:
+	case TextureFormat::ETC2RGBA8UnormSrgb:
+	case TextureFormat::ASTC4x4UnormSrgb:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool decompressBlocks(TextureFormat format, const uint8_t* blocks, size_t size, uint32_t width, uint32_t height,
+	Image& image) {
+	bool bc1 = format == TextureFormat::BC1RGBAUnorm || format == TextureFormat::BC1RGBAUnormSrgb;
+	bool bc3 = format == TextureFormat::BC3RGBAUnorm || format == TextureFormat::BC3RGBAUnormSrgb;
+	bool etc2Punchthrough = format == TextureFormat::ETC2RGB8A1Unorm || format == TextureFormat::ETC2RGB8A1UnormSrgb;
+	bool etc2Alpha = format == TextureFormat::ETC2RGBA8Unorm || format == TextureFormat::ETC2RGBA8UnormSrgb;
+	if (!bc1 && !bc3 && !isEtc2(format)) return false;
+	uint32_t blockBytes = compressedBlockBytes(format);
+	uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	if (size < static_cast<size_t>(blocksWide) * blocksHigh * blockBytes) return false;
+
+	image.width = width;
+	image.height = height;
+	image.bytesPerRow = (4 * width + 255) & ~255u;
+	image.pixels.resize(static_cast<size_t>(image.bytesPerRow) * height);
+	uint8_t texels[16][4];
+	for (uint32_t by = 0; by < blocksHigh; ++by) {
+		for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+			const uint8_t* block = blocks + (static_cast<size_t>(by) * blocksWide + bx) * blockBytes;
+			if (bc1) {
+				decodeColorBlock(block, false, texels);
+			}
+			else if (bc3) {
+				decodeColorBlock(block + 8, true, texels);
+				decodeAlphaBlock(block, texels);
+			}
+			else if (etc2Alpha) {
+				decodeEtc2ColorBlock(block + 8, false, texels);
+				decodeEacAlphaBlock(block, texels);
+			}
+			else {
+				decodeEtc2ColorBlock(block, etc2Punchthrough, texels);
+			}
+			// blocks on the right and bottom edges may hang over the image
+			for (uint32_t y = 0; y < 4 && 4 * by + y < height; ++y) {
+				for (uint32_t x = 0; x < 4 && 4 * bx + x < width; ++x) {
+					uint8_t* texel = &image.pixels[static_cast<size_t>(4 * by + y) * image.bytesPerRow + 4 * (4 * bx + x)];
+					std::memcpy(texel, texels[4 * y + x], 4);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool decompressImage(const CompressedImage& image, CompressedImage& decompressed) {
+	decompressed = CompressedImage();
+	decompressed.format = isSrgbFormat(image.format) ? TextureFormat::RGBA8UnormSrgb : TextureFormat::RGBA8Unorm;
+	decompressed.width = image.width;
+	decompressed.height = image.height;
+	Image level;
+	for (const CompressedImage::Level& blocks : image.levels) {
+		if (!decompressBlocks(image.format, image.data.data() + blocks.offset, blocks.size, blocks.width, blocks.height, level)) {
+			return false;
+		}
+		CompressedImage::Level texels;
+		texels.width = level.width;
+		texels.height = level.height;
+		texels.bytesPerRow = level.bytesPerRow;
+		texels.rows = level.height;
+		texels.offset = decompressed.data.size();
+		texels.size = level.pixels.size();
+		decompressed.data.insert(decompressed.data.end(), level.pixels.begin(), level.pixels.end());
+		decompressed.levels.push_back(texels);
+	}
+	return true;
+}
+
+bool compressBlocks(TextureFormat format, const Image& image, std::vector<uint8_t>& blocks) {
+	bool bc1 = format == TextureFormat::BC1RGBAUnorm || format == TextureFormat::BC1RGBAUnormSrgb;
+	bool bc3 = format == TextureFormat::BC3RGBAUnorm || format == TextureFormat::BC3RGBAUnormSrgb;
+	if ((!bc1 && !bc3) || image.width == 0 || image.height == 0) return false;
+	uint32_t blockBytes = compressedBlockBytes(format);
+	uint32_t blocksWide = (image.width + 3) / 4, blocksHigh = (image.height + 3) / 4;
+	blocks.resize(static_cast<size_t>(blocksWide) * blocksHigh * blockBytes);
+
+	uint8_t texels[16][4];
+	for (uint32_t by = 0; by < blocksHigh; ++by) {
+		for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+			// edge blocks repeat the last row / column
+			for (uint32_t y = 0; y < 4; ++y) {
+				for (uint32_t x = 0; x < 4; ++x) {
+					uint32_t sx = std::min(4 * bx + x, image.width - 1), sy = std::min(4 * by + y, image.height - 1);
+					std::memcpy(texels[4 * y + x], &image.pixels[static_cast<size_t>(sy) * image.bytesPerRow + 4 * sx], 4);
+				}
+			}
+			uint8_t* block = &blocks[(static_cast<size_t>(by) * blocksWide + bx) * blockBytes];
+			if (bc1) {
+				encodeColorBlock(texels, block);
+			}
+			else {
+				encodeAlphaBlock(texels, block);
+				encodeColorBlock(texels, block + 8);
+			}
+		}
+	}
+	return true;
+}
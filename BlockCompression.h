@@ -0,0 +1,52 @@
+#pragma once
+#include "ResourceManager.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Block compressed format families the device was created with
+struct TextureCompression {
+	bool bc = false; // desktop GPUs
+	bool etc2 = false; // mobile and most integrated ones
+	bool astc = false; // mobile, 4x4 blocks only here
+
+	// What the adapter has; the matching features must then be requested on the device
+	static TextureCompression query(wgpu::Adapter adapter);
+
+	// Whether textures of `format` can be created, always true when it is not compressed
+	bool supports(wgpu::TextureFormat format) const;
+	bool any() const { return bc || etc2 || astc; }
+};
+
+// Bytes of one 4x4 block, 0 when `format` is not block compressed
+uint32_t compressedBlockBytes(wgpu::TextureFormat format);
+
+// "BC1", "ETC2 RGBA8"... for reports, "RGBA8" for uncompressed color
+const char* compressedFormatName(wgpu::TextureFormat format);
+
+bool isSrgbFormat(wgpu::TextureFormat format);
+
+/**
+ * Decode the blocks of one mip level into RGBA8 texels, for devices without the format. BC1 and
+ * BC3 (what desktop tools write, missing on most mobile GPUs) and the three ETC2 formats (missing
+ * on most desktop GPUs) are known; BC7 and ASTC need the device to have them. sRGB formats decode
+ * to sRGB texels, like the GPU does before its conversion. `image` rows are padded like any
+ * decoded Image.
+ */
+bool decompressBlocks(wgpu::TextureFormat format, const uint8_t* blocks, size_t size, uint32_t width, uint32_t height,
+	Image& image);
+
+/**
+ * Decompress every level of `image` into an RGBA8 image (sRGB if it was), rows padded to 256
+ * bytes. Fails for formats decompressBlocks doesn't know.
+ */
+bool decompressImage(const CompressedImage& image, CompressedImage& decompressed);
+
+/**
+ * Encode an image to BC1 or BC3 with the min / max of each block as endpoints and no search
+ * beyond that: fast and good enough for generated test data, not for shipping assets. BC1 ignores
+ * alpha (every texel opaque).
+ */
+bool compressBlocks(wgpu::TextureFormat format, const Image& image, std::vector<uint8_t>& blocks);
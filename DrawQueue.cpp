@@ -0,0 +1,114 @@
+// DrawQueue.cpp
+#include "DrawQueue.h"
+#include "Trace.h"
+
+#include <array>
+#include <cstring>
+
+using namespace wgpu;
+
+namespace {
+constexpr uint32_t kIdMask = 0xFFF; // 12 bits per id in the key
+} // namespace
+
+uint64_t DrawQueue::makeKey(uint8_t layer, uint16_t pipelineId, uint16_t bindGroupId, uint32_t depth) {
+	return (static_cast<uint64_t>(layer) << 56)
+		| (static_cast<uint64_t>(pipelineId & kIdMask) << 44)
+		| (static_cast<uint64_t>(bindGroupId & kIdMask) << 32)
+		| depth;
+}
+
+uint32_t DrawQueue::sortableDepth(float depth, bool backToFront) {
+	// IEEE floats order like their bits once negative ones are flipped entirely and positive ones
+	// get their sign bit set
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	return backToFront ? ~bits : bits;
+}
+
+void DrawQueue::clear() {
+	packets.clear();
+	commands.clear();
+	// ids only need to be consistent within a frame. Kept across frames, every pipeline or bind
+	// group ever created would hold one, and past 4096 they would alias for good (and a released
+	// handle's address may come back as another object)
+	pipelineIds.clear();
+	bindGroupIds.clear();
+}
+
+void DrawQueue::push(const DrawCommand& draw, uint8_t layer, float depth, bool backToFront) {
+	DrawPacket packet;
+	packet.key = makeKey(layer, pipelineId(draw.pipeline), bindGroupId(draw.bindGroup), sortableDepth(depth, backToFront));
+	packet.payload = static_cast<uint32_t>(commands.size());
+	packets.push_back(packet);
+	commands.push_back(draw);
+}
+
+void DrawQueue::sort() {
+	TRACE_SCOPE("sort draws");
+	radixSort(packets, scratch);
+}
+
+void DrawQueue::flatten(std::vector<DrawCommand>& out) const {
+	out.clear();
+	out.reserve(packets.size());
+	for (const DrawPacket& packet : packets) {
+		out.push_back(commands[packet.payload]);
+	}
+}
+
+uint16_t DrawQueue::pipelineId(WGPURenderPipeline pipeline) {
+	auto it = pipelineIds.find(pipeline);
+	if (it != pipelineIds.end()) return it->second;
+	// past 4096 pipelines in a frame ids wrap around, which only costs some grouping
+	uint16_t id = static_cast<uint16_t>(pipelineIds.size() & kIdMask);
+	pipelineIds.emplace(pipeline, id);
+	return id;
+}
+
+uint16_t DrawQueue::bindGroupId(WGPUBindGroup bindGroup) {
+	auto it = bindGroupIds.find(bindGroup);
+	if (it != bindGroupIds.end()) return it->second;
+	uint16_t id = static_cast<uint16_t>(bindGroupIds.size() & kIdMask);
+	bindGroupIds.emplace(bindGroup, id);
+	return id;
+}
+
+void DrawQueue::radixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch) {
+	const size_t count = packets.size();
+	if (count < 2) return;
+	scratch.resize(count);
+
+	// one read of the keys fills the histograms of all 8 passes
+	std::array<std::array<uint32_t, 256>, 8> histograms = {};
+	for (const DrawPacket& packet : packets) {
+		for (int byte = 0; byte < 8; ++byte) {
+			++histograms[byte][(packet.key >> (8 * byte)) & 0xFF];
+		}
+	}
+
+	DrawPacket* source = packets.data();
+	DrawPacket* destination = scratch.data();
+	for (int byte = 0; byte < 8; ++byte) {
+		std::array<uint32_t, 256>& histogram = histograms[byte];
+		// every key has the same value here (unused layers, a single pipeline...), nothing moves
+		if (histogram[(source[0].key >> (8 * byte)) & 0xFF] == count) continue;
+
+		uint32_t offset = 0;
+		for (uint32_t& bucket : histogram) {
+			uint32_t size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			const DrawPacket& packet = source[i];
+			destination[histogram[(packet.key >> (8 * byte)) & 0xFF]++] = packet;
+		}
+		std::swap(source, destination);
+	}
+	// an odd number of passes leaves the result in the scratch buffer
+	if (source != packets.data()) {
+		packets.swap(scratch);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "ParallelEncoder.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A draw in the queue: everything the sort looks at is packed into `key`, the draw itself stays
+ * in the queue's command list and `payload` is its index there.
+ *
+ * Key layout, most significant first:
+ *   63..56  layer (opaque before transparent, overlays last...)
+ *   55..44  pipeline id
+ *   43..32  bind group id
+ *   31..0   depth, as given to sortableDepth
+ * so packets of a layer are grouped by pipeline, then bind group, then drawn front to back.
+ */
+struct DrawPacket {
+	uint64_t key = 0;
+	uint32_t payload = 0;
+};
+
+/**
+ * Collects the frame's draws with their sort keys, radix sorts them and hands them over in an
+ * order that minimizes state changes. ParallelEncoder skips the calls that set what is already
+ * bound, so sorting is what turns into fewer setPipeline / setBindGroup / setVertexBuffer.
+ */
+class DrawQueue {
+public:
+	static uint64_t makeKey(uint8_t layer, uint16_t pipelineId, uint16_t bindGroupId, uint32_t depth);
+	// Map a view depth to 32 bits that sort like it, reversed for back to front layers
+	static uint32_t sortableDepth(float depth, bool backToFront = false);
+
+	// Start a new frame, ids of pipelines and bind groups included
+	void clear();
+	void push(const DrawCommand& draw, uint8_t layer, float depth, bool backToFront = false);
+	void sort();
+	// The draws in sorted order, `out` is overwritten
+	void flatten(std::vector<DrawCommand>& out) const;
+
+	size_t size() const { return packets.size(); }
+	const std::vector<DrawPacket>& sortedPackets() const { return packets; }
+
+	// LSD radix sort on the keys, 8 bits per pass, skipping bytes all keys share. Stable.
+	// `scratch` is resized as needed, reusing it across calls saves the allocation.
+	static void radixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+private:
+	// small ids for handles, in order of first appearance this frame, 12 bits in the key
+	uint16_t pipelineId(WGPURenderPipeline pipeline);
+	uint16_t bindGroupId(WGPUBindGroup bindGroup);
+
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+	std::vector<DrawCommand> commands;
+	std::unordered_map<WGPURenderPipeline, uint16_t> pipelineIds;
+	std::unordered_map<WGPUBindGroup, uint16_t> bindGroupIds;
+};
@@ -0,0 +1,265 @@
+// DynamicResolution.cpp
+#include "DynamicResolution.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "ResourceManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace wgpu;
+
+namespace {
+// weight of the newest frame in the smoothed frame time
+constexpr double kSmoothing = 0.2;
+// scale aimed at when lowering, a little under the budget so that the next frames have some margin
+constexpr double kTargetFraction = 0.9;
+} // namespace
+
+void ResolutionController::configure(float minimum, float maximum, double budgetMs) {
+	maxScale = std::clamp(maximum, kStep, 1.0f);
+	minScale = std::clamp(minimum, kStep, maxScale);
+	budget = budgetMs;
+	currentScale = maxScale;
+	lowestScale = maxScale;
+	smoothedFrameMs = -1.0;
+	framesSinceChange = 0;
+}
+
+float ResolutionController::quantize(float scale) const {
+	// round down: a scale a bit too low costs some sharpness, one a bit too high a missed frame
+	float stepped = std::floor(scale / kStep + 1e-3f) * kStep;
+	return std::clamp(stepped, minScale, maxScale);
+}
+
+uint32_t ResolutionController::scaled(uint32_t size) const {
+	return std::max(1u, static_cast<uint32_t>(std::lround(size * currentScale)));
+}
+
+bool ResolutionController::update(double frameMs) {
+	++frames;
+	if (currentScale < maxScale) ++reducedFrames;
+	if (frameMs <= 0.0) return false;
+
+	smoothedFrameMs = smoothedFrameMs < 0.0 ? frameMs : smoothedFrameMs + kSmoothing * (frameMs - smoothedFrameMs);
+	if (++framesSinceChange < kSettleFrames) return false;
+
+	float target = currentScale;
+	if (smoothedFrameMs > budget) {
+		// pixels go with the square of the scale
+		target = quantize(currentScale * static_cast<float>(std::sqrt(budget * kTargetFraction / smoothedFrameMs)));
+	}
+	else if (smoothedFrameMs < budget * kRaiseFraction) {
+		target = std::min(maxScale, currentScale + kStep);
+	}
+	if (target == currentScale) return false;
+
+	lastChangeMs = smoothedFrameMs;
+	// until new timings come in, assume the frame time follows the pixel count
+	double ratio = static_cast<double>(target) / currentScale;
+	smoothedFrameMs *= ratio * ratio;
+	currentScale = target;
+	lowestScale = std::min(lowestScale, currentScale);
+	framesSinceChange = 0;
+	++changes;
+	return true;
+}
+
+void ResolutionController::report(std::ostream& out) const {
+	out << "Dynamic resolution: " << changes << " scale change(s), " << reducedFrames << " of " << frames
+		<< " frame(s) below " << std::fixed << std::setprecision(2) << maxScale << ", lowest scale "
+		<< lowestScale << ", budget " << std::setprecision(1) << budget << " ms" << std::defaultfloat << std::endl;
+}
+
+void WorkDoneTimer::onSubmit(Queue queue) {
+	// callbacks fire in submission order, the ones that did are at the front
+	for (; completed > 0; --completed) {
+		callbacks.pop_front();
+	}
+
+	Clock::time_point submitTime = Clock::now();
+	callbacks.push_back(queue.onSubmittedWorkDone([this, submitTime](QueueWorkDoneStatus status) {
+		Clock::time_point now = Clock::now();
+		++completed;
+		if (status != QueueWorkDoneStatus::Success) return;
+		double latency = std::chrono::duration<double, std::milli>(now - submitTime).count();
+		if (hasCompletion) {
+			double interval = std::chrono::duration<double, std::milli>(now - lastCompletion).count();
+			lastMs = std::min(latency, interval);
+		}
+		else {
+			lastMs = latency;
+		}
+		lastCompletion = now;
+		hasCompletion = true;
+	}));
+}
+
+bool Upscaler::initialize(Device gpuDevice, TextureFormat targetFormat) {
+	device = gpuDevice;
+	queue = device.getQueue();
+
+	ShaderModule shaderModule = ResourceManager::loadShaderModule(RESOURCE_DIR "/upscale.wgsl", device);
+	if (shaderModule == nullptr) {
+		std::cerr << "Could not load upscale shader" << std::endl;
+		return false;
+	}
+
+	// scene target, its sampler, parameters
+	std::vector<BindGroupLayoutEntry> bindingLayouts(3, Default);
+	bindingLayouts[0].binding = 0;
+	bindingLayouts[0].visibility = ShaderStage::Fragment;
+	bindingLayouts[0].texture.sampleType = TextureSampleType::Float;
+	bindingLayouts[0].texture.viewDimension = TextureViewDimension::_2D;
+	bindingLayouts[1].binding = 1;
+	bindingLayouts[1].visibility = ShaderStage::Fragment;
+	bindingLayouts[1].sampler.type = SamplerBindingType::Filtering;
+	bindingLayouts[2].binding = 2;
+	bindingLayouts[2].visibility = ShaderStage::Vertex | ShaderStage::Fragment;
+	bindingLayouts[2].buffer.type = BufferBindingType::Uniform;
+	bindingLayouts[2].buffer.minBindingSize = sizeof(Params);
+
+	BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+	bindGroupLayoutDesc.entryCount = static_cast<uint32_t>(bindingLayouts.size());
+	bindGroupLayoutDesc.entries = bindingLayouts.data();
+	bindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
+
+	PipelineLayoutDescriptor layoutDesc{};
+	layoutDesc.bindGroupLayoutCount = 1;
+	layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
+	layout = device.createPipelineLayout(layoutDesc);
+
+	RenderPipelineDescriptor pipelineDesc;
+	pipelineDesc.label = "Upscale";
+	// fullscreen triangle generated from the vertex index
+	pipelineDesc.vertex.bufferCount = 0;
+	pipelineDesc.vertex.buffers = nullptr;
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.constantCount = 0;
+	pipelineDesc.vertex.constants = nullptr;
+	pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+	pipelineDesc.primitive.frontFace = FrontFace::CCW;
+	pipelineDesc.primitive.cullMode = CullMode::None;
+
+	// replaces every pixel of the target, no blending
+	ColorTargetState colorTarget;
+	colorTarget.format = targetFormat;
+	colorTarget.blend = nullptr;
+	colorTarget.writeMask = ColorWriteMask::All;
+
+	FragmentState fragmentState;
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+	pipelineDesc.depthStencil = nullptr;
+	pipelineDesc.multisample.count = 1;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.multisample.alphaToCoverageEnabled = false;
+	pipelineDesc.layout = layout;
+	pipeline = device.createRenderPipeline(pipelineDesc);
+	shaderModule.release();
+
+	SamplerDescriptor samplerDesc;
+	samplerDesc.addressModeU = AddressMode::ClampToEdge;
+	samplerDesc.addressModeV = AddressMode::ClampToEdge;
+	samplerDesc.addressModeW = AddressMode::ClampToEdge;
+	samplerDesc.magFilter = FilterMode::Linear;
+	samplerDesc.minFilter = FilterMode::Linear;
+	samplerDesc.mipmapFilter = MipmapFilterMode::Nearest;
+	samplerDesc.lodMinClamp = 0.0f;
+	samplerDesc.lodMaxClamp = 1.0f;
+	samplerDesc.compare = CompareFunction::Undefined;
+	samplerDesc.maxAnisotropy = 1;
+	sampler = device.createSampler(samplerDesc);
+
+	BufferDescriptor bufferDesc = {};
+	bufferDesc.label = "Upscale parameters";
+	bufferDesc.size = sizeof(Params);
+	bufferDesc.usage = BufferUsage::Uniform | BufferUsage::CopyDst;
+	bufferDesc.mappedAtCreation = false;
+	paramsBuffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Uniform);
+	return true;
+}
+
+void Upscaler::terminate() {
+	invalidate();
+	if (paramsBuffer) {
+		GpuMemory::untrack(paramsBuffer);
+		paramsBuffer.release();
+	}
+	if (sampler) sampler.release();
+	if (pipeline) pipeline.release();
+	if (layout) layout.release();
+	if (bindGroupLayout) bindGroupLayout.release();
+	if (queue) queue.release();
+}
+
+void Upscaler::invalidate() {
+	// not compared by address against the next source: a released view's address may come back
+	// as another view, and this bind group would then sample a destroyed texture
+	if (bindGroup) bindGroup.release();
+	bindGroup = nullptr;
+}
+
+void Upscaler::encode(CommandEncoder encoder, TextureView source, uint32_t sourceWidth, uint32_t sourceHeight,
+	uint32_t renderWidth, uint32_t renderHeight, TextureView target, GpuProfiler& profiler) {
+	if (bindGroup == nullptr) {
+		std::vector<BindGroupEntry> bindings(3);
+		bindings[0].binding = 0;
+		bindings[0].textureView = source;
+		bindings[1].binding = 1;
+		bindings[1].sampler = sampler;
+		bindings[2].binding = 2;
+		bindings[2].buffer = paramsBuffer;
+		bindings[2].offset = 0;
+		bindings[2].size = sizeof(Params);
+
+		BindGroupDescriptor bindGroupDesc{};
+		bindGroupDesc.layout = bindGroupLayout;
+		bindGroupDesc.entryCount = static_cast<uint32_t>(bindings.size());
+		bindGroupDesc.entries = bindings.data();
+		bindGroup = device.createBindGroup(bindGroupDesc);
+	}
+
+	// written before the frame's submit, so the pass sees this frame's scale
+	Params params = {};
+	params.uvScale[0] = static_cast<float>(renderWidth) / sourceWidth;
+	params.uvScale[1] = static_cast<float>(renderHeight) / sourceHeight;
+	params.uvMax[0] = (renderWidth - 0.5f) / sourceWidth;
+	params.uvMax[1] = (renderHeight - 0.5f) / sourceHeight;
+	queue.writeBuffer(paramsBuffer, 0, &params, sizeof(Params));
+
+	RenderPassColorAttachment colorAttachment = {};
+	colorAttachment.view = target;
+	colorAttachment.resolveTarget = nullptr;
+	// every pixel is overwritten, nothing to load
+	colorAttachment.loadOp = LoadOp::Clear;
+	colorAttachment.storeOp = StoreOp::Store;
+	colorAttachment.clearValue = WGPUColor{ 0.0, 0.0, 0.0, 1.0 };
+#ifndef WEBGPU_BACKEND_WGPU
+	colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+#endif
+
+	RenderPassDescriptor passDesc = {};
+	passDesc.label = "Upscale";
+	passDesc.colorAttachmentCount = 1;
+	passDesc.colorAttachments = &colorAttachment;
+	passDesc.depthStencilAttachment = nullptr;
+	passDesc.timestampWrites = profiler.renderPass("upscale");
+
+	RenderPassEncoder pass = encoder.beginRenderPass(passDesc);
+	pass.setPipeline(pipeline);
+	pass.setBindGroup(0, bindGroup, 0, nullptr);
+	pass.draw(3, 1, 0, 0);
+	pass.end();
+	pass.release();
+}
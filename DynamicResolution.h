@@ -0,0 +1,122 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <ostream>
+
+class GpuProfiler;
+
+/**
+ * Picks the scene's resolution scale from measured frame times, so that heavy frames cost fewer
+ * pixels instead of missing the refresh.
+ *
+ * Frame times are smoothed, then:
+ *  - above the budget the scale drops right away to where the frame should fit again, assuming
+ *    the cost is proportional to the pixel count,
+ *  - well below it (kRaiseFraction of the budget) the scale goes back up one step at a time,
+ *  - in between nothing changes.
+ * After a change the controller waits kSettleFrames frames, since timings come back a few frames
+ * late and would otherwise still describe the previous scale. The band and the wait are the
+ * hysteresis that keeps the scale from oscillating.
+ */
+class ResolutionController {
+public:
+	static constexpr float kStep = 0.05f; // scales are multiples of this
+	static constexpr double kRaiseFraction = 0.75;
+	static constexpr uint32_t kSettleFrames = 8;
+
+	// Scales are clamped to [minScale, maxScale], maxScale <= 1
+	void configure(float minScale, float maxScale, double budgetMs);
+
+	// Feed the time of one frame, returns true when the scale changed
+	bool update(double frameMs);
+
+	float scale() const { return currentScale; }
+	double smoothedMs() const { return smoothedFrameMs; }
+	// smoothed frame time that triggered the latest change
+	double changeMs() const { return lastChangeMs; }
+	double budgetMs() const { return budget; }
+	// `size` (a width or a height) at the current scale, at least 1
+	uint32_t scaled(uint32_t size) const;
+
+	// Changes, time spent at reduced scale and the scale range that was used
+	void report(std::ostream& out) const;
+
+private:
+	float quantize(float scale) const;
+
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	double budget = 16.0;
+	float currentScale = 1.0f;
+	double smoothedFrameMs = -1.0;
+	double lastChangeMs = 0.0;
+	uint32_t framesSinceChange = 0;
+
+	uint64_t frames = 0;
+	uint64_t reducedFrames = 0; // frames below maxScale
+	uint32_t changes = 0;
+	float lowestScale = 1.0f;
+};
+
+/**
+ * Estimates the GPU time of frames from the CPU, for when timestamp queries are not available.
+ *
+ * Every submit registers an onSubmittedWorkDone callback. The time from submit to completion
+ * overestimates the frame when earlier frames were still queued, the time between two completions
+ * overestimates it when the GPU sat idle in between (vsync, light frames). The smaller of the two
+ * is a usable figure in both regimes.
+ */
+class WorkDoneTimer {
+public:
+	void onSubmit(wgpu::Queue queue);
+	// Estimate for the most recently completed frame, negative if none yet
+	double lastFrameMs() const { return lastMs; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	std::deque<std::unique_ptr<wgpu::QueueWorkDoneCallback>> callbacks;
+	uint32_t completed = 0; // callbacks at the front of `callbacks` that already fired
+	Clock::time_point lastCompletion;
+	bool hasCompletion = false;
+	double lastMs = -1.0;
+};
+
+/**
+ * Draws the scene target over the whole surface, bilinear filtered. The scene covers the top
+ * left `renderWidth` x `renderHeight` texels of a source sized for the largest scale.
+ */
+class Upscaler {
+public:
+	bool initialize(wgpu::Device device, wgpu::TextureFormat targetFormat);
+	void terminate();
+
+	// The source is about to change (the frame graph gets rebuilt): drop the bind group of the
+	// current one, the next encode() makes a new one
+	void invalidate();
+
+	// `source` must be the same view from one invalidate() to the next
+	void encode(wgpu::CommandEncoder encoder, wgpu::TextureView source, uint32_t sourceWidth, uint32_t sourceHeight,
+		uint32_t renderWidth, uint32_t renderHeight, wgpu::TextureView target, GpuProfiler& profiler);
+
+private:
+	struct Params {
+		float uvScale[2];
+		float uvMax[2];
+	};
+	static_assert(sizeof(Params) % 16 == 0);
+
+	wgpu::Device device = nullptr;
+	wgpu::Queue queue = nullptr;
+	wgpu::RenderPipeline pipeline = nullptr;
+	wgpu::BindGroupLayout bindGroupLayout = nullptr;
+	wgpu::PipelineLayout layout = nullptr;
+	wgpu::Sampler sampler = nullptr;
+	wgpu::Buffer paramsBuffer = nullptr;
+	// the bind group depends on the source view, kept until invalidate()
+	wgpu::BindGroup bindGroup = nullptr;
+};
@@ -0,0 +1,100 @@
+// FrameBenchmark.cpp
+#include "FrameBenchmark.h"
+#include "Stats.h"
+
+#include <algorithm>
+
+using namespace wgpu;
+
+FrameBenchmark::FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames)
+	: warmupFrames(warmupFrames)
+	, measuredFrames(measuredFrames)
+{
+	cpuFrameMs.reserve(measuredFrames);
+	submitToIdleMs.reserve(measuredFrames);
+	presentIntervalMs.reserve(measuredFrames);
+	stateChanges.reserve(measuredFrames);
+	workDoneCallbacks.reserve(measuredFrames);
+}
+
+void FrameBenchmark::beginFrame() {
+	frameStart = Clock::now();
+	if (frameCount == warmupFrames) {
+		measureStart = frameStart;
+	}
+}
+
+void FrameBenchmark::endFrame() {
+	if (isMeasuring()) {
+		measureEnd = Clock::now();
+		cpuFrameMs.push_back(std::chrono::duration<double, std::milli>(measureEnd - frameStart).count());
+	}
+	++frameCount;
+}
+
+void FrameBenchmark::setReadbackStats(uint64_t bytesPerFrame, uint64_t delivered, uint64_t dropped) {
+	readbackBytesPerFrame = bytesPerFrame;
+	readbackDelivered = delivered;
+	readbackDropped = dropped;
+}
+
+void FrameBenchmark::onSubmit(Queue queue) {
+	if (!isMeasuring()) {
+		return;
+	}
+	Clock::time_point submitTime = Clock::now();
+	++pendingWorkDone;
+	// handles must outlive the callback, they are kept until the benchmark goes away
+	workDoneCallbacks.push_back(queue.onSubmittedWorkDone([this, submitTime](QueueWorkDoneStatus status) {
+		if (status == QueueWorkDoneStatus::Success) {
+			submitToIdleMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - submitTime).count());
+		}
+		--pendingWorkDone;
+	}));
+}
+
+void FrameBenchmark::onPresent() {
+	Clock::time_point now = Clock::now();
+	if (isMeasuring() && hasLastPresent) {
+		presentIntervalMs.push_back(std::chrono::duration<double, std::milli>(now - lastPresent).count());
+	}
+	lastPresent = now;
+	hasLastPresent = true;
+}
+
+void FrameBenchmark::onEncode(uint32_t changes) {
+	if (isMeasuring()) {
+		stateChanges.push_back(static_cast<double>(changes));
+	}
+}
+
+void FrameBenchmark::writeJson(std::ostream& out, uint32_t width, uint32_t height, bool headless) const {
+	out << "{\n"
+		<< "  \"warmup_frames\": " << warmupFrames << ",\n"
+		<< "  \"measured_frames\": " << measuredFrames << ",\n"
+		<< "  \"width\": " << width << ",\n"
+		<< "  \"height\": " << height << ",\n"
+		<< "  \"headless\": " << (headless ? "true" : "false") << ",\n"
+		<< "  \"cpu_frame_ms\": ";
+	Summary::of(cpuFrameMs).writeJson(out);
+	out << ",\n  \"submit_to_idle_ms\": ";
+	Summary::of(submitToIdleMs).writeJson(out);
+	out << ",\n  \"present_interval_ms\": ";
+	Summary::of(presentIntervalMs).writeJson(out);
+	out << ",\n  \"state_changes_per_frame\": ";
+	Summary::of(stateChanges).writeJson(out);
+	if (startupMs >= 0.0) {
+		out << ",\n  \"time_to_first_frame_ms\": " << startupMs;
+	}
+	if (readbackBytesPerFrame > 0) {
+		// frames delivered over the measured span (warmup frames may still land in it)
+		double seconds = std::chrono::duration<double>(measureEnd - measureStart).count();
+		double frames = static_cast<double>(std::min<uint64_t>(readbackDelivered, measuredFrames));
+		double megabytesPerSecond = seconds > 0.0 ? frames * static_cast<double>(readbackBytesPerFrame) / seconds / 1e6 : 0.0;
+		out << ",\n  \"readback\": {\"bytes_per_frame\": " << readbackBytesPerFrame
+			<< ", \"delivered\": " << readbackDelivered
+			<< ", \"dropped\": " << readbackDropped
+			<< ", \"mb_per_s\": " << megabytesPerSecond << "}";
+	}
+	out << "\n}" << std::endl;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+/**
+ * Measures the render loop over a fixed number of frames after a warmup:
+ *  - CPU time of each MainLoop call
+ *  - submit to idle, from queue.submit until onSubmittedWorkDone fires
+ *  - interval between consecutive presents (end of frame when headless)
+ * and reports min/mean/p50/p95/p99/max of each as JSON.
+ *
+ * Work-done callbacks only fire when the device is polled, which MainLoop does once per frame,
+ * so submit to idle is an upper bound with roughly frame granularity.
+ */
+class FrameBenchmark {
+public:
+	FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames);
+
+	void beginFrame();
+	void endFrame();
+	// right after queue.submit
+	void onSubmit(wgpu::Queue queue);
+	// right after surface.present (or where it would be when headless)
+	void onPresent();
+	// state setting calls recorded for the frame's draws
+	void onEncode(uint32_t stateChanges);
+
+	// All frames were rendered, pending work-done callbacks may still be in flight
+	bool isDone() const { return frameCount >= warmupFrames + measuredFrames; }
+	// Every submission we are waiting on has reported back
+	bool allWorkDone() const { return pendingWorkDone == 0; }
+
+	// Frames were read back during the run, `bytesPerFrame` each
+	void setReadbackStats(uint64_t bytesPerFrame, uint64_t delivered, uint64_t dropped);
+	// Time from the start of Initialize to the first frame, see StartupProfiler
+	void setStartupMs(double ms) { startupMs = ms; }
+
+	void writeJson(std::ostream& out, uint32_t width, uint32_t height, bool headless) const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	bool isMeasuring() const { return frameCount >= warmupFrames && !isDone(); }
+
+	uint32_t warmupFrames;
+	uint32_t measuredFrames;
+	uint32_t frameCount = 0; // frames started so far, warmup included
+	Clock::time_point frameStart;
+	Clock::time_point lastPresent;
+	bool hasLastPresent = false;
+	int pendingWorkDone = 0;
+	// wall clock span of the measured frames
+	Clock::time_point measureStart;
+	Clock::time_point measureEnd;
+	uint64_t readbackBytesPerFrame = 0;
+	uint64_t readbackDelivered = 0;
+	uint64_t readbackDropped = 0;
+	double startupMs = -1.0;
+
+	std::vector<double> cpuFrameMs;
+	std::vector<double> submitToIdleMs;
+	std::vector<double> presentIntervalMs;
+	std::vector<double> stateChanges;
+	std::vector<std::unique_ptr<wgpu::QueueWorkDoneCallback>> workDoneCallbacks;
+};
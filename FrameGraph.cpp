@@ -0,0 +1,382 @@
+// FrameGraph.cpp
+#include "FrameGraph.h"
+#include "GpuMemory.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+using namespace wgpu;
+
+namespace {
+
+bool sameBuffer(const FrameGraph::BufferDesc& a, const FrameGraph::BufferDesc& b) {
+	return a.size == b.size && a.usage == b.usage;
+}
+
+uint64_t textureBytes(const FrameGraph::TextureDesc& desc) {
+	return static_cast<uint64_t>(desc.width) * desc.height * desc.sampleCount * textureFormatSize(desc.format);
+}
+
+} // namespace
+
+// -- Resources
+
+TextureView FrameGraph::Resources::textureView(const std::string& name) const {
+	const Resource* resource = graph.find(name);
+	return resource ? resource->view : nullptr;
+}
+
+Texture FrameGraph::Resources::texture(const std::string& name) const {
+	const Resource* resource = graph.find(name);
+	return resource ? resource->texture : nullptr;
+}
+
+Buffer FrameGraph::Resources::buffer(const std::string& name) const {
+	const Resource* resource = graph.find(name);
+	return resource ? resource->buffer : nullptr;
+}
+
+// -- declaration
+
+FrameGraph::~FrameGraph() {
+	reset();
+}
+
+void FrameGraph::reset() {
+	releaseAllocations();
+	resources.clear();
+	resourceIndex.clear();
+	passes.clear();
+	order.clear();
+	compiled = false;
+}
+
+void FrameGraph::createTexture(const std::string& name, const TextureDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.isTexture = true;
+	resource.textureDesc = desc;
+	resourceIndex[name] = static_cast<uint32_t>(resources.size());
+	resources.push_back(resource);
+}
+
+void FrameGraph::createBuffer(const std::string& name, const BufferDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.isTexture = false;
+	resource.bufferDesc = desc;
+	resourceIndex[name] = static_cast<uint32_t>(resources.size());
+	resources.push_back(resource);
+}
+
+void FrameGraph::importTexture(const std::string& name) {
+	Resource resource;
+	resource.name = name;
+	resource.isTexture = true;
+	resource.imported = true;
+	resourceIndex[name] = static_cast<uint32_t>(resources.size());
+	resources.push_back(resource);
+}
+
+void FrameGraph::importBuffer(const std::string& name) {
+	Resource resource;
+	resource.name = name;
+	resource.isTexture = false;
+	resource.imported = true;
+	resourceIndex[name] = static_cast<uint32_t>(resources.size());
+	resources.push_back(resource);
+}
+
+void FrameGraph::addPass(const std::string& name, const Setup& setup, Execute execute) {
+	PassBuilder builder;
+	setup(builder);
+	Pass pass;
+	pass.name = name;
+	pass.readNames = std::move(builder.reads);
+	pass.writeNames = std::move(builder.writes);
+	pass.sideEffect = builder.hasSideEffect;
+	pass.execute = std::move(execute);
+	passes.push_back(std::move(pass));
+	compiled = false;
+}
+
+const FrameGraph::Resource* FrameGraph::find(const std::string& name) const {
+	auto it = resourceIndex.find(name);
+	return it == resourceIndex.end() ? nullptr : &resources[it->second];
+}
+
+// -- compilation
+
+bool FrameGraph::compile(Device device, TexturePool& pool) {
+	TRACE_SCOPE("compile frame graph");
+	releaseAllocations();
+	order.clear();
+	compiled = false;
+	if (!resolveNames() || !sortPasses()) {
+		return false;
+	}
+	cullPasses();
+	allocateTransients(device, pool);
+	compiled = true;
+	return true;
+}
+
+bool FrameGraph::resolveNames() {
+	for (Pass& pass : passes) {
+		pass.reads.clear();
+		pass.writes.clear();
+		pass.culled = false;
+		for (const std::string& name : pass.readNames) {
+			auto it = resourceIndex.find(name);
+			if (it == resourceIndex.end()) {
+				std::cerr << "Frame graph: pass '" << pass.name << "' reads unknown resource '" << name << "'" << std::endl;
+				return false;
+			}
+			pass.reads.push_back(it->second);
+		}
+		for (const std::string& name : pass.writeNames) {
+			auto it = resourceIndex.find(name);
+			if (it == resourceIndex.end()) {
+				std::cerr << "Frame graph: pass '" << pass.name << "' writes unknown resource '" << name << "'" << std::endl;
+				return false;
+			}
+			pass.writes.push_back(it->second);
+		}
+	}
+	return true;
+}
+
+bool FrameGraph::sortPasses() {
+	// writers of each resource, in declaration order
+	std::vector<std::vector<uint32_t>> writers(resources.size());
+	for (uint32_t p = 0; p < passes.size(); ++p) {
+		for (uint32_t r : passes[p].writes) {
+			writers[r].push_back(p);
+		}
+	}
+
+	// p depends on every writer of what it reads, and on the writers declared before it of what
+	// it writes (several writers of one resource keep their declaration order)
+	std::vector<std::vector<uint32_t>> dependents(passes.size());
+	std::vector<uint32_t> pending(passes.size(), 0);
+	auto addEdge = [&](uint32_t from, uint32_t to) {
+		if (from == to) return;
+		if (std::find(dependents[from].begin(), dependents[from].end(), to) != dependents[from].end()) return;
+		dependents[from].push_back(to);
+		++pending[to];
+	};
+	for (uint32_t p = 0; p < passes.size(); ++p) {
+		for (uint32_t r : passes[p].reads) {
+			bool alsoWrites = std::find(passes[p].writes.begin(), passes[p].writes.end(), r) != passes[p].writes.end();
+			for (uint32_t writer : writers[r]) {
+				// read-modify-write: only what was written before counts as input
+				if (alsoWrites && writer > p) continue;
+				addEdge(writer, p);
+			}
+		}
+		for (uint32_t r : passes[p].writes) {
+			for (uint32_t writer : writers[r]) {
+				if (writer < p) addEdge(writer, p);
+			}
+		}
+	}
+
+	// Kahn's algorithm, always taking the first ready pass in declaration order
+	std::vector<uint32_t> sorted;
+	std::vector<bool> done(passes.size(), false);
+	while (sorted.size() < passes.size()) {
+		uint32_t next = static_cast<uint32_t>(passes.size());
+		for (uint32_t p = 0; p < passes.size(); ++p) {
+			if (!done[p] && pending[p] == 0) {
+				next = p;
+				break;
+			}
+		}
+		if (next == passes.size()) {
+			std::cerr << "Frame graph: passes depend on each other in a cycle" << std::endl;
+			return false;
+		}
+		done[next] = true;
+		sorted.push_back(next);
+		for (uint32_t dependent : dependents[next]) {
+			--pending[dependent];
+		}
+	}
+	order = std::move(sorted);
+	return true;
+}
+
+void FrameGraph::cullPasses() {
+	// walk back from the roots, in reverse execution order so that a pass is only visited once
+	// every pass that could need it has been
+	std::vector<bool> needed(resources.size(), false);
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		Pass& pass = passes[*it];
+		bool alive = pass.sideEffect;
+		for (uint32_t r : pass.writes) {
+			alive = alive || resources[r].imported || needed[r];
+		}
+		pass.culled = !alive;
+		if (!alive) continue;
+		// what it overwrites without reading is not needed from earlier passes anymore
+		for (uint32_t r : pass.writes) {
+			if (!resources[r].imported) needed[r] = false;
+		}
+		for (uint32_t r : pass.reads) {
+			needed[r] = true;
+		}
+	}
+	order.erase(std::remove_if(order.begin(), order.end(), [this](uint32_t p) {
+		return passes[p].culled;
+	}), order.end());
+}
+
+void FrameGraph::allocateTransients(Device device, TexturePool& pool) {
+	texturePool = &pool;
+	for (Resource& resource : resources) {
+		resource.firstUse = -1;
+		resource.lastUse = -1;
+		resource.allocation = -1;
+	}
+	for (int position = 0; position < static_cast<int>(order.size()); ++position) {
+		const Pass& pass = passes[order[position]];
+		auto touch = [&](uint32_t r) {
+			Resource& resource = resources[r];
+			if (resource.firstUse < 0) resource.firstUse = position;
+			resource.lastUse = position;
+		};
+		for (uint32_t r : pass.reads) touch(r);
+		for (uint32_t r : pass.writes) touch(r);
+	}
+
+	// transients by first use, each goes to the first compatible allocation that is free by then
+	std::vector<uint32_t> transients;
+	for (uint32_t r = 0; r < resources.size(); ++r) {
+		if (!resources[r].imported && resources[r].firstUse >= 0) {
+			transients.push_back(r);
+		}
+	}
+	std::stable_sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+		return resources[a].firstUse < resources[b].firstUse;
+	});
+
+	unaliasedBytes = 0;
+	aliasedBytes = 0;
+	for (uint32_t r : transients) {
+		Resource& resource = resources[r];
+		uint64_t bytes = resource.isTexture ? textureBytes(resource.textureDesc) : resource.bufferDesc.size;
+		unaliasedBytes += bytes;
+
+		int chosen = -1;
+		for (int a = 0; a < static_cast<int>(allocations.size()); ++a) {
+			const Allocation& allocation = allocations[a];
+			bool compatible = allocation.isTexture == resource.isTexture && (resource.isTexture
+				? allocation.textureDesc == resource.textureDesc
+				: sameBuffer(allocation.bufferDesc, resource.bufferDesc));
+			if (compatible && allocation.busyUntil < resource.firstUse) {
+				chosen = a;
+				break;
+			}
+		}
+		if (chosen < 0) {
+			Allocation allocation;
+			allocation.isTexture = resource.isTexture;
+			allocation.textureDesc = resource.textureDesc;
+			allocation.bufferDesc = resource.bufferDesc;
+			allocation.bytes = bytes;
+			if (resource.isTexture) {
+				allocation.texture = pool.acquire(resource.textureDesc, resource.name.c_str());
+			}
+			else {
+				BufferDescriptor bufferDesc = {};
+				bufferDesc.label = resource.name.c_str();
+				bufferDesc.size = resource.bufferDesc.size;
+				bufferDesc.usage = resource.bufferDesc.usage;
+				bufferDesc.mappedAtCreation = false;
+				allocation.buffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Other);
+			}
+			aliasedBytes += bytes;
+			allocations.push_back(allocation);
+			chosen = static_cast<int>(allocations.size()) - 1;
+		}
+		Allocation& allocation = allocations[chosen];
+		allocation.busyUntil = resource.lastUse;
+		allocation.users.push_back(resource.name);
+		resource.allocation = chosen;
+		resource.texture = allocation.texture.texture;
+		resource.view = allocation.texture.view;
+		resource.buffer = allocation.buffer;
+	}
+}
+
+void FrameGraph::releaseAllocations() {
+	for (Allocation& allocation : allocations) {
+		if (allocation.texture.texture && texturePool) {
+			// back to the pool, the next compile likely wants the same textures
+			texturePool->release(allocation.texture);
+		}
+		if (allocation.buffer) {
+			GpuMemory::untrack(allocation.buffer);
+			allocation.buffer.destroy();
+			allocation.buffer.release();
+		}
+	}
+	allocations.clear();
+	for (Resource& resource : resources) {
+		if (!resource.imported) {
+			resource.texture = nullptr;
+			resource.view = nullptr;
+			resource.buffer = nullptr;
+			resource.allocation = -1;
+		}
+	}
+	unaliasedBytes = 0;
+	aliasedBytes = 0;
+}
+
+// -- every frame
+
+void FrameGraph::setTexture(const std::string& name, TextureView view, Texture texture) {
+	auto it = resourceIndex.find(name);
+	if (it == resourceIndex.end() || !resources[it->second].imported) return;
+	resources[it->second].view = view;
+	resources[it->second].texture = texture;
+}
+
+void FrameGraph::setBuffer(const std::string& name, Buffer buffer) {
+	auto it = resourceIndex.find(name);
+	if (it == resourceIndex.end() || !resources[it->second].imported) return;
+	resources[it->second].buffer = buffer;
+}
+
+void FrameGraph::execute(CommandEncoder encoder) {
+	if (!compiled) return;
+	Resources view(*this);
+	for (uint32_t p : order) {
+		passes[p].execute(encoder, view);
+	}
+}
+
+void FrameGraph::report(std::ostream& out) const {
+	out << "Frame graph: " << order.size() << " pass(es)";
+	for (size_t i = 0; i < order.size(); ++i) {
+		out << (i == 0 ? ": " : " -> ") << passes[order[i]].name;
+	}
+	out << "\n";
+	for (const Pass& pass : passes) {
+		if (pass.culled) out << "  culled: " << pass.name << "\n";
+	}
+	for (const Allocation& allocation : allocations) {
+		out << "  allocation of " << allocation.bytes / 1024 << " KiB:";
+		for (const std::string& user : allocation.users) {
+			out << " " << user;
+		}
+		out << "\n";
+	}
+	out << std::fixed << std::setprecision(2)
+		<< "  peak transient memory: " << unaliasedBytes / (1024.0 * 1024.0) << " MiB without aliasing, "
+		<< aliasedBytes / (1024.0 * 1024.0) << " MiB with aliasing" << std::endl;
+	out << std::defaultfloat;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include "TexturePool.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Declarative description of a frame: passes say which named textures and buffers they read and
+ * write, and the graph works out the rest.
+ *
+ * The graph is declared and compiled once per configuration (startup, resize), then executed
+ * every frame. Compiling
+ *  - orders the passes so that every read comes after the writes it depends on (declaration
+ *    order breaks ties, so a graph declared in a sensible order runs in that order),
+ *  - culls passes whose results nobody uses: only passes writing an imported resource or marked
+ *    as having side effects (readback...) are roots,
+ *  - allocates transient resources, giving two of them the same GPU object when their
+ *    descriptors match and their lifetimes (first to last pass using them) do not overlap.
+ *    Transient textures come from a TexturePool, so recompiling for the same size reuses them.
+ *
+ * WebGPU has no placement of resources into shared heaps, so "aliasing" here means reusing one
+ * Texture / Buffer for several transients, which only happens between identical descriptors.
+ * A transient's content is undefined when its first pass starts: that pass has to clear it.
+ */
+class FrameGraph {
+public:
+	using TextureDesc = TextureKey;
+	struct BufferDesc {
+		uint64_t size = 0;
+		WGPUBufferUsageFlags usage = wgpu::BufferUsage::Storage;
+	};
+
+	// What a pass sees of the graph's resources while it executes
+	class Resources {
+	public:
+		explicit Resources(const FrameGraph& graph) : graph(graph) {}
+		wgpu::TextureView textureView(const std::string& name) const;
+		wgpu::Texture texture(const std::string& name) const;
+		wgpu::Buffer buffer(const std::string& name) const;
+	private:
+		const FrameGraph& graph;
+	};
+
+	// Collects a pass's reads and writes while it is being added
+	class PassBuilder {
+	public:
+		void read(const std::string& name) { reads.push_back(name); }
+		void write(const std::string& name) { writes.push_back(name); }
+		// Keep the pass even when nothing reads what it writes (copies to the CPU, for instance)
+		void sideEffect() { hasSideEffect = true; }
+	private:
+		friend class FrameGraph;
+		std::vector<std::string> reads;
+		std::vector<std::string> writes;
+		bool hasSideEffect = false;
+	};
+
+	using Setup = std::function<void(PassBuilder&)>;
+	using Execute = std::function<void(wgpu::CommandEncoder encoder, const Resources& resources)>;
+
+	~FrameGraph();
+
+	// Forget every pass and resource, and release the transients. Start of a new declaration.
+	void reset();
+	// Transient resources, created by compile() and only meaningful within a frame
+	void createTexture(const std::string& name, const TextureDesc& desc);
+	void createBuffer(const std::string& name, const BufferDesc& desc);
+	// Resources owned by someone else, handed over every frame with setTexture / setBuffer
+	void importTexture(const std::string& name);
+	void importBuffer(const std::string& name);
+	void addPass(const std::string& name, const Setup& setup, Execute execute);
+
+	// Order, cull and allocate. Prints what is wrong and returns false on unknown names or cycles.
+	// Transient textures are taken from `pool` and given back on the next reset or compile.
+	bool compile(wgpu::Device device, TexturePool& pool);
+	bool isCompiled() const { return compiled; }
+
+	// Per frame values of imported resources. `texture` may be null when passes only need the view.
+	void setTexture(const std::string& name, wgpu::TextureView view, wgpu::Texture texture = nullptr);
+	void setBuffer(const std::string& name, wgpu::Buffer buffer);
+	// Run the surviving passes in order
+	void execute(wgpu::CommandEncoder encoder);
+
+	void terminate() { reset(); }
+
+	// Bytes of transients if each had its own allocation, and what the aliased allocation takes
+	uint64_t transientBytes() const { return unaliasedBytes; }
+	uint64_t allocatedBytes() const { return aliasedBytes; }
+	// Pass order, culled passes and the transient memory figures
+	void report(std::ostream& out) const;
+
+private:
+	struct Resource {
+		std::string name;
+		bool isTexture = true;
+		bool imported = false;
+		TextureDesc textureDesc;
+		BufferDesc bufferDesc;
+		// set by compile for transients, by setTexture / setBuffer for imports
+		wgpu::Texture texture = nullptr;
+		wgpu::TextureView view = nullptr;
+		wgpu::Buffer buffer = nullptr;
+		int allocation = -1;
+		// positions in `order` of the first and last surviving pass using it
+		int firstUse = -1;
+		int lastUse = -1;
+	};
+
+	struct Pass {
+		std::string name;
+		std::vector<uint32_t> reads;
+		std::vector<uint32_t> writes;
+		std::vector<std::string> readNames;
+		std::vector<std::string> writeNames;
+		bool sideEffect = false;
+		bool culled = false;
+		Execute execute;
+	};
+
+	// One GPU object, shared by the transients whose lifetimes fit one after the other
+	struct Allocation {
+		bool isTexture = true;
+		TextureDesc textureDesc;
+		BufferDesc bufferDesc;
+		PooledTexture texture;
+		wgpu::Buffer buffer = nullptr;
+		int busyUntil = -1; // last pass of the latest transient placed here
+		uint64_t bytes = 0;
+		std::vector<std::string> users;
+	};
+
+	const Resource* find(const std::string& name) const;
+	bool resolveNames();
+	bool sortPasses();
+	void cullPasses();
+	void allocateTransients(wgpu::Device device, TexturePool& pool);
+	void releaseAllocations();
+
+	std::vector<Resource> resources;
+	std::unordered_map<std::string, uint32_t> resourceIndex;
+	std::vector<Pass> passes;
+	std::vector<uint32_t> order; // surviving passes, in execution order
+	std::vector<Allocation> allocations;
+	TexturePool* texturePool = nullptr; // where the current allocations' textures came from
+	uint64_t unaliasedBytes = 0;
+	uint64_t aliasedBytes = 0;
+	bool compiled = false;
+};
@@ -0,0 +1,188 @@
+// GpuBufferAllocator.cpp
+#include "GpuBufferAllocator.h"
+#include "GpuMemory.h"
+
+#include <algorithm>
+#include <iomanip>
+
+using namespace wgpu;
+
+namespace {
+
+const char* className(BufferClass bufferClass) {
+	switch (bufferClass) {
+	case BufferClass::Vertex: return "vertex";
+	case BufferClass::Index: return "index";
+	case BufferClass::Uniform: return "uniform";
+	default: return "?";
+	}
+}
+
+WGPUBufferUsageFlags classUsage(BufferClass bufferClass) {
+	switch (bufferClass) {
+	case BufferClass::Vertex: return BufferUsage::Vertex | BufferUsage::CopyDst;
+	case BufferClass::Index: return BufferUsage::Index | BufferUsage::CopyDst;
+	default: return BufferUsage::Uniform | BufferUsage::CopyDst;
+	}
+}
+
+} // namespace
+
+GpuBufferAllocator::~GpuBufferAllocator() {
+	terminate();
+}
+
+void GpuBufferAllocator::initialize(Device gpuDevice, uint64_t size, LifetimeTracker* tracker) {
+	device = gpuDevice;
+	blockSize = size;
+	lifetimes = tracker;
+}
+
+void GpuBufferAllocator::terminate() {
+	// the device is done by now, and the tracker may already be
+	lifetimes = nullptr;
+	for (Block& block : blocks) {
+		if (!block.inUse) continue;
+		destroyBlock(block);
+	}
+	blocks.clear();
+}
+
+void GpuBufferAllocator::destroyBlock(Block& block) {
+	// out of the budget now, destroyed once the commands recorded so far completed: an empty block
+	// may still be bound by draws recorded this frame
+	GpuMemory::untrack(block.buffer);
+	if (lifetimes) {
+		lifetimes->release(block.buffer);
+	}
+	else {
+		block.buffer.destroy();
+		block.buffer.release();
+	}
+	block.buffer = nullptr;
+	block.inUse = false;
+}
+
+uint32_t GpuBufferAllocator::createBlock(BufferClass bufferClass, uint64_t size) {
+	BufferDescriptor bufferDesc = {};
+	bufferDesc.label = "Sub-allocated block";
+	bufferDesc.size = size;
+	bufferDesc.usage = classUsage(bufferClass);
+	bufferDesc.mappedAtCreation = false;
+	MemoryCategory category = bufferClass == BufferClass::Uniform ? MemoryCategory::Uniform : MemoryCategory::Mesh;
+	Buffer buffer = GpuMemory::createBuffer(device, bufferDesc, category);
+	if (!buffer) return Tlsf::kInvalid;
+	++blocksCreated;
+
+	// reuse the slot of a destroyed block, so that indices held by allocations stay put
+	auto slot = std::find_if(blocks.begin(), blocks.end(), [](const Block& block) { return !block.inUse; });
+	if (slot == blocks.end()) {
+		slot = blocks.insert(blocks.end(), Block());
+	}
+	slot->bufferClass = bufferClass;
+	slot->buffer = buffer;
+	slot->tlsf.reset(size);
+	slot->inUse = true;
+	return static_cast<uint32_t>(slot - blocks.begin());
+}
+
+BufferAllocation GpuBufferAllocator::allocate(BufferClass bufferClass, uint64_t size, uint64_t alignment) {
+	BufferAllocation allocation;
+	allocation.bufferClass = bufferClass;
+
+	Tlsf::Allocation range;
+	uint32_t index = Tlsf::kInvalid;
+	for (uint32_t i = 0; i < blocks.size(); ++i) {
+		Block& block = blocks[i];
+		if (block.inUse && block.bufferClass == bufferClass && block.tlsf.allocate(size, alignment, range)) {
+			index = i;
+			break;
+		}
+	}
+	if (index == Tlsf::kInvalid) {
+		// oversized requests get a block of their own, with room for the alignment
+		uint64_t newBlockSize = std::max(blockSize, size + alignment + Tlsf::kGranularity);
+		index = createBlock(bufferClass, newBlockSize);
+		if (index == Tlsf::kInvalid || !blocks[index].tlsf.allocate(size, alignment, range)) {
+			return allocation;
+		}
+	}
+
+	allocation.buffer = blocks[index].buffer;
+	allocation.offset = range.offset;
+	allocation.size = size;
+	allocation.block = index;
+	allocation.node = range.node;
+	return allocation;
+}
+
+void GpuBufferAllocator::free(BufferAllocation& allocation) {
+	if (!allocation.isValid() || allocation.block >= blocks.size()) return;
+	Block& block = blocks[allocation.block];
+	block.tlsf.free(allocation.node);
+
+	if (block.tlsf.isEmpty()) {
+		bool otherBlock = std::any_of(blocks.begin(), blocks.end(), [&](const Block& other) {
+			return other.inUse && &other != &block && other.bufferClass == block.bufferClass;
+		});
+		if (otherBlock) {
+			// the range itself is reused at once: ranges still used by commands not submitted yet
+			// must go through retire()
+			destroyBlock(block);
+		}
+	}
+	allocation = BufferAllocation();
+}
+
+uint64_t GpuBufferAllocator::trim(uint64_t bytes) {
+	uint64_t freed = 0;
+	for (Block& block : blocks) {
+		if (freed >= bytes) break;
+		// free() keeps the last empty block of a class around, give those back too
+		if (!block.inUse || !block.tlsf.isEmpty()) continue;
+		freed += block.tlsf.capacity();
+		destroyBlock(block);
+	}
+	return freed;
+}
+
+void GpuBufferAllocator::retire(BufferAllocation& allocation, LifetimeTracker& lifetimes) {
+	if (!allocation.isValid()) return;
+	lifetimes.defer([this, retired = allocation]() mutable {
+		free(retired);
+	});
+	allocation = BufferAllocation();
+}
+
+GpuBufferAllocator::ClassStats GpuBufferAllocator::stats(BufferClass bufferClass) const {
+	ClassStats stats;
+	uint64_t freeBytes = 0;
+	for (const Block& block : blocks) {
+		if (!block.inUse || block.bufferClass != bufferClass) continue;
+		Tlsf::Stats blockStats = block.tlsf.stats();
+		++stats.blocks;
+		stats.allocations += blockStats.allocations;
+		stats.freeBlocks += blockStats.freeBlocks;
+		stats.reservedBytes += blockStats.capacity;
+		stats.usedBytes += blockStats.usedBytes;
+		stats.largestFreeBlock = std::max(stats.largestFreeBlock, blockStats.largestFreeBlock);
+		freeBytes += blockStats.freeBytes;
+	}
+	stats.fragmentation = freeBytes == 0 ? 0.0 : 1.0 - static_cast<double>(stats.largestFreeBlock) / static_cast<double>(freeBytes);
+	return stats;
+}
+
+void GpuBufferAllocator::report(std::ostream& out) const {
+	out << "Buffer allocator: " << blocksCreated << " GPU buffer(s) created" << std::endl;
+	for (int i = 0; i < static_cast<int>(BufferClass::Count); ++i) {
+		BufferClass bufferClass = static_cast<BufferClass>(i);
+		ClassStats classStats = stats(bufferClass);
+		if (classStats.blocks == 0) continue;
+		out << "  " << std::left << std::setw(8) << className(bufferClass) << std::right
+			<< classStats.allocations << " allocation(s) in " << classStats.blocks << " block(s), "
+			<< std::fixed << std::setprecision(2) << classStats.usedBytes / (1024.0 * 1024.0) << " of "
+			<< classStats.reservedBytes / (1024.0 * 1024.0) << " MiB used, " << classStats.freeBlocks
+			<< " free range(s), largest " << classStats.largestFreeBlock / 1024.0 << " KiB, fragmentation "
+			<< std::setprecision(1) << 100.0 * classStats.fragmentation << "%" << std::defaultfloat << std::endl;
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "LifetimeTracker.h"
+#include "Tlsf.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// What a sub-allocated range is bound as. Each class has its own blocks, with its own usage flags.
+enum class BufferClass {
+	Vertex,
+	Index,
+	Uniform,
+	Count,
+};
+
+// A range of a shared buffer: bind `buffer` at `offset`, `size` bytes. The buffer belongs to
+// the allocator.
+struct BufferAllocation {
+	wgpu::Buffer buffer = nullptr;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	// where it came from, for GpuBufferAllocator::free
+	BufferClass bufferClass = BufferClass::Vertex;
+	uint32_t block = Tlsf::kInvalid;
+	uint32_t node = Tlsf::kInvalid;
+
+	bool isValid() const { return block != Tlsf::kInvalid; }
+};
+
+/**
+ * Sub-allocates vertex, index and uniform data from a few large buffers instead of creating one
+ * buffer per mesh. Each usage class grows by blocks of `blockSize` bytes, carved up by a Tlsf.
+ * Requests larger than a block get a block of their own. Blocks left empty are destroyed, except
+ * the last one of their class.
+ *
+ * free() makes the range available at once. While commands recorded or submitted may still read
+ * it, retire() it instead: the range is only freed once the GPU is done with it. Blocks that
+ * free() or trim() give back are destroyed through the LifetimeTracker in any case.
+ *
+ * Offsets honour the requested alignment: 4 is enough for vertex and index data (writeBuffer
+ * and setVertexBuffer / setIndexBuffer), uniforms bound at an offset need
+ * minUniformBufferOffsetAlignment.
+ */
+class GpuBufferAllocator {
+public:
+	struct ClassStats {
+		uint32_t blocks = 0;
+		uint32_t allocations = 0;
+		uint32_t freeBlocks = 0; // free ranges, not buffers
+		uint64_t reservedBytes = 0; // size of the GPU buffers
+		uint64_t usedBytes = 0;
+		uint64_t largestFreeBlock = 0;
+		double fragmentation = 0.0; // see Tlsf::Stats
+	};
+
+	~GpuBufferAllocator();
+
+	// Without `lifetimes`, blocks given back are destroyed right away
+	void initialize(wgpu::Device device, uint64_t blockSize = 4 << 20, LifetimeTracker* lifetimes = nullptr);
+	void terminate();
+
+	// An invalid allocation if the device could not create a block
+	BufferAllocation allocate(BufferClass bufferClass, uint64_t size, uint64_t alignment = 4);
+	void free(BufferAllocation& allocation);
+	// free() once the commands recorded so far completed. Until then a new allocation could be
+	// written over the range (writeBuffer runs before the pending submit), or its block destroyed
+	// under a submit that still uses it. `lifetimes` must run its actions before terminate().
+	void retire(BufferAllocation& allocation, LifetimeTracker& lifetimes);
+
+	// Over the memory budget: destroy empty blocks until `bytes` are freed. Returns the bytes freed.
+	uint64_t trim(uint64_t bytes);
+
+	ClassStats stats(BufferClass bufferClass) const;
+	// GPU buffers created so far, every block counts once
+	uint64_t createdBuffers() const { return blocksCreated; }
+	// One line per class in use
+	void report(std::ostream& out) const;
+
+private:
+	struct Block {
+		BufferClass bufferClass = BufferClass::Vertex;
+		wgpu::Buffer buffer = nullptr;
+		Tlsf tlsf;
+		bool inUse = false; // slot of a destroyed block otherwise
+	};
+
+	uint32_t createBlock(BufferClass bufferClass, uint64_t size);
+	void destroyBlock(Block& block);
+
+	wgpu::Device device = nullptr;
+	LifetimeTracker* lifetimes = nullptr;
+	uint64_t blockSize = 4 << 20;
+	std::vector<Block> blocks;
+	uint64_t blocksCreated = 0;
+};
@@ -0,0 +1,251 @@
+// GpuMemory.cpp
+#include "GpuMemory.h"
+#include "BlockCompression.h"
+#include "TexturePool.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace wgpu;
+
+namespace {
+
+struct Record {
+	uint64_t bytes = 0;
+	uint32_t usage = 0;
+	MemoryCategory category = MemoryCategory::Other;
+};
+
+struct Evictor {
+	uint32_t id = 0;
+	const char* name = nullptr;
+	GpuMemory::EvictionCallback callback;
+	uint64_t calls = 0;
+	uint64_t freedBytes = 0;
+};
+
+constexpr int kCategoryCount = static_cast<int>(MemoryCategory::Count);
+
+// everything behind one lock: creations are rare compared to what they cost the driver anyway
+struct State {
+	std::mutex mutex;
+	std::unordered_map<const void*, Record> records;
+	uint64_t current[kCategoryCount] = {};
+	uint64_t peak[kCategoryCount] = {};
+	uint32_t live[kCategoryCount] = {};
+	uint64_t total = 0;
+	uint64_t peakTotal = 0;
+	uint64_t budget = 0;
+	uint64_t overBudgetCreations = 0;
+	std::vector<Evictor> evictors;
+	uint32_t nextEvictorId = 1;
+};
+
+State& state() {
+	static State instance;
+	return instance;
+}
+
+const char* categoryName(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::Mesh: return "mesh";
+	case MemoryCategory::Uniform: return "uniform";
+	case MemoryCategory::RenderTarget: return "render target";
+	case MemoryCategory::Texture: return "texture";
+	case MemoryCategory::Staging: return "staging";
+	case MemoryCategory::Readback: return "readback";
+	default: return "other";
+	}
+}
+
+void track(const void* handle, uint64_t bytes, uint32_t usage, MemoryCategory category) {
+	if (handle == nullptr) return;
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	int index = static_cast<int>(category);
+	s.records[handle] = Record{ bytes, usage, category };
+	s.current[index] += bytes;
+	s.peak[index] = std::max(s.peak[index], s.current[index]);
+	++s.live[index];
+	s.total += bytes;
+	s.peakTotal = std::max(s.peakTotal, s.total);
+	if (s.budget > 0 && s.total > s.budget) {
+		++s.overBudgetCreations;
+	}
+}
+
+void forget(const void* handle) {
+	if (handle == nullptr) return;
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto found = s.records.find(handle);
+	if (found == s.records.end()) return;
+	int index = static_cast<int>(found->second.category);
+	s.current[index] -= found->second.bytes;
+	--s.live[index];
+	s.total -= found->second.bytes;
+	s.records.erase(found);
+}
+
+} // namespace
+
+uint64_t textureBytes(const TextureDescriptor& desc) {
+	uint64_t texel = textureFormatSize(desc.format);
+	// block compressed: whole 4x4 blocks, small mips included
+	uint64_t blockBytes = compressedBlockBytes(desc.format);
+	bool is3D = desc.dimension == TextureDimension::_3D;
+	uint64_t bytes = 0;
+	for (uint32_t level = 0; level < std::max(1u, desc.mipLevelCount); ++level) {
+		uint64_t width = std::max(1u, desc.size.width >> level);
+		uint64_t height = std::max(1u, desc.size.height >> level);
+		// array layers keep their count, 3D depth shrinks like the other dimensions
+		uint64_t depth = is3D ? std::max(1u, desc.size.depthOrArrayLayers >> level) : std::max(1u, desc.size.depthOrArrayLayers);
+		if (blockBytes > 0) {
+			bytes += (width + 3) / 4 * ((height + 3) / 4) * depth * blockBytes;
+		}
+		else {
+			bytes += width * height * depth * texel;
+		}
+	}
+	return bytes * std::max(1u, desc.sampleCount);
+}
+
+Buffer GpuMemory::createBuffer(Device device, const BufferDescriptor& desc, MemoryCategory category) {
+	Buffer buffer = device.createBuffer(desc);
+	track(static_cast<WGPUBuffer>(buffer), desc.size, desc.usage, category);
+	return buffer;
+}
+
+Texture GpuMemory::createTexture(Device device, const TextureDescriptor& desc, MemoryCategory category) {
+	Texture texture = device.createTexture(desc);
+	track(static_cast<WGPUTexture>(texture), textureBytes(desc), desc.usage, category);
+	return texture;
+}
+
+void GpuMemory::untrack(Buffer buffer) {
+	forget(static_cast<WGPUBuffer>(buffer));
+}
+
+void GpuMemory::untrack(Texture texture) {
+	forget(static_cast<WGPUTexture>(texture));
+}
+
+uint64_t GpuMemory::currentBytes(MemoryCategory category) {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return s.current[static_cast<int>(category)];
+}
+
+uint64_t GpuMemory::peakBytes(MemoryCategory category) {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return s.peak[static_cast<int>(category)];
+}
+
+uint64_t GpuMemory::totalBytes() {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return s.total;
+}
+
+uint64_t GpuMemory::peakTotalBytes() {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return s.peakTotal;
+}
+
+void GpuMemory::setBudget(uint64_t bytes) {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	s.budget = bytes;
+}
+
+uint64_t GpuMemory::budget() {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return s.budget;
+}
+
+bool GpuMemory::isOverBudget() {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return s.budget > 0 && s.total > s.budget;
+}
+
+uint32_t GpuMemory::addEvictionCallback(const char* name, EvictionCallback callback) {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	Evictor evictor;
+	evictor.id = s.nextEvictorId++;
+	evictor.name = name;
+	evictor.callback = std::move(callback);
+	s.evictors.push_back(std::move(evictor));
+	return s.evictors.back().id;
+}
+
+void GpuMemory::removeEvictionCallback(uint32_t id) {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	s.evictors.erase(std::remove_if(s.evictors.begin(), s.evictors.end(), [id](const Evictor& evictor) {
+		return evictor.id == id;
+	}), s.evictors.end());
+}
+
+uint64_t GpuMemory::enforceBudget() {
+	State& s = state();
+	std::vector<Evictor> evictors;
+	uint64_t excess = 0;
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		if (s.budget == 0 || s.total <= s.budget) return 0;
+		excess = s.total - s.budget;
+		evictors = s.evictors;
+	}
+
+	// the callbacks destroy resources, which untracks them: no lock held while they run
+	uint64_t freed = 0;
+	std::vector<uint64_t> freedBy(evictors.size(), 0);
+	for (size_t i = 0; i < evictors.size() && freed < excess; ++i) {
+		freedBy[i] = evictors[i].callback(excess - freed);
+		freed += freedBy[i];
+	}
+
+	std::lock_guard<std::mutex> lock(s.mutex);
+	for (size_t i = 0; i < evictors.size(); ++i) {
+		if (freedBy[i] == 0) continue;
+		for (Evictor& evictor : s.evictors) {
+			if (evictor.id != evictors[i].id) continue;
+			++evictor.calls;
+			evictor.freedBytes += freedBy[i];
+		}
+	}
+	return freed;
+}
+
+void GpuMemory::report(std::ostream& out) {
+	State& s = state();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto mib = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+	out << "GPU memory: " << std::fixed << std::setprecision(2) << mib(s.total) << " MiB in use, peak "
+		<< mib(s.peakTotal) << " MiB";
+	if (s.budget > 0) {
+		out << ", budget " << mib(s.budget) << " MiB (" << s.overBudgetCreations << " creation(s) over it)";
+	}
+	out << std::endl;
+	for (int i = 0; i < kCategoryCount; ++i) {
+		if (s.peak[i] == 0) continue;
+		out << "  " << std::left << std::setw(14) << categoryName(static_cast<MemoryCategory>(i)) << std::right
+			<< std::setw(9) << mib(s.current[i]) << " MiB in " << s.live[i] << " resource(s), peak "
+			<< mib(s.peak[i]) << " MiB" << std::endl;
+	}
+	for (const Evictor& evictor : s.evictors) {
+		if (evictor.calls == 0) continue;
+		out << "  evicted by " << evictor.name << ": " << mib(evictor.freedBytes) << " MiB in " << evictor.calls
+			<< " call(s)" << std::endl;
+	}
+	out << std::defaultfloat;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+// What GPU memory is spent on, for the report and for whoever gets asked to give some back
+enum class MemoryCategory {
+	Mesh, // vertex and index data
+	Uniform,
+	RenderTarget, // attachments and other textures written by passes
+	Texture, // sampled images loaded from files
+	Staging, // upload chunks
+	Readback, // frames and timestamps coming back to the CPU
+	Other, // e.g. compute outputs and query resolves
+	Count,
+};
+
+/**
+ * Accounting layer every buffer and texture of the App is created through. It records the size,
+ * usage and category of each one, keeps current and peak bytes per category, and holds the GPU
+ * memory budget.
+ *
+ * Going over the budget does not fail a creation: enforceBudget(), called once per frame between
+ * frames, asks the registered pools and caches to evict until the total fits again. Asking them
+ * from inside a creation would have them evict while one of them may be halfway through its own
+ * bookkeeping.
+ *
+ * Sizes are what we asked for (texture mips included), drivers round them up and add their own.
+ * Like Trace everything is static, since all the subsystems create resources.
+ */
+class GpuMemory {
+public:
+	// Asked to free at least `bytes`, returns how much it did free
+	using EvictionCallback = std::function<uint64_t(uint64_t bytes)>;
+
+	static wgpu::Buffer createBuffer(wgpu::Device device, const wgpu::BufferDescriptor& desc, MemoryCategory category);
+	static wgpu::Texture createTexture(wgpu::Device device, const wgpu::TextureDescriptor& desc, MemoryCategory category);
+	// Forget a resource that goes away (before its release). Untracked ones are ignored.
+	static void untrack(wgpu::Buffer buffer);
+	static void untrack(wgpu::Texture texture);
+
+	static uint64_t currentBytes(MemoryCategory category);
+	static uint64_t peakBytes(MemoryCategory category);
+	static uint64_t totalBytes();
+	static uint64_t peakTotalBytes();
+
+	// 0 = no budget
+	static void setBudget(uint64_t bytes);
+	static uint64_t budget();
+	static bool isOverBudget();
+
+	// Callbacks are asked in registration order, so register the cheapest to refill first.
+	// Returns an id for removeEvictionCallback.
+	static uint32_t addEvictionCallback(const char* name, EvictionCallback callback);
+	static void removeEvictionCallback(uint32_t id);
+	// Over budget: ask the callbacks for the difference. Returns the bytes they freed.
+	static uint64_t enforceBudget();
+
+	static void report(std::ostream& out);
+};
+
+// Bytes a texture described by `desc` takes, all mips and layers, before driver padding
+uint64_t textureBytes(const wgpu::TextureDescriptor& desc);
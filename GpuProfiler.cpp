@@ -0,0 +1,192 @@
+// GpuProfiler.cpp
+#include "GpuProfiler.h"
+#include "GpuMemory.h"
+#include "Stats.h"
+
+using namespace wgpu;
+
+bool GpuProfiler::isSupported(Adapter adapter) {
+	return adapter.hasFeature(FeatureName::TimestampQuery);
+}
+
+void GpuProfiler::initialize(Device gpuDevice, Queue gpuQueue, bool isEnabled) {
+	enabled = isEnabled;
+	if (!enabled) {
+		return;
+	}
+	device = gpuDevice;
+	queue = gpuQueue;
+
+	uint64_t resultsSize = 2 * kMaxPasses * sizeof(uint64_t);
+	slots.resize(kFramesInFlight);
+	for (Slot& slot : slots) {
+		QuerySetDescriptor querySetDesc = {};
+		querySetDesc.label = "Pass timestamps";
+		querySetDesc.type = QueryType::Timestamp;
+		querySetDesc.count = 2 * kMaxPasses; // begin and end of each pass
+		slot.querySet = device.createQuerySet(querySetDesc);
+
+		BufferDescriptor bufferDesc = {};
+		bufferDesc.label = "Timestamp resolve";
+		bufferDesc.size = resultsSize;
+		bufferDesc.usage = BufferUsage::QueryResolve | BufferUsage::CopySrc;
+		bufferDesc.mappedAtCreation = false;
+		slot.resolveBuffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Other);
+
+		// query resolve buffers can't be mapped, hence the extra copy
+		bufferDesc.label = "Timestamp readback";
+		bufferDesc.usage = BufferUsage::MapRead | BufferUsage::CopyDst;
+		slot.readbackBuffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Readback);
+
+		slot.passNames.reserve(kMaxPasses);
+		slot.renderWrites.reserve(kMaxPasses);
+		slot.computeWrites.reserve(kMaxPasses);
+	}
+}
+
+void GpuProfiler::terminate() {
+	for (Slot& slot : slots) {
+		GpuMemory::untrack(slot.readbackBuffer);
+		GpuMemory::untrack(slot.resolveBuffer);
+		slot.readbackBuffer.release();
+		slot.resolveBuffer.release();
+		slot.querySet.release();
+		// only now drop the callback: releasing a buffer with a pending map may still invoke it
+		slot.mapCallback.reset();
+	}
+	slots.clear();
+	current = nullptr;
+	submitted = nullptr;
+	enabled = false;
+}
+
+void GpuProfiler::beginFrame() {
+	current = nullptr;
+	if (!enabled) {
+		return;
+	}
+	Slot& slot = slots[nextSlot];
+	if (slot.busy) {
+		// readback of that slot is still in flight, skip this frame rather than wait
+		return;
+	}
+	nextSlot = (nextSlot + 1) % kFramesInFlight;
+	slot.passNames.clear();
+	slot.renderWrites.clear();
+	slot.computeWrites.clear();
+	current = &slot;
+}
+
+int GpuProfiler::allocatePass(const char* name) {
+	if (current == nullptr || current->passNames.size() >= kMaxPasses) {
+		return -1;
+	}
+	int first = static_cast<int>(2 * current->passNames.size());
+	current->passNames.emplace_back(name);
+	return first;
+}
+
+const RenderPassTimestampWrites* GpuProfiler::renderPass(const char* name) {
+	int first = allocatePass(name);
+	if (first < 0) {
+		return nullptr;
+	}
+	RenderPassTimestampWrites writes = {};
+	writes.querySet = current->querySet;
+	writes.beginningOfPassWriteIndex = static_cast<uint32_t>(first);
+	writes.endOfPassWriteIndex = static_cast<uint32_t>(first + 1);
+	current->renderWrites.push_back(writes);
+	return &current->renderWrites.back();
+}
+
+const ComputePassTimestampWrites* GpuProfiler::computePass(const char* name) {
+	int first = allocatePass(name);
+	if (first < 0) {
+		return nullptr;
+	}
+	ComputePassTimestampWrites writes = {};
+	writes.querySet = current->querySet;
+	writes.beginningOfPassWriteIndex = static_cast<uint32_t>(first);
+	writes.endOfPassWriteIndex = static_cast<uint32_t>(first + 1);
+	current->computeWrites.push_back(writes);
+	return &current->computeWrites.back();
+}
+
+void GpuProfiler::endFrame(CommandEncoder encoder) {
+	submitted = nullptr;
+	if (current == nullptr || current->passNames.empty()) {
+		current = nullptr;
+		return;
+	}
+	uint32_t queryCount = static_cast<uint32_t>(2 * current->passNames.size());
+	uint64_t size = queryCount * sizeof(uint64_t);
+	encoder.resolveQuerySet(current->querySet, 0, queryCount, current->resolveBuffer, 0);
+	encoder.copyBufferToBuffer(current->resolveBuffer, 0, current->readbackBuffer, 0, size);
+	current->busy = true;
+	submitted = current;
+	current = nullptr;
+}
+
+void GpuProfiler::afterSubmit() {
+	if (submitted == nullptr) {
+		return;
+	}
+	Slot& slot = *submitted;
+	submitted = nullptr;
+	uint64_t size = 2 * slot.passNames.size() * sizeof(uint64_t);
+	slot.mapCallback = slot.readbackBuffer.mapAsync(MapMode::Read, 0, size, [this, &slot](BufferMapAsyncStatus status) {
+		if (status == BufferMapAsyncStatus::Success) {
+			readResults(slot);
+			slot.readbackBuffer.unmap();
+		}
+		slot.busy = false;
+	});
+}
+
+bool GpuProfiler::hasPendingReadback() const {
+	for (const Slot& slot : slots) {
+		if (slot.busy) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void GpuProfiler::readResults(Slot& slot) {
+	uint64_t size = 2 * slot.passNames.size() * sizeof(uint64_t);
+	const uint64_t* timestamps = reinterpret_cast<const uint64_t*>(slot.readbackBuffer.getConstMappedRange(0, size));
+	double totalMs = 0.0;
+	for (size_t i = 0; i < slot.passNames.size(); ++i) {
+		uint64_t begin = timestamps[2 * i];
+		uint64_t end = timestamps[2 * i + 1];
+		// some drivers report garbage when the pass got reordered or the clock was reset
+		if (end < begin) {
+			continue;
+		}
+		// timestamps are in nanoseconds
+		double ms = static_cast<double>(end - begin) * 1e-6;
+		totalMs += ms;
+		std::deque<double>& samples = history[slot.passNames[i]];
+		samples.push_back(ms);
+		if (samples.size() > kHistorySize) {
+			samples.pop_front();
+		}
+	}
+	lastFrameTotalMs = totalMs;
+}
+
+void GpuProfiler::report(std::ostream& out) const {
+	if (!enabled) {
+		out << "GPU profiler: TimestampQuery not available" << std::endl;
+		return;
+	}
+	out << "GPU pass times (ms, last " << kHistorySize << " frames):" << std::endl;
+	for (const auto& [name, samples] : history) {
+		Summary summary = Summary::of(std::vector<double>(samples.begin(), samples.end()));
+		out << "  " << name
+			<< ": avg " << summary.mean
+			<< "  p50 " << summary.p50
+			<< "  p95 " << summary.p95
+			<< "  p99 " << summary.p99 << std::endl;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Measures GPU time spent in named render and compute passes with timestamp queries.
+ *
+ * Each frame in flight owns a QuerySet, a resolve buffer and a readback buffer. Results are read
+ * with mapAsync a few frames later, so the CPU never waits for the GPU. A frame whose slot is still
+ * being read back is simply not profiled. Without the TimestampQuery feature every call is a no-op
+ * and the pass getters return nullptr, which is what the descriptors expect for "no timestamps".
+ */
+class GpuProfiler {
+public:
+	// Whether the adapter can do it, the feature must then be requested on the device
+	static bool isSupported(wgpu::Adapter adapter);
+
+	// `enabled` is false when TimestampQuery was not granted
+	void initialize(wgpu::Device device, wgpu::Queue queue, bool enabled);
+	void terminate();
+	bool isEnabled() const { return enabled; }
+
+	// Call once per frame before recording any pass
+	void beginFrame();
+
+	// Timestamp writes to put into a pass descriptor, nullptr when this pass is not profiled
+	const wgpu::RenderPassTimestampWrites* renderPass(const char* name);
+	const wgpu::ComputePassTimestampWrites* computePass(const char* name);
+
+	// Resolve the frame's queries into its readback buffer, before finishing `encoder`
+	void endFrame(wgpu::CommandEncoder encoder);
+	// Request the readback of the frame that was just submitted
+	void afterSubmit();
+
+	// Whether some profiled frame is not read back yet: poll the device until it is to get the
+	// results of everything submitted so far
+	bool hasPendingReadback() const;
+
+	// Sum of all passes of the most recently read back frame, negative if none yet
+	double lastFrameMs() const { return lastFrameTotalMs; }
+
+	// Per pass rolling average and percentiles over the last frames
+	void report(std::ostream& out) const;
+
+private:
+	static constexpr uint32_t kFramesInFlight = 4;
+	static constexpr uint32_t kMaxPasses = 16; // per frame
+	static constexpr size_t kHistorySize = 240; // frames kept for the rolling stats
+
+	struct Slot {
+		wgpu::QuerySet querySet = nullptr;
+		wgpu::Buffer resolveBuffer = nullptr;
+		wgpu::Buffer readbackBuffer = nullptr;
+		std::vector<std::string> passNames;
+		// reserved to kMaxPasses so that pointers handed out stay valid while recording
+		std::vector<wgpu::RenderPassTimestampWrites> renderWrites;
+		std::vector<wgpu::ComputePassTimestampWrites> computeWrites;
+		bool busy = false; // recorded and not read back yet
+		std::unique_ptr<wgpu::BufferMapCallback> mapCallback;
+	};
+
+	// reserve a begin/end query pair for `name`, return its first index or -1
+	int allocatePass(const char* name);
+	void readResults(Slot& slot);
+
+	bool enabled = false;
+	wgpu::Device device = nullptr;
+	wgpu::Queue queue = nullptr;
+	std::vector<Slot> slots;
+	uint32_t nextSlot = 0;
+	Slot* current = nullptr; // slot of the frame being recorded, nullptr if not profiled
+	Slot* submitted = nullptr; // slot resolved in endFrame, waiting for afterSubmit
+	std::map<std::string, std::deque<double>> history;
+	double lastFrameTotalMs = -1.0;
+};
@@ -0,0 +1,93 @@
+// LifetimeTracker.cpp
+#include "LifetimeTracker.h"
+#include "GpuMemory.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace wgpu;
+
+LifetimeTracker::~LifetimeTracker() {
+	terminate();
+}
+
+void LifetimeTracker::initialize(Queue gpuQueue) {
+	queue = gpuQueue;
+	submitted = 0;
+	completed = 0;
+}
+
+void LifetimeTracker::terminate() {
+	// nothing will complete anymore, run everything in order
+	for (Deferred& deferred : actions) {
+		deferred.action();
+	}
+	actions.clear();
+	// after the queue is gone, pending callbacks may still report back through them
+	callbacks.clear();
+	firedCallbacks = 0;
+	queue = nullptr;
+}
+
+void LifetimeTracker::onSubmit() {
+	// callbacks fire in submission order, the ones that did are at the front
+	for (; firedCallbacks > 0; --firedCallbacks) {
+		callbacks.pop_front();
+	}
+
+	uint64_t submission = ++submitted;
+	callbacks.push_back(queue.onSubmittedWorkDone([this, submission](QueueWorkDoneStatus) {
+		// a lost device will not run anything anymore either, so any status retires it
+		completed = std::max(completed, submission);
+		++firedCallbacks;
+	}));
+}
+
+void LifetimeTracker::defer(uint64_t submission, std::function<void()> action) {
+	if (isComplete(submission)) {
+		++immediateCount;
+		action();
+		return;
+	}
+	// keep `actions` sorted, later submissions are the common case
+	auto position = actions.end();
+	while (position != actions.begin() && std::prev(position)->submission > submission) {
+		--position;
+	}
+	actions.insert(position, Deferred{ submission, std::move(action) });
+	++deferredCount;
+	maxPending = std::max<uint64_t>(maxPending, actions.size());
+}
+
+void LifetimeTracker::release(Buffer buffer) {
+	defer([buffer]() mutable {
+		GpuMemory::untrack(buffer);
+		buffer.destroy();
+		buffer.release();
+	});
+}
+
+void LifetimeTracker::release(Texture texture) {
+	defer([texture]() mutable {
+		GpuMemory::untrack(texture);
+		texture.destroy();
+		texture.release();
+	});
+}
+
+void LifetimeTracker::collect() {
+	TRACE_SCOPE("collect retired");
+	while (!actions.empty() && isComplete(actions.front().submission)) {
+		// an action may defer more work, take it out first
+		std::function<void()> action = std::move(actions.front().action);
+		actions.pop_front();
+		action();
+	}
+}
+
+void LifetimeTracker::report(std::ostream& out) const {
+	out << "Lifetime tracker: " << submitted << " submit(s), " << completed << " completed, " << deferredCount
+		<< " deferred release(s) (at most " << maxPending << " pending at once), " << immediateCount
+		<< " immediate" << std::endl;
+}
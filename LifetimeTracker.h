@@ -0,0 +1,64 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <ostream>
+
+/**
+ * Defers freeing GPU resources until the GPU is done with them.
+ *
+ * Every submit is stamped with an increasing index, and onSubmittedWorkDone retires indices in
+ * order. Something used by commands recorded now is last used by the upcoming submission
+ * (pendingSubmission()): an action deferred to it runs once that submission completed, from
+ * collect(), and never blocks. Until then the resource must not be touched from the CPU side,
+ * which includes handing its memory to someone else who would writeBuffer into it, or destroying
+ * it before the commands using it were even submitted.
+ */
+class LifetimeTracker {
+public:
+	~LifetimeTracker();
+
+	void initialize(wgpu::Queue queue);
+	// Runs whatever is still deferred: call once the device is done, before releasing it
+	void terminate();
+
+	// Stamp the submit that was just made
+	void onSubmit();
+	// Index the next submit will get, which the commands being recorded belong to
+	uint64_t pendingSubmission() const { return submitted + 1; }
+	bool isComplete(uint64_t submission) const { return submission <= completed; }
+
+	// Run `action` once `submission` completed, right away if it already did
+	void defer(uint64_t submission, std::function<void()> action);
+	// Same, for what commands recorded so far may use
+	void defer(std::function<void()> action) { defer(pendingSubmission(), std::move(action)); }
+	// destroy() and release() once the commands recorded so far completed
+	void release(wgpu::Buffer buffer);
+	void release(wgpu::Texture texture);
+
+	// Run the actions of completed submissions. Once per frame, after polling the device.
+	void collect();
+
+	uint64_t pendingActions() const { return actions.size(); }
+	void report(std::ostream& out) const;
+
+private:
+	struct Deferred {
+		uint64_t submission = 0;
+		std::function<void()> action;
+	};
+
+	wgpu::Queue queue = nullptr;
+	uint64_t submitted = 0;
+	uint64_t completed = 0;
+	std::deque<std::unique_ptr<wgpu::QueueWorkDoneCallback>> callbacks;
+	uint32_t firedCallbacks = 0; // at the front of `callbacks`
+	// in submission order, the deferred ones only ever target the pending submission or older
+	std::deque<Deferred> actions;
+	uint64_t deferredCount = 0;
+	uint64_t immediateCount = 0;
+	uint64_t maxPending = 0;
+};
@@ -0,0 +1,348 @@
+// MipmapGenerator.cpp
+#include "MipmapGenerator.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "ResourceManager.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace wgpu;
+
+namespace {
+uint32_t levelSize(uint32_t size, uint32_t level) {
+	return std::max(1u, size >> level);
+}
+} // namespace
+
+bool MipmapGenerator::initialize(Device gpuDevice) {
+	device = gpuDevice;
+
+	ShaderModule shaderModule = ResourceManager::loadShaderModule(RESOURCE_DIR "/mipmap.wgsl", device);
+	if (shaderModule == nullptr) {
+		std::cerr << "Could not load mipmap shader" << std::endl;
+		return false;
+	}
+
+	// source level, the 4 levels below it, parameters
+	std::vector<BindGroupLayoutEntry> bindingLayouts(6, Default);
+	bindingLayouts[0].binding = 0;
+	bindingLayouts[0].visibility = ShaderStage::Compute;
+	bindingLayouts[0].texture.sampleType = TextureSampleType::Float;
+	bindingLayouts[0].texture.viewDimension = TextureViewDimension::_2D;
+	for (uint32_t i = 1; i <= kMaxLevelsPerDispatch; ++i) {
+		bindingLayouts[i].binding = i;
+		bindingLayouts[i].visibility = ShaderStage::Compute;
+		bindingLayouts[i].storageTexture.access = StorageTextureAccess::WriteOnly;
+		bindingLayouts[i].storageTexture.format = TextureFormat::RGBA8Unorm;
+		bindingLayouts[i].storageTexture.viewDimension = TextureViewDimension::_2D;
+	}
+	bindingLayouts[5].binding = 5;
+	bindingLayouts[5].visibility = ShaderStage::Compute;
+	bindingLayouts[5].buffer.type = BufferBindingType::Uniform;
+	bindingLayouts[5].buffer.minBindingSize = sizeof(Params);
+
+	BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+	bindGroupLayoutDesc.entryCount = static_cast<uint32_t>(bindingLayouts.size());
+	bindGroupLayoutDesc.entries = bindingLayouts.data();
+	bindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
+
+	PipelineLayoutDescriptor layoutDesc{};
+	layoutDesc.bindGroupLayoutCount = 1;
+	layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
+	layout = device.createPipelineLayout(layoutDesc);
+
+	ComputePipelineDescriptor pipelineDesc{};
+	pipelineDesc.label = "Mipmaps";
+	pipelineDesc.layout = layout;
+	pipelineDesc.compute.module = shaderModule;
+	pipelineDesc.compute.entryPoint = "cs_main";
+	pipelineDesc.compute.constantCount = 0;
+	pipelineDesc.compute.constants = nullptr;
+	pipeline = device.createComputePipeline(pipelineDesc);
+	shaderModule.release();
+
+	TextureDescriptor scratchDesc = {};
+	scratchDesc.label = "Mipmap scratch";
+	scratchDesc.dimension = TextureDimension::_2D;
+	scratchDesc.size = { 1, 1, 1 };
+	scratchDesc.format = TextureFormat::RGBA8Unorm;
+	scratchDesc.usage = TextureUsage::StorageBinding;
+	scratchDesc.mipLevelCount = 1;
+	scratchDesc.sampleCount = 1;
+	scratchDesc.viewFormatCount = 0;
+	scratchDesc.viewFormats = nullptr;
+	scratchTexture = GpuMemory::createTexture(device, scratchDesc, MemoryCategory::Other);
+	scratchView = wgpuTextureCreateView(scratchTexture, nullptr);
+
+	// the naive way
+	ShaderModule blitModule = ResourceManager::loadShaderModule(RESOURCE_DIR "/mip_blit.wgsl", device);
+	if (blitModule == nullptr) {
+		std::cerr << "Could not load mip blit shader" << std::endl;
+		return false;
+	}
+
+	std::vector<BindGroupLayoutEntry> blitBindingLayouts(2, Default);
+	blitBindingLayouts[0].binding = 0;
+	blitBindingLayouts[0].visibility = ShaderStage::Fragment;
+	blitBindingLayouts[0].texture.sampleType = TextureSampleType::Float;
+	blitBindingLayouts[0].texture.viewDimension = TextureViewDimension::_2D;
+	blitBindingLayouts[1].binding = 1;
+	blitBindingLayouts[1].visibility = ShaderStage::Fragment;
+	blitBindingLayouts[1].sampler.type = SamplerBindingType::Filtering;
+
+	bindGroupLayoutDesc.entryCount = static_cast<uint32_t>(blitBindingLayouts.size());
+	bindGroupLayoutDesc.entries = blitBindingLayouts.data();
+	blitBindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
+
+	layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&blitBindGroupLayout;
+	blitLayout = device.createPipelineLayout(layoutDesc);
+
+	RenderPipelineDescriptor blitDesc;
+	blitDesc.label = "Mip blit";
+	blitDesc.vertex.bufferCount = 0;
+	blitDesc.vertex.buffers = nullptr;
+	blitDesc.vertex.module = blitModule;
+	blitDesc.vertex.entryPoint = "vs_main";
+	blitDesc.vertex.constantCount = 0;
+	blitDesc.vertex.constants = nullptr;
+	blitDesc.primitive.topology = PrimitiveTopology::TriangleList;
+	blitDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+	blitDesc.primitive.frontFace = FrontFace::CCW;
+	blitDesc.primitive.cullMode = CullMode::None;
+
+	ColorTargetState colorTarget;
+	colorTarget.format = TextureFormat::RGBA8Unorm;
+	colorTarget.blend = nullptr;
+	colorTarget.writeMask = ColorWriteMask::All;
+
+	FragmentState fragmentState;
+	fragmentState.module = blitModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	blitDesc.fragment = &fragmentState;
+	blitDesc.depthStencil = nullptr;
+	blitDesc.multisample.count = 1;
+	blitDesc.multisample.mask = ~0u;
+	blitDesc.multisample.alphaToCoverageEnabled = false;
+	blitDesc.layout = blitLayout;
+	blitPipeline = device.createRenderPipeline(blitDesc);
+	colorTarget.format = TextureFormat::RGBA8UnormSrgb;
+	blitSrgbPipeline = device.createRenderPipeline(blitDesc);
+	blitModule.release();
+
+	// sampling at the center of each 2x2 block, the previous level only
+	SamplerDescriptor samplerDesc;
+	samplerDesc.addressModeU = AddressMode::ClampToEdge;
+	samplerDesc.addressModeV = AddressMode::ClampToEdge;
+	samplerDesc.addressModeW = AddressMode::ClampToEdge;
+	samplerDesc.magFilter = FilterMode::Linear;
+	samplerDesc.minFilter = FilterMode::Linear;
+	samplerDesc.mipmapFilter = MipmapFilterMode::Nearest;
+	samplerDesc.lodMinClamp = 0.0f;
+	samplerDesc.lodMaxClamp = 0.0f;
+	samplerDesc.compare = CompareFunction::Undefined;
+	samplerDesc.maxAnisotropy = 1;
+	blitSampler = device.createSampler(samplerDesc);
+	return true;
+}
+
+void MipmapGenerator::terminate() {
+	if (blitSampler) blitSampler.release();
+	if (blitSrgbPipeline) blitSrgbPipeline.release();
+	if (blitPipeline) blitPipeline.release();
+	if (blitLayout) blitLayout.release();
+	if (blitBindGroupLayout) blitBindGroupLayout.release();
+	if (scratchView) scratchView.release();
+	if (scratchTexture) {
+		GpuMemory::untrack(scratchTexture);
+		scratchTexture.destroy();
+		scratchTexture.release();
+	}
+	if (pipeline) pipeline.release();
+	if (layout) layout.release();
+	if (bindGroupLayout) bindGroupLayout.release();
+	blitSampler = nullptr;
+	blitSrgbPipeline = nullptr;
+	blitPipeline = nullptr;
+	blitLayout = nullptr;
+	blitBindGroupLayout = nullptr;
+	scratchView = nullptr;
+	scratchTexture = nullptr;
+	pipeline = nullptr;
+	layout = nullptr;
+	bindGroupLayout = nullptr;
+}
+
+uint32_t MipmapGenerator::mipLevelCount(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		++levels;
+	}
+	return levels;
+}
+
+TextureView MipmapGenerator::createLevelView(Texture texture, uint32_t level, TextureFormat format) {
+	TextureViewDescriptor viewDesc = {};
+	viewDesc.format = format;
+	viewDesc.dimension = TextureViewDimension::_2D;
+	viewDesc.baseMipLevel = level;
+	viewDesc.mipLevelCount = 1;
+	viewDesc.baseArrayLayer = 0;
+	viewDesc.arrayLayerCount = 1;
+	viewDesc.aspect = TextureAspect::All;
+	return texture.createView(viewDesc);
+}
+
+uint32_t MipmapGenerator::generate(CommandEncoder encoder, Texture texture, uint32_t width, uint32_t height,
+	uint32_t levelCount, bool srgb, GpuProfiler* profiler) {
+	if (levelCount < 2 || pipeline == nullptr) return 0;
+	TRACE_SCOPE("generate mipmaps");
+
+	// Split the chain: a dispatch goes on to the next level only while the last one it wrote has
+	// an even size, i.e. while the next level is an exact 2x2 reduction of it.
+	struct Dispatch {
+		uint32_t sourceLevel;
+		uint32_t levels;
+	};
+	std::vector<Dispatch> dispatches;
+	for (uint32_t level = 0; level + 1 < levelCount;) {
+		uint32_t levels = 1;
+		while (levels < kMaxLevelsPerDispatch && level + levels + 1 < levelCount) {
+			uint32_t lastWidth = levelSize(width, level + levels);
+			uint32_t lastHeight = levelSize(height, level + levels);
+			if ((lastWidth & 1) || (lastHeight & 1)) break;
+			++levels;
+		}
+		dispatches.push_back({ level, levels });
+		level += levels;
+	}
+
+	// Parameters in a buffer of this call's own, so that several textures can be recorded before
+	// a submit (queue.writeBuffer would land them all before it). The command buffer keeps it
+	// alive once released.
+	BufferDescriptor bufferDesc = {};
+	bufferDesc.label = "Mipmap parameters";
+	bufferDesc.size = dispatches.size() * kParamsStride;
+	bufferDesc.usage = BufferUsage::Uniform;
+	bufferDesc.mappedAtCreation = true;
+	Buffer paramsBuffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Uniform);
+	uint8_t* mapped = static_cast<uint8_t*>(paramsBuffer.getMappedRange(0, bufferDesc.size));
+	for (size_t i = 0; i < dispatches.size(); ++i) {
+		Params params = {};
+		params.levelCount = dispatches[i].levels;
+		params.srgb = srgb ? 1 : 0;
+		std::memcpy(mapped + i * kParamsStride, &params, sizeof(Params));
+	}
+	paramsBuffer.unmap();
+
+	std::vector<TextureView> views;
+	std::vector<BindGroup> bindGroups;
+	for (size_t i = 0; i < dispatches.size(); ++i) {
+		const Dispatch& dispatch = dispatches[i];
+		std::vector<BindGroupEntry> bindings(6);
+		bindings[0].binding = 0;
+		views.push_back(createLevelView(texture, dispatch.sourceLevel, TextureFormat::RGBA8Unorm));
+		bindings[0].textureView = views.back();
+		for (uint32_t j = 1; j <= kMaxLevelsPerDispatch; ++j) {
+			bindings[j].binding = j;
+			if (j <= dispatch.levels) {
+				views.push_back(createLevelView(texture, dispatch.sourceLevel + j, TextureFormat::RGBA8Unorm));
+				bindings[j].textureView = views.back();
+			}
+			else {
+				bindings[j].textureView = scratchView;
+			}
+		}
+		bindings[5].binding = 5;
+		bindings[5].buffer = paramsBuffer;
+		bindings[5].offset = i * kParamsStride;
+		bindings[5].size = sizeof(Params);
+
+		BindGroupDescriptor bindGroupDesc{};
+		bindGroupDesc.layout = bindGroupLayout;
+		bindGroupDesc.entryCount = static_cast<uint32_t>(bindings.size());
+		bindGroupDesc.entries = bindings.data();
+		bindGroups.push_back(device.createBindGroup(bindGroupDesc));
+	}
+
+	// one pass for the whole chain: each dispatch sees the writes of the previous ones
+	ComputePassDescriptor passDesc = {};
+	passDesc.label = "Mipmaps";
+	passDesc.timestampWrites = profiler ? profiler->computePass("mipmaps") : nullptr;
+	ComputePassEncoder pass = encoder.beginComputePass(passDesc);
+	pass.setPipeline(pipeline);
+	for (size_t i = 0; i < dispatches.size(); ++i) {
+		// one 8x8 workgroup per 8x8 texels of the first level written
+		uint32_t firstWidth = levelSize(width, dispatches[i].sourceLevel + 1);
+		uint32_t firstHeight = levelSize(height, dispatches[i].sourceLevel + 1);
+		pass.setBindGroup(0, bindGroups[i], 0, nullptr);
+		pass.dispatchWorkgroups((firstWidth + 7) / 8, (firstHeight + 7) / 8, 1);
+	}
+	pass.end();
+	pass.release();
+
+	for (BindGroup& bindGroup : bindGroups) bindGroup.release();
+	for (TextureView& view : views) view.release();
+	GpuMemory::untrack(paramsBuffer);
+	paramsBuffer.release();
+	return static_cast<uint32_t>(dispatches.size());
+}
+
+uint32_t MipmapGenerator::generateWithBlits(CommandEncoder encoder, Texture texture, uint32_t levelCount, bool srgb,
+	GpuProfiler* profiler) {
+	if (levelCount < 2 || blitPipeline == nullptr) return 0;
+	TRACE_SCOPE("blit mipmaps");
+	TextureFormat format = srgb ? TextureFormat::RGBA8UnormSrgb : TextureFormat::RGBA8Unorm;
+
+	for (uint32_t level = 1; level < levelCount; ++level) {
+		TextureView source = createLevelView(texture, level - 1, format);
+		TextureView target = createLevelView(texture, level, format);
+
+		std::vector<BindGroupEntry> bindings(2);
+		bindings[0].binding = 0;
+		bindings[0].textureView = source;
+		bindings[1].binding = 1;
+		bindings[1].sampler = blitSampler;
+		BindGroupDescriptor bindGroupDesc{};
+		bindGroupDesc.layout = blitBindGroupLayout;
+		bindGroupDesc.entryCount = static_cast<uint32_t>(bindings.size());
+		bindGroupDesc.entries = bindings.data();
+		BindGroup bindGroup = device.createBindGroup(bindGroupDesc);
+
+		RenderPassColorAttachment colorAttachment = {};
+		colorAttachment.view = target;
+		colorAttachment.resolveTarget = nullptr;
+		colorAttachment.loadOp = LoadOp::Clear;
+		colorAttachment.storeOp = StoreOp::Store;
+		colorAttachment.clearValue = WGPUColor{ 0.0, 0.0, 0.0, 0.0 };
+#ifndef WEBGPU_BACKEND_WGPU
+		colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+#endif
+
+		RenderPassDescriptor passDesc = {};
+		passDesc.label = "Mip blit";
+		passDesc.colorAttachmentCount = 1;
+		passDesc.colorAttachments = &colorAttachment;
+		passDesc.depthStencilAttachment = nullptr;
+		passDesc.timestampWrites = profiler ? profiler->renderPass("mip blits") : nullptr;
+
+		RenderPassEncoder pass = encoder.beginRenderPass(passDesc);
+		pass.setPipeline(srgb ? blitSrgbPipeline : blitPipeline);
+		pass.setBindGroup(0, bindGroup, 0, nullptr);
+		pass.draw(3, 1, 0, 0);
+		pass.end();
+		pass.release();
+
+		bindGroup.release();
+		target.release();
+		source.release();
+	}
+	return levelCount - 1;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+
+class GpuProfiler;
+
+/**
+ * Fills the mip chain of a texture from its level 0 with a compute shader, see
+ * resources/mipmap.wgsl: one dispatch writes up to four levels, the small ones reduced in
+ * workgroup memory. A 2048x2048 chain takes 3 dispatches in one compute pass where the render pass
+ * way takes 11 passes.
+ *
+ * Non power of two sizes get a proper box filter (odd axes use 3 taps) instead of dropping a row
+ * or column of texels at each level. Storage textures can't be sRGB, so textures to process are
+ * created RGBA8Unorm with RGBA8UnormSrgb in their view formats, sampled through an sRGB view, and
+ * the shader does the conversion when told the contents are sRGB.
+ *
+ * generateWithBlits() is the usual way, one render pass per level, kept for --mip-bench.
+ */
+class MipmapGenerator {
+public:
+	bool initialize(wgpu::Device device);
+	void terminate();
+
+	static uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+	/**
+	 * Record the generation of mips 1 to `levelCount - 1` of `texture` into `encoder`. The texture
+	 * must be RGBA8Unorm with TextureBinding and StorageBinding usages. `srgb`: the texels are
+	 * sRGB encoded, filtering then happens in linear space. Returns the number of dispatches.
+	 */
+	uint32_t generate(wgpu::CommandEncoder encoder, wgpu::Texture texture, uint32_t width, uint32_t height,
+		uint32_t levelCount, bool srgb, GpuProfiler* profiler = nullptr);
+
+	// Same result for power of two sizes, from one render pass per level (needs RenderAttachment,
+	// and an sRGB view format when `srgb`). Returns the number of passes.
+	uint32_t generateWithBlits(wgpu::CommandEncoder encoder, wgpu::Texture texture, uint32_t levelCount, bool srgb,
+		GpuProfiler* profiler = nullptr);
+
+private:
+	static constexpr uint32_t kMaxLevelsPerDispatch = 4;
+	// one parameter block per dispatch, at the largest possible uniform offset alignment
+	static constexpr uint64_t kParamsStride = 256;
+
+	struct Params {
+		uint32_t levelCount;
+		uint32_t srgb;
+		uint32_t _pad[2];
+	};
+	static_assert(sizeof(Params) % 16 == 0);
+
+	wgpu::TextureView createLevelView(wgpu::Texture texture, uint32_t level, wgpu::TextureFormat format);
+
+	wgpu::Device device = nullptr;
+	wgpu::BindGroupLayout bindGroupLayout = nullptr;
+	wgpu::PipelineLayout layout = nullptr;
+	wgpu::ComputePipeline pipeline = nullptr;
+	// bound to the outputs a dispatch does not write
+	wgpu::Texture scratchTexture = nullptr;
+	wgpu::TextureView scratchView = nullptr;
+
+	wgpu::BindGroupLayout blitBindGroupLayout = nullptr;
+	wgpu::PipelineLayout blitLayout = nullptr;
+	wgpu::RenderPipeline blitPipeline = nullptr; // into RGBA8Unorm views
+	wgpu::RenderPipeline blitSrgbPipeline = nullptr; // into RGBA8UnormSrgb views
+	wgpu::Sampler blitSampler = nullptr;
+};
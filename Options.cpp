@@ -0,0 +1,264 @@
+// Options.cpp
+#include "Options.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+namespace {
+
+void printUsage(const char* program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  --encode-threads N     threads recording draws (default: hardware threads)\n"
+		<< "  --encode-scaling DRAWS time encoding DRAWS draws on 1..N threads and exit\n"
+		<< "  --sort-bench PACKETS   time sorting PACKETS draw packets (e.g. 100000) and exit\n"
+		<< "  --alloc-bench N        time N buffer allocations, createBuffer against sub-allocation, and exit\n"
+		<< "  --staging-bench N      time N uploads per size, writeBuffer against the staging belt, and exit\n"
+		<< "  --memory-budget MIB    GPU memory budget, idle pooled memory is evicted above it\n"
+		<< "  --texture-bench N      time loading N generated image files with 1..all threads, and exit\n"
+		<< "  --mip-bench SIZE       time mipmap generation, compute against per level blits, and exit\n"
+		<< "  --compress-bench SIZE  load BC1 / BC3 / RGBA8 KTX2 textures, print the VRAM saved, and exit\n"
+		<< "  --texture PATH         texture the scene with a PPM / PGM, TGA or KTX2 image\n"
+		<< "  --no-compression       decompress KTX2 textures on the CPU even if the GPU has the format\n"
+		<< "  --depth MODE           off, on (default) or prepass (depth only pass, then Equal test)\n"
+		<< "  --overdraw             draw an overdraw heatmap instead of the scene\n"
+		<< "  --on-demand            render only on input, resize or animation, idle otherwise\n"
+		<< "  --paused               start with the animation stopped (P toggles it)\n"
+		<< "  --dynamic-res          scale the scene's resolution to fit the frame budget\n"
+		<< "  --frame-budget MS      frame time dynamic resolution aims for (default 14)\n"
+		<< "  --min-scale S          lowest resolution scale (default 0.5)\n"
+		<< "  --max-scale S          highest resolution scale, at most 1 (default 1)\n"
+		<< "  --startup-out PATH     write the startup phase timings to PATH as JSON\n"
+		<< "  --trace PATH           record CPU trace zones, written to PATH on exit or F9\n"
+		<< "  --headless             render offscreen without a window, frames saved as PNG\n"
+		<< "  --frames N             headless frames (default 1) or measured bench frames (default 300)\n"
+		<< "  --size WxH             headless resolution (default 640x480)\n"
+		<< "  --output DIR           directory for headless frames (default .)\n"
+		<< "  --software             request the fallback software adapter\n"
+		<< "  --readback-slots K     staging buffers used to read frames back (default 3)\n"
+		<< "  --drop-frames          drop frames instead of waiting when readback falls behind\n"
+		<< "  --capture FORMAT       headless readback: rgba (PNG), nv12 or i420 (GPU converted)\n"
+		<< "  --capture-out PATH     YUV destination: file (.y4m for I420), pipe, or - for stdout\n"
+		<< "  --shm NAME             publish headless frames to shared memory object NAME\n"
+		<< "  --shm-slots K          frames held by the shared memory ring (default 4)\n"
+		<< "  --bench                measure frame timings, works with --headless\n"
+		<< "  --warmup N             frames rendered before measuring (default 60)\n"
+		<< "  --bench-out PATH       write the benchmark JSON to PATH instead of stdout\n";
+}
+
+// read the value following argv[i] as a string
+bool readString(int argc, char* argv[], int& i, std::string& value) {
+	if (i + 1 >= argc) {
+		std::cerr << "Missing value for " << argv[i] << std::endl;
+		return false;
+	}
+	value = argv[++i];
+	return true;
+}
+
+// read the value following argv[i] as an unsigned integer
+bool readUint(int argc, char* argv[], int& i, uint32_t& value) {
+	if (i + 1 >= argc) {
+		std::cerr << "Missing value for " << argv[i] << std::endl;
+		return false;
+	}
+	char* end = nullptr;
+	unsigned long parsed = std::strtoul(argv[++i], &end, 10);
+	if (end == argv[i] || *end != '\0') {
+		std::cerr << "Expected a number for " << argv[i - 1] << ", got '" << argv[i] << "'" << std::endl;
+		return false;
+	}
+	value = static_cast<uint32_t>(parsed);
+	return true;
+}
+
+// read the value following argv[i] as a positive number
+bool readFloat(int argc, char* argv[], int& i, float& value) {
+	if (i + 1 >= argc) {
+		std::cerr << "Missing value for " << argv[i] << std::endl;
+		return false;
+	}
+	char* end = nullptr;
+	float parsed = std::strtof(argv[++i], &end);
+	if (end == argv[i] || *end != '\0' || !(parsed > 0.0f)) {
+		std::cerr << "Expected a positive number for " << argv[i - 1] << ", got '" << argv[i] << "'" << std::endl;
+		return false;
+	}
+	value = parsed;
+	return true;
+}
+
+// read the value following argv[i] as WIDTHxHEIGHT
+bool readSize(int argc, char* argv[], int& i, uint32_t& width, uint32_t& height) {
+	std::string value;
+	if (!readString(argc, argv, i, value)) {
+		return false;
+	}
+	unsigned long w = 0, h = 0;
+	char* end = nullptr;
+	w = std::strtoul(value.c_str(), &end, 10);
+	if (end == value.c_str() || (*end != 'x' && *end != 'X')) {
+		std::cerr << "Expected WIDTHxHEIGHT for " << argv[i - 1] << ", got '" << value << "'" << std::endl;
+		return false;
+	}
+	const char* heightStart = end + 1;
+	h = std::strtoul(heightStart, &end, 10);
+	if (end == heightStart || *end != '\0' || w == 0 || h == 0) {
+		std::cerr << "Expected WIDTHxHEIGHT for " << argv[i - 1] << ", got '" << value << "'" << std::endl;
+		return false;
+	}
+	width = static_cast<uint32_t>(w);
+	height = static_cast<uint32_t>(h);
+	return true;
+}
+
+} // namespace
+
+bool Options::parse(int argc, char* argv[], Options& options) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool ok = true;
+		if (arg == "--encode-threads") {
+			ok = readUint(argc, argv, i, options.encodeThreads);
+		}
+		else if (arg == "--encode-scaling") {
+			ok = readUint(argc, argv, i, options.encodeScalingDraws);
+		}
+		else if (arg == "--sort-bench") {
+			ok = readUint(argc, argv, i, options.sortBenchPackets);
+		}
+		else if (arg == "--startup-out") {
+			ok = readString(argc, argv, i, options.startupOutput);
+		}
+		else if (arg == "--alloc-bench") {
+			ok = readUint(argc, argv, i, options.allocBenchCount);
+		}
+		else if (arg == "--staging-bench") {
+			ok = readUint(argc, argv, i, options.stagingBenchUploads);
+		}
+		else if (arg == "--memory-budget") {
+			ok = readUint(argc, argv, i, options.memoryBudgetMiB);
+		}
+		else if (arg == "--texture-bench") {
+			ok = readUint(argc, argv, i, options.textureBenchCount);
+		}
+		else if (arg == "--mip-bench") {
+			ok = readUint(argc, argv, i, options.mipBenchSize);
+		}
+		else if (arg == "--compress-bench") {
+			ok = readUint(argc, argv, i, options.compressionBenchSize);
+		}
+		else if (arg == "--no-compression") {
+			options.textureCompression = false;
+		}
+		else if (arg == "--texture") {
+			ok = readString(argc, argv, i, options.texturePath);
+		}
+		else if (arg == "--trace") {
+			ok = readString(argc, argv, i, options.tracePath);
+		}
+		else if (arg == "--headless") {
+			options.headless = true;
+		}
+		else if (arg == "--frames") {
+			ok = readUint(argc, argv, i, options.frames);
+		}
+		else if (arg == "--size") {
+			ok = readSize(argc, argv, i, options.width, options.height);
+		}
+		else if (arg == "--output") {
+			ok = readString(argc, argv, i, options.outputDir);
+		}
+		else if (arg == "--software") {
+			options.softwareAdapter = true;
+		}
+		else if (arg == "--readback-slots") {
+			ok = readUint(argc, argv, i, options.readbackSlots);
+			ok = ok && options.readbackSlots > 0;
+		}
+		else if (arg == "--drop-frames") {
+			options.dropFrames = true;
+		}
+		else if (arg == "--depth") {
+			std::string mode;
+			ok = readString(argc, argv, i, mode);
+			if (mode == "off") options.depth = DepthMode::Off;
+			else if (mode == "on") options.depth = DepthMode::On;
+			else if (mode == "prepass") options.depth = DepthMode::Prepass;
+			else ok = false;
+		}
+		else if (arg == "--on-demand") {
+			options.onDemand = true;
+		}
+		else if (arg == "--paused") {
+			options.paused = true;
+		}
+		else if (arg == "--dynamic-res") {
+			options.dynamicResolution = true;
+		}
+		else if (arg == "--frame-budget") {
+			ok = readFloat(argc, argv, i, options.frameBudgetMs);
+		}
+		else if (arg == "--min-scale") {
+			ok = readFloat(argc, argv, i, options.minScale);
+		}
+		else if (arg == "--max-scale") {
+			ok = readFloat(argc, argv, i, options.maxScale) && options.maxScale <= 1.0f;
+		}
+		else if (arg == "--overdraw") {
+			options.overdraw = true;
+		}
+		else if (arg == "--capture") {
+			std::string format;
+			ok = readString(argc, argv, i, format);
+			if (format == "rgba") options.capture = CaptureFormat::Rgba;
+			else if (format == "nv12") options.capture = CaptureFormat::Nv12;
+			else if (format == "i420") options.capture = CaptureFormat::I420;
+			else ok = false;
+		}
+		else if (arg == "--capture-out") {
+			ok = readString(argc, argv, i, options.captureOutput);
+		}
+		else if (arg == "--shm") {
+			ok = readString(argc, argv, i, options.sharedMemory);
+		}
+		else if (arg == "--shm-slots") {
+			ok = readUint(argc, argv, i, options.sharedSlots) && options.sharedSlots > 0;
+		}
+		else if (arg == "--bench") {
+			options.bench = true;
+		}
+		else if (arg == "--warmup") {
+			ok = readUint(argc, argv, i, options.warmup);
+		}
+		else if (arg == "--bench-out") {
+			ok = readString(argc, argv, i, options.benchOutput);
+		}
+		else {
+			std::cerr << "Unknown argument '" << arg << "'" << std::endl;
+			ok = false;
+		}
+		if (!ok) {
+			printUsage(argv[0]);
+			return false;
+		}
+	}
+	if (options.minScale > options.maxScale) {
+		std::cerr << "--min-scale must not be above --max-scale" << std::endl;
+		printUsage(argv[0]);
+		return false;
+	}
+	return true;
+}
+
+const char* Options::measurementFlag() const {
+	// a new measurement mode goes here, which is all isMeasurementRun and its callers look at
+	if (encodeScalingDraws > 0) return "--encode-scaling";
+	if (sortBenchPackets > 0) return "--sort-bench";
+	if (allocBenchCount > 0) return "--alloc-bench";
+	if (stagingBenchUploads > 0) return "--staging-bench";
+	if (textureBenchCount > 0) return "--texture-bench";
+	if (mipBenchSize > 0) return "--mip-bench";
+	if (compressionBenchSize > 0) return "--compress-bench";
+	return nullptr;
+}
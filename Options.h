@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// How the scene uses depth
+enum class DepthMode {
+	Off, // no depth buffer, draws overwrite each other in list order
+	On, // depth test and write in the color pass, opaque draws sorted front to back
+	Prepass, // opaque depth laid down first by a position only pass, color pass tests Equal
+};
+
+// What headless mode reads back from each frame
+enum class CaptureFormat {
+	None, // not requested: PNG frames in plain headless runs, nothing when benchmarking
+	Rgba, // RGBA8 frames written as PNG
+	Nv12, // converted on the GPU, luma plane + interleaved chroma
+	I420, // converted on the GPU, luma + U + V planes
+};
+
+/**
+ * Command line switches of the App. Everything has a default so that running without arguments
+ * behaves like before.
+ */
+struct Options {
+	// threads used to record draws into render bundles, 0 = one per hardware thread
+	uint32_t encodeThreads = 0;
+	// when non zero, time the encoding of that many draws with 1..N threads, print and exit
+	uint32_t encodeScalingDraws = 0;
+	// when non zero, time sorting that many random draw packets, print and exit
+	uint32_t sortBenchPackets = 0;
+	// when non zero, time that many buffer allocations with createBuffer and with the sub-allocator
+	uint32_t allocBenchCount = 0;
+	// when non zero, time that many uploads per size with writeBuffer and with the staging belt
+	uint32_t stagingBenchUploads = 0;
+	// when non zero, time loading that many generated image files with 1..N decode threads
+	uint32_t textureBenchCount = 0;
+	// when non zero, time mip generation of a SIZE x SIZE texture and an odd sized one, compute
+	// against one render pass per level
+	uint32_t mipBenchSize = 0;
+	// when non zero, encode a SIZE x SIZE image to BC1 / BC3 KTX2 files, load them and print the VRAM saved
+	uint32_t compressionBenchSize = 0;
+	// ask for the block compression features the adapter has, KTX2 textures are decompressed otherwise
+	bool textureCompression = true;
+	DepthMode depth = DepthMode::On;
+	// shade every fragment with a constant additive color, to see (and measure headless) overdraw
+	bool overdraw = false;
+	// windowed: only render when something changed, sleeping in glfwWaitEvents otherwise
+	bool onDemand = false;
+	// start with the animation stopped (P toggles it), so that on demand mode has nothing to do
+	bool paused = false;
+	// render the scene at a resolution scale picked from frame times, then upscale to the target
+	bool dynamicResolution = false;
+	// scale limits of the dynamic resolution, 0 < minScale <= maxScale <= 1
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	// frame time dynamic resolution aims for, below the refresh interval to leave some margin
+	float frameBudgetMs = 14.0f;
+	// image (PPM / PGM or TGA) the scene is textured with, a plain white texture when empty
+	std::string texturePath;
+	// GPU memory budget in MiB, pools and caches evict when the App goes over it. 0 = none
+	uint32_t memoryBudgetMiB = 0;
+	// where the startup phase timings go as JSON, not written when empty (always printed)
+	std::string startupOutput;
+	// when set, record CPU trace zones and write them there as Chrome trace JSON on exit (and on F9)
+	std::string tracePath;
+
+	// render into an offscreen texture without any window, and write frames as PNG
+	bool headless = false;
+	// frames to render in headless mode, or to measure in bench mode. 0 = mode default (1 or 300)
+	uint32_t frames = 0;
+	// size of the offscreen target in headless mode
+	uint32_t width = 640;
+	uint32_t height = 480;
+	// where headless frames go, as frame_XXXXX.png
+	std::string outputDir = ".";
+	// ask for the fallback (software) adapter, e.g. on CI machines without a GPU
+	bool softwareAdapter = false;
+	// staging buffers in the readback ring
+	uint32_t readbackSlots = 3;
+	// never wait for readback: drop frames when the consumer falls behind (streaming) instead of
+	// throttling rendering (batch, the default)
+	bool dropFrames = false;
+	// what to read back, see CaptureFormat
+	CaptureFormat capture = CaptureFormat::None;
+	// YUV output: a path (".y4m" for an I420 stream with header, raw planes otherwise), a named
+	// pipe, or "-" for stdout. Defaults to capture.y4m / capture.nv12 in outputDir
+	std::string captureOutput;
+	// publish read back frames into this POSIX shared memory object (e.g. /webgpu-frames) instead
+	// of files, for a consumer process such as tools/shm_consumer
+	std::string sharedMemory;
+	// frames the shared memory ring holds
+	uint32_t sharedSlots = 4;
+
+	// run `warmup` frames, then measure `frames` frames and report timings as JSON
+	bool bench = false;
+	uint32_t warmup = 60;
+	// where the benchmark JSON goes, stdout when empty
+	std::string benchOutput;
+
+	// one of the measurement modes above, which run once the device is ready and exit
+	bool isMeasurementRun() const { return measurementFlag() != nullptr; }
+	// the command line flag of the measurement mode asked for ("--sort-bench"...), nullptr if none
+	const char* measurementFlag() const;
+
+	// `frames` with the mode default applied
+	uint32_t frameCount() const {
+		if (frames > 0) return frames;
+		return bench ? 300 : 1;
+	}
+
+	/**
+	 * Fill `options` from the command line. Prints usage and returns false on unknown or
+	 * malformed arguments.
+	 */
+	static bool parse(int argc, char* argv[], Options& options);
+};
@@ -0,0 +1,118 @@
+// ParallelEncoder.cpp
+#include "ParallelEncoder.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+using namespace wgpu;
+
+namespace {
+// below this many draws per chunk, splitting is not worth the synchronization
+constexpr size_t kMinDrawsPerChunk = 256;
+} // namespace
+
+ParallelEncoder::ParallelEncoder(ThreadPool& pool)
+	: pool(pool)
+{}
+
+void ParallelEncoder::setAttachmentFormats(TextureFormat color, TextureFormat depth) {
+	colorFormat = color;
+	depthFormat = depth;
+}
+
+std::vector<RenderBundle> ParallelEncoder::encode(
+	Device device,
+	const std::vector<DrawCommand>& draws,
+	size_t maxChunks
+) {
+	stats = EncodeStats();
+	if (draws.empty()) {
+		return {};
+	}
+	if (maxChunks == 0) {
+		maxChunks = pool.threadCount();
+	}
+	size_t chunkCount = std::min(maxChunks, (draws.size() + kMinDrawsPerChunk - 1) / kMinDrawsPerChunk);
+	chunkCount = std::max<size_t>(chunkCount, 1);
+
+	// chunk i always covers the same range for a given list, so the output is deterministic
+	// regardless of which thread picks it up
+	size_t chunkSize = (draws.size() + chunkCount - 1) / chunkCount;
+	std::vector<RenderBundle> bundles(chunkCount, nullptr);
+	std::vector<EncodeStats> chunkStats(chunkCount);
+	pool.parallelFor(chunkCount, [&](size_t chunk) {
+		size_t begin = chunk * chunkSize;
+		size_t end = std::min(begin + chunkSize, draws.size());
+		bundles[chunk] = encodeChunk(device, draws, begin, end, chunkStats[chunk]);
+	});
+	for (const EncodeStats& chunk : chunkStats) {
+		stats.draws += chunk.draws;
+		stats.pipelines += chunk.pipelines;
+		stats.bindGroups += chunk.bindGroups;
+		stats.vertexBuffers += chunk.vertexBuffers;
+		stats.indexBuffers += chunk.indexBuffers;
+	}
+	return bundles;
+}
+
+RenderBundle ParallelEncoder::encodeChunk(
+	Device device,
+	const std::vector<DrawCommand>& draws,
+	size_t begin,
+	size_t end,
+	EncodeStats& chunkStats
+) const {
+	TRACE_SCOPE("encode chunk");
+	RenderBundleEncoderDescriptor bundleEncoderDesc = {};
+	bundleEncoderDesc.label = "Draw chunk";
+	// depth only passes (prepass, shadows) have no color attachment
+	bundleEncoderDesc.colorFormatCount = colorFormat == TextureFormat::Undefined ? 0 : 1;
+	bundleEncoderDesc.colorFormats = reinterpret_cast<const WGPUTextureFormat*>(&colorFormat);
+	bundleEncoderDesc.depthStencilFormat = depthFormat;
+	bundleEncoderDesc.sampleCount = 1;
+	RenderBundleEncoder bundleEncoder = device.createRenderBundleEncoder(bundleEncoderDesc);
+
+	// a bundle starts with no state bound, so track what we set to skip redundant calls
+	RenderPipeline currentPipeline = nullptr;
+	BindGroup currentBindGroup = nullptr;
+	uint32_t currentDynamicOffset = 0;
+	Buffer currentVertexBuffer = nullptr;
+	uint64_t currentVertexOffset = 0;
+	Buffer currentIndexBuffer = nullptr;
+	uint64_t currentIndexOffset = 0;
+
+	for (size_t i = begin; i < end; ++i) {
+		const DrawCommand& draw = draws[i];
+		if (draw.pipeline != currentPipeline) {
+			bundleEncoder.setPipeline(draw.pipeline);
+			currentPipeline = draw.pipeline;
+			++chunkStats.pipelines;
+		}
+		if (draw.bindGroup != currentBindGroup || draw.dynamicOffset != currentDynamicOffset) {
+			bundleEncoder.setBindGroup(0, draw.bindGroup, 1, &draw.dynamicOffset);
+			currentBindGroup = draw.bindGroup;
+			currentDynamicOffset = draw.dynamicOffset;
+			++chunkStats.bindGroups;
+		}
+		if (draw.vertexBuffer != currentVertexBuffer || draw.vertexOffset != currentVertexOffset) {
+			bundleEncoder.setVertexBuffer(0, draw.vertexBuffer, draw.vertexOffset, draw.vertexSize);
+			currentVertexBuffer = draw.vertexBuffer;
+			currentVertexOffset = draw.vertexOffset;
+			++chunkStats.vertexBuffers;
+		}
+		if (draw.indexBuffer != currentIndexBuffer || draw.indexOffset != currentIndexOffset) {
+			bundleEncoder.setIndexBuffer(draw.indexBuffer, draw.indexFormat, draw.indexOffset, draw.indexSize);
+			currentIndexBuffer = draw.indexBuffer;
+			currentIndexOffset = draw.indexOffset;
+			++chunkStats.indexBuffers;
+		}
+		bundleEncoder.drawIndexed(draw.indexCount, 1, 0, 0, 0);
+		++chunkStats.draws;
+	}
+
+	RenderBundleDescriptor bundleDesc = {};
+	bundleDesc.label = "Draw chunk bundle";
+	RenderBundle bundle = bundleEncoder.finish(bundleDesc);
+	bundleEncoder.release();
+	return bundle;
+}
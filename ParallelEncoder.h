@@ -0,0 +1,78 @@
+#pragma once
+#include "ThreadPool.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <vector>
+
+/**
+ * Everything needed to issue one indexed draw. Handles are borrowed from the caller, who keeps
+ * them alive until the frame is submitted.
+ */
+struct DrawCommand {
+	wgpu::RenderPipeline pipeline = nullptr;
+	wgpu::BindGroup bindGroup = nullptr;
+	uint32_t dynamicOffset = 0;
+	wgpu::Buffer vertexBuffer = nullptr;
+	uint64_t vertexOffset = 0;
+	uint64_t vertexSize = 0;
+	wgpu::Buffer indexBuffer = nullptr;
+	uint64_t indexOffset = 0;
+	uint64_t indexSize = 0;
+	wgpu::IndexFormat indexFormat = wgpu::IndexFormat::Uint16;
+	uint32_t indexCount = 0;
+};
+
+// State setting calls issued by a recording, the redundant ones are skipped and not counted
+struct EncodeStats {
+	uint32_t draws = 0;
+	uint32_t pipelines = 0;
+	uint32_t bindGroups = 0;
+	uint32_t vertexBuffers = 0;
+	uint32_t indexBuffers = 0;
+
+	uint32_t stateChanges() const { return pipelines + bindGroups + vertexBuffers + indexBuffers; }
+};
+
+/**
+ * Records a draw list into render bundles on a thread pool. The list is cut into contiguous
+ * chunks, one bundle per chunk, and bundles come back in list order: executing them one after
+ * the other in a single render pass gives exactly the same result as recording sequentially.
+ */
+class ParallelEncoder {
+public:
+	explicit ParallelEncoder(ThreadPool& pool);
+
+	// formats of the render pass the bundles will be executed in, Undefined for "no such attachment"
+	void setAttachmentFormats(wgpu::TextureFormat colorFormat, wgpu::TextureFormat depthFormat = wgpu::TextureFormat::Undefined);
+
+	/**
+	 * Record `draws` into at most `maxChunks` bundles (0 = one per pool thread). Short lists stay
+	 * on a single thread since waking workers would cost more than it saves. The caller executes
+	 * the bundles with RenderPassEncoder::executeBundles and releases them.
+	 */
+	std::vector<wgpu::RenderBundle> encode(
+		wgpu::Device device,
+		const std::vector<DrawCommand>& draws,
+		size_t maxChunks = 0
+	);
+
+	// Counts of the last encode(). Every bundle starts with nothing bound, so each chunk sets its
+	// state again: more chunks means a few more state changes.
+	const EncodeStats& lastStats() const { return stats; }
+
+private:
+	// record draws [begin, end) into a single bundle
+	wgpu::RenderBundle encodeChunk(
+		wgpu::Device device,
+		const std::vector<DrawCommand>& draws,
+		size_t begin,
+		size_t end,
+		EncodeStats& chunkStats
+	) const;
+
+	ThreadPool& pool;
+	EncodeStats stats;
+	wgpu::TextureFormat colorFormat = wgpu::TextureFormat::Undefined;
+	wgpu::TextureFormat depthFormat = wgpu::TextureFormat::Undefined;
+};
@@ -0,0 +1,224 @@
+// ReadbackRing.cpp
+#include "ReadbackRing.h"
+#include "GpuMemory.h"
+#include "Trace.h"
+
+using namespace wgpu;
+
+ReadbackRing::~ReadbackRing() {
+	terminate();
+}
+
+void ReadbackRing::initialize(Device gpuDevice, uint32_t slotCount, uint64_t size, Consumer frameConsumer) {
+	device = gpuDevice;
+	slotSize = size;
+	consumer = std::move(frameConsumer);
+
+	BufferDescriptor bufferDesc = {};
+	bufferDesc.label = "Readback slot";
+	bufferDesc.size = slotSize;
+	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::MapRead;
+	bufferDesc.mappedAtCreation = false;
+	for (uint32_t i = 0; i < slotCount; ++i) {
+		slots.push_back(std::make_unique<Slot>());
+		slots.back()->buffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Readback);
+	}
+
+	stopping = false;
+#ifndef __EMSCRIPTEN__
+	consumerThread = std::thread(&ReadbackRing::consumerLoop, this);
+#endif
+}
+
+void ReadbackRing::terminate() {
+#ifndef __EMSCRIPTEN__
+	if (consumerThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		consumerThread.join();
+	}
+#endif
+	for (std::unique_ptr<Slot>& slot : slots) {
+		GpuMemory::untrack(slot->buffer);
+		slot->buffer.release();
+		// after the release, a pending map may still report back through it
+		slot->mapCallback.reset();
+	}
+	slots.clear();
+	inFlight.clear();
+	toConsume.clear();
+}
+
+bool ReadbackRing::hasFreeSlot() const {
+	return !slots.empty() && slots[nextSlot]->state == SlotState::Free;
+}
+
+ReadbackRing::Slot* ReadbackRing::acquireSlot() {
+	// slots are used round robin, so the next one is also the oldest
+	if (!hasFreeSlot()) {
+		++dropped;
+		return nullptr;
+	}
+	Slot* slot = slots[nextSlot].get();
+	nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+	slot->state = SlotState::Copying;
+	slot->consumed = false;
+	inFlight.push_back(slot);
+	return slot;
+}
+
+bool ReadbackRing::enqueueTexture(CommandEncoder encoder, Texture texture, uint32_t width, uint32_t height, uint64_t frameIndex) {
+	// texture to buffer copies need rows aligned to 256 bytes
+	uint32_t bytesPerRow = (4 * width + 255) & ~255u;
+	uint64_t size = static_cast<uint64_t>(bytesPerRow) * height;
+	if (size > slotSize) {
+		++dropped;
+		return false;
+	}
+	Slot* slot = acquireSlot();
+	if (slot == nullptr) {
+		return false;
+	}
+
+	ImageCopyTexture source = {};
+	source.texture = texture;
+	source.mipLevel = 0;
+	source.origin = { 0, 0, 0 };
+	source.aspect = TextureAspect::All;
+	ImageCopyBuffer destination = {};
+	destination.buffer = slot->buffer;
+	destination.layout.offset = 0;
+	destination.layout.bytesPerRow = bytesPerRow;
+	destination.layout.rowsPerImage = height;
+	Extent3D copySize;
+	copySize.width = width;
+	copySize.height = height;
+	copySize.depthOrArrayLayers = 1;
+	encoder.copyTextureToBuffer(source, destination, copySize);
+
+	slot->frame = ReadbackFrame{};
+	slot->frame.frameIndex = frameIndex;
+	slot->frame.width = width;
+	slot->frame.height = height;
+	slot->frame.bytesPerRow = bytesPerRow;
+	slot->frame.size = size;
+	return true;
+}
+
+bool ReadbackRing::enqueueBuffer(CommandEncoder encoder, Buffer buffer, uint64_t offset, uint64_t size, uint32_t width, uint32_t height, uint64_t frameIndex) {
+	if (size > slotSize) {
+		++dropped;
+		return false;
+	}
+	Slot* slot = acquireSlot();
+	if (slot == nullptr) {
+		return false;
+	}
+	encoder.copyBufferToBuffer(buffer, offset, slot->buffer, 0, size);
+
+	slot->frame = ReadbackFrame{};
+	slot->frame.frameIndex = frameIndex;
+	slot->frame.width = width;
+	slot->frame.height = height;
+	slot->frame.bytesPerRow = 0; // layout is up to whoever produced the buffer
+	slot->frame.size = size;
+	return true;
+}
+
+void ReadbackRing::afterSubmit() {
+	for (Slot* slot : inFlight) {
+		if (slot->state != SlotState::Copying) {
+			continue;
+		}
+		slot->state = SlotState::Mapping;
+		slot->mapCallback = slot->buffer.mapAsync(MapMode::Read, 0, slot->frame.size, [slot](BufferMapAsyncStatus status) {
+			// a failed map is handed over like any other slot and dropped in update(), to keep order simple
+			slot->state = SlotState::Mapped;
+			if (status != BufferMapAsyncStatus::Success) {
+				slot->frame.data = nullptr;
+				return;
+			}
+			slot->frame.data = reinterpret_cast<const uint8_t*>(slot->buffer.getConstMappedRange(0, slot->frame.size));
+		});
+	}
+}
+
+void ReadbackRing::update() {
+	TRACE_SCOPE("readback update");
+	// hand over mapped frames in order: stop at the first one that is still mapping
+	for (Slot* slot : inFlight) {
+		if (slot->state == SlotState::Mapping || slot->state == SlotState::Copying) {
+			break;
+		}
+		if (slot->state != SlotState::Mapped) {
+			continue;
+		}
+		if (slot->frame.data == nullptr) {
+			// map failed (device lost, buffer destroyed...), nothing to deliver
+			++dropped;
+			slot->state = SlotState::Consumed;
+			slot->consumed = true;
+			continue;
+		}
+		slot->state = SlotState::Consuming;
+#ifndef __EMSCRIPTEN__
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			toConsume.push_back(slot);
+		}
+		wake.notify_one();
+#else
+		consumer(slot->frame);
+		slot->consumed = true;
+#endif
+	}
+
+	// recycle what the consumer is done with, oldest first so the round robin stays valid
+	while (!inFlight.empty()) {
+		Slot* slot = inFlight.front();
+		if (slot->state == SlotState::Consuming && slot->consumed) {
+			slot->state = SlotState::Consumed;
+		}
+		if (slot->state != SlotState::Consumed) {
+			break;
+		}
+		if (slot->frame.data != nullptr) {
+			slot->buffer.unmap();
+			++delivered;
+		}
+		slot->frame.data = nullptr;
+		slot->state = SlotState::Free;
+		inFlight.pop_front();
+	}
+}
+
+void ReadbackRing::flush(const std::function<void()>& poll) {
+	while (!inFlight.empty()) {
+		poll();
+		update();
+	}
+}
+
+void ReadbackRing::consumerLoop() {
+	Trace::setThreadName("readback consumer");
+	while (true) {
+		Slot* slot = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !toConsume.empty(); });
+			if (toConsume.empty()) {
+				return;
+			}
+			slot = toConsume.front();
+			toConsume.pop_front();
+		}
+		{
+			TRACE_SCOPE("consume frame");
+			consumer(slot->frame);
+		}
+		slot->consumed.store(true, std::memory_order_release);
+	}
+}
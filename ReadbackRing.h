@@ -0,0 +1,108 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifndef __EMSCRIPTEN__
+#  include <thread>
+#endif
+
+/**
+ * A frame read back from the GPU. `data` points into a mapped staging buffer and is only valid
+ * during the consumer call.
+ */
+struct ReadbackFrame {
+	uint64_t frameIndex = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t bytesPerRow = 0; // rows of texture copies are padded to 256 bytes
+	const uint8_t* data = nullptr;
+	uint64_t size = 0;
+};
+
+/**
+ * Ring of K staging buffers to read frames back without ever stalling the render loop.
+ *
+ * Each frame the render target is copied into the next free slot, the slot is mapped
+ * asynchronously once submitted, and mapped slots are handed to the consumer (in frame order, on
+ * its own thread) a few frames later. A slot comes back to the ring when the consumer returns.
+ * When every slot is still busy the frame is dropped and counted, rather than waiting.
+ */
+class ReadbackRing {
+public:
+	using Consumer = std::function<void(const ReadbackFrame&)>;
+
+	~ReadbackRing();
+
+	// `slotSize` bytes per staging buffer, enough for the largest copy enqueued
+	void initialize(wgpu::Device device, uint32_t slotCount, uint64_t slotSize, Consumer consumer);
+	// Waits for nothing: call flush() first to get the frames still in flight
+	void terminate();
+
+	// Whether enqueue would find a slot right now
+	bool hasFreeSlot() const;
+
+	/**
+	 * Record a copy of `texture` (mip 0, RGBA8-like 4 bytes per texel) into the next free slot.
+	 * Returns false and counts a dropped frame if the ring is full.
+	 */
+	bool enqueueTexture(wgpu::CommandEncoder encoder, wgpu::Texture texture, uint32_t width, uint32_t height, uint64_t frameIndex);
+	// Same for `size` bytes of a buffer, e.g. the output of a conversion pass
+	bool enqueueBuffer(wgpu::CommandEncoder encoder, wgpu::Buffer buffer, uint64_t offset, uint64_t size, uint32_t width, uint32_t height, uint64_t frameIndex);
+
+	// Request the mapping of slots copied in the frame that was just submitted
+	void afterSubmit();
+	// Hand newly mapped slots to the consumer and recycle the ones it is done with. Call every frame.
+	void update();
+	// Block until everything enqueued has been consumed. `poll` must make device callbacks progress.
+	void flush(const std::function<void()>& poll);
+
+	uint64_t droppedFrames() const { return dropped; }
+	uint64_t deliveredFrames() const { return delivered; }
+
+private:
+	enum class SlotState {
+		Free,
+		Copying, // copy recorded, waiting for submit
+		Mapping, // mapAsync requested
+		Mapped, // ready, waiting to be handed over in order
+		Consuming, // the consumer thread has it
+		Consumed, // consumer returned, waiting for unmap
+	};
+
+	struct Slot {
+		wgpu::Buffer buffer = nullptr;
+		SlotState state = SlotState::Free;
+		std::atomic<bool> consumed{ false };
+		ReadbackFrame frame;
+		std::unique_ptr<wgpu::BufferMapCallback> mapCallback;
+	};
+
+	Slot* acquireSlot();
+	void consumerLoop();
+
+	wgpu::Device device = nullptr;
+	uint64_t slotSize = 0;
+	std::vector<std::unique_ptr<Slot>> slots;
+	uint32_t nextSlot = 0;
+	// slots in the order their frames were enqueued, delivery follows this order
+	std::deque<Slot*> inFlight;
+	Consumer consumer;
+	uint64_t dropped = 0;
+	uint64_t delivered = 0;
+
+	// hand-off to the consumer thread
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Slot*> toConsume;
+	bool stopping = false;
+#ifndef __EMSCRIPTEN__
+	std::thread consumerThread;
+#endif
+};
@@ -1,12 +1,267 @@
 // ResourceManager.cpp
 #include "ResourceManager.h"
+#include "BlockCompression.h"
 
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <string>
 
 using namespace wgpu;
 
+namespace {
+
+// rows of texture copies are 256 byte aligned
+uint32_t paddedRowSize(uint32_t width) {
+    return (4 * width + 255) & ~255u;
+}
+
+void allocateImage(Image& image, uint32_t width, uint32_t height) {
+    image.width = width;
+    image.height = height;
+    image.bytesPerRow = paddedRowSize(width);
+    // the padding is never sampled, no need to clear it
+    image.pixels.resize(static_cast<size_t>(image.bytesPerRow) * height);
+}
+
+// next header field of a PPM / PGM file, skipping whitespace and comments
+bool readPnmNumber(const uint8_t* data, size_t size, size_t& position, uint32_t& value) {
+    while (position < size) {
+        if (data[position] == '#') {
+            while (position < size && data[position] != '\n') ++position;
+        }
+        else if (std::isspace(data[position])) {
+            ++position;
+        }
+        else {
+            break;
+        }
+    }
+    if (position >= size || !std::isdigit(data[position])) return false;
+    value = 0;
+    while (position < size && std::isdigit(data[position])) {
+        value = value * 10 + (data[position] - '0');
+        if (value > (1u << 16)) return false;
+        ++position;
+    }
+    return true;
+}
+
+bool decodePnm(const uint8_t* data, size_t size, Image& image) {
+    bool color = data[1] == '6';
+    size_t position = 2;
+    uint32_t width, height, maxValue;
+    if (!readPnmNumber(data, size, position, width) || !readPnmNumber(data, size, position, height)
+        || !readPnmNumber(data, size, position, maxValue)) {
+        return false;
+    }
+    // one whitespace byte, then the samples. 16-bit files are not supported
+    ++position;
+    uint32_t channels = color ? 3 : 1;
+    if (width == 0 || height == 0 || maxValue == 0 || maxValue > 255
+        || size < position + static_cast<size_t>(width) * height * channels) {
+        return false;
+    }
+
+    allocateImage(image, width, height);
+    const uint8_t* source = data + position;
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* row = image.pixels.data() + static_cast<size_t>(y) * image.bytesPerRow;
+        for (uint32_t x = 0; x < width; ++x, source += channels) {
+            row[4 * x + 0] = source[0];
+            row[4 * x + 1] = source[color ? 1 : 0];
+            row[4 * x + 2] = source[color ? 2 : 0];
+            row[4 * x + 3] = 255;
+        }
+    }
+    return true;
+}
+
+bool decodeTga(const uint8_t* data, size_t size, Image& image) {
+    constexpr size_t kHeaderSize = 18;
+    if (size < kHeaderSize) return false;
+    uint8_t idLength = data[0];
+    uint8_t colorMapType = data[1];
+    uint8_t imageType = data[2];
+    uint32_t width = data[12] | (data[13] << 8);
+    uint32_t height = data[14] | (data[15] << 8);
+    uint8_t bitsPerPixel = data[16];
+    // bit 5 of the descriptor: first row is the top one, bottom one otherwise
+    bool topDown = (data[17] & 0x20) != 0;
+
+    // 2: true color, 3: grayscale, +8: run length encoded. No color maps
+    bool rle = imageType == 10 || imageType == 11;
+    bool gray = imageType == 3 || imageType == 11;
+    if (colorMapType != 0 || (imageType != 2 && imageType != 3 && !rle) || width == 0 || height == 0) return false;
+    if (gray ? bitsPerPixel != 8 : (bitsPerPixel != 24 && bitsPerPixel != 32)) return false;
+    uint32_t pixelSize = bitsPerPixel / 8;
+
+    allocateImage(image, width, height);
+    const uint8_t* source = data + kHeaderSize + idLength;
+    const uint8_t* end = data + size;
+    // pixels are stored BGR(A)
+    auto storePixel = [&](const uint8_t* pixel, uint8_t* target) {
+        target[0] = pixel[gray ? 0 : 2];
+        target[1] = pixel[gray ? 0 : 1];
+        target[2] = pixel[0];
+        target[3] = pixelSize == 4 ? pixel[3] : 255;
+    };
+
+    uint32_t runLeft = 0; // pixels left in the current RLE packet
+    bool repeat = false;
+    for (uint32_t y = 0; y < height; ++y) {
+        uint32_t targetRow = topDown ? y : height - 1 - y;
+        uint8_t* row = image.pixels.data() + static_cast<size_t>(targetRow) * image.bytesPerRow;
+        for (uint32_t x = 0; x < width; ++x) {
+            if (rle && runLeft == 0) {
+                // packets may span rows
+                if (source >= end) return false;
+                repeat = (*source & 0x80) != 0;
+                runLeft = (*source & 0x7f) + 1;
+                ++source;
+            }
+            if (source + pixelSize > end) return false;
+            storePixel(source, row + 4 * x);
+            if (rle) {
+                --runLeft;
+                // a repeated pixel is stored once, at the end of its run we move past it
+                if (!repeat || runLeft == 0) source += pixelSize;
+            }
+            else {
+                source += pixelSize;
+            }
+        }
+    }
+    return true;
+}
+
+// KTX2 files start with "«KTX 20»\r\n\x1A\n"
+const uint8_t kKtx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+// identifier, 9 header fields, then the index: 4 x 32 bits and 2 x 64 bits
+constexpr size_t kKtx2LevelIndexOffset = 80;
+
+uint32_t readU32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+uint64_t readU64(const uint8_t* data) {
+    return readU32(data) | (static_cast<uint64_t>(readU32(data + 4)) << 32);
+}
+
+void appendU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) out.push_back((value >> (8 * i)) & 0xff);
+}
+
+void appendU64(std::vector<uint8_t>& out, uint64_t value) {
+    appendU32(out, value & 0xffffffffu);
+    appendU32(out, value >> 32);
+}
+
+// the VkFormat values KTX2 uses, for the formats WebGPU has
+TextureFormat formatFromVulkan(uint32_t vkFormat) {
+    switch (vkFormat) {
+    case 37: return TextureFormat::RGBA8Unorm;
+    case 43: return TextureFormat::RGBA8UnormSrgb;
+    // no BC1 RGB (131, 132): WebGPU only has BC1 RGBA, which decodes index 3 of 3 color blocks to
+    // transparent black where BC1 RGB gives opaque black
+    case 133: return TextureFormat::BC1RGBAUnorm;
+    case 134: return TextureFormat::BC1RGBAUnormSrgb;
+    case 137: return TextureFormat::BC3RGBAUnorm;
+    case 138: return TextureFormat::BC3RGBAUnormSrgb;
+    case 145: return TextureFormat::BC7RGBAUnorm;
+    case 146: return TextureFormat::BC7RGBAUnormSrgb;
+    case 147: return TextureFormat::ETC2RGB8Unorm;
+    case 148: return TextureFormat::ETC2RGB8UnormSrgb;
+    case 149: return TextureFormat::ETC2RGB8A1Unorm;
+    case 150: return TextureFormat::ETC2RGB8A1UnormSrgb;
+    case 151: return TextureFormat::ETC2RGBA8Unorm;
+    case 152: return TextureFormat::ETC2RGBA8UnormSrgb;
+    case 157: return TextureFormat::ASTC4x4Unorm;
+    case 158: return TextureFormat::ASTC4x4UnormSrgb;
+    default: return TextureFormat::Undefined;
+    }
+}
+
+uint32_t vulkanFromFormat(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::RGBA8Unorm: return 37;
+    case TextureFormat::RGBA8UnormSrgb: return 43;
+    case TextureFormat::BC1RGBAUnorm: return 133;
+    case TextureFormat::BC1RGBAUnormSrgb: return 134;
+    case TextureFormat::BC3RGBAUnorm: return 137;
+    case TextureFormat::BC3RGBAUnormSrgb: return 138;
+    default: return 0;
+    }
+}
+
+// Basic data format descriptor (Khronos Data Format spec, section 5) of the formats writeKtx2 knows
+std::vector<uint8_t> dataFormatDescriptor(TextureFormat format) {
+    struct Sample {
+        uint16_t bitOffset;
+        uint8_t bitLength;
+        uint8_t channel; // with the qualifier bits
+    };
+    std::vector<Sample> samples;
+    uint8_t colorModel = 0;
+    uint8_t blockSize = 0; // texels - 1 per dimension
+    uint8_t bytesPlane0 = 0;
+    bool srgb = isSrgbFormat(format);
+    if (format == TextureFormat::BC1RGBAUnorm || format == TextureFormat::BC1RGBAUnormSrgb) {
+        colorModel = 128; // BC1A
+        blockSize = 3;
+        bytesPlane0 = 8;
+        samples.push_back({ 0, 64, 0 }); // color
+    }
+    else if (format == TextureFormat::BC3RGBAUnorm || format == TextureFormat::BC3RGBAUnormSrgb) {
+        colorModel = 130; // BC3
+        blockSize = 3;
+        bytesPlane0 = 16;
+        samples.push_back({ 0, 64, static_cast<uint8_t>(srgb ? 0x1f : 15) }); // alpha, linear even in sRGB formats
+        samples.push_back({ 64, 64, 0 }); // color
+    }
+    else {
+        colorModel = 1; // RGBSDA
+        bytesPlane0 = 4;
+        samples.push_back({ 0, 8, 0 });
+        samples.push_back({ 8, 8, 1 });
+        samples.push_back({ 16, 8, 2 });
+        samples.push_back({ 24, 8, static_cast<uint8_t>(srgb ? 0x1f : 15) }); // alpha, linear even in sRGB formats
+    }
+
+    uint32_t blockBytes = 24 + 16 * static_cast<uint32_t>(samples.size());
+    std::vector<uint8_t> dfd;
+    appendU32(dfd, 4 + blockBytes); // total size
+    appendU32(dfd, 0); // Khronos vendor, basic descriptor type
+    appendU32(dfd, 2 | (blockBytes << 16)); // version 1.3
+    dfd.push_back(colorModel);
+    dfd.push_back(1); // BT.709 primaries
+    dfd.push_back(srgb ? 2 : 1); // transfer function
+    dfd.push_back(0); // straight alpha
+    dfd.push_back(blockSize);
+    dfd.push_back(blockSize);
+    dfd.push_back(0);
+    dfd.push_back(0);
+    dfd.push_back(bytesPlane0);
+    for (int i = 0; i < 7; ++i) dfd.push_back(0);
+    for (const Sample& sample : samples) {
+        dfd.push_back(sample.bitOffset & 0xff);
+        dfd.push_back(sample.bitOffset >> 8);
+        dfd.push_back(static_cast<uint8_t>(sample.bitLength - 1));
+        dfd.push_back(sample.channel);
+        appendU32(dfd, 0); // sample position
+        appendU32(dfd, 0); // lower
+        appendU32(dfd, colorModel == 1 ? 255 : 0xffffffffu); // upper
+    }
+    return dfd;
+}
+
+} // namespace
+
 bool ResourceManager::loadGeometry(
     const std::filesystem::path& path,
     std::vector<float>& pointData,
@@ -67,20 +322,37 @@ bool ResourceManager::loadGeometry(
     return true;
 }
 
-ShaderModule ResourceManager::loadShaderModule(
+bool ResourceManager::loadShaderSource(
     const std::filesystem::path& path,
-    Device device
+    std::string& source
 ) {
     std::ifstream file(path, std::ios::binary);
     if (!file.is_open()) {
-        return nullptr;
+        return false;
     }
     file.seekg(0, std::ios::end);
 	size_t size = file.tellg();
-	std::string shaderSource(size, ' ');
+	source.assign(size, ' ');
 	file.seekg(0);
-	file.read(&shaderSource[0], size);
+	file.read(&source[0], size);
+    return true;
+}
 
+ShaderModule ResourceManager::loadShaderModule(
+    const std::filesystem::path& path,
+    Device device
+) {
+    std::string shaderSource;
+    if (!loadShaderSource(path, shaderSource)) {
+        return nullptr;
+    }
+    return createShaderModule(shaderSource, device);
+}
+
+ShaderModule ResourceManager::createShaderModule(
+    const std::string& shaderSource,
+    Device device
+) {
     // shader module talks to binary language of CPU rather than GPU -- app distributed w source code of shaders & compiled on the fly
     // Shader language is "WGSL" 
     ShaderModuleDescriptor shaderDesc;
@@ -98,4 +370,223 @@ ShaderModule ResourceManager::loadShaderModule(
 	shaderDesc.nextInChain = &shaderCodeDesc.chain;
 	shaderCodeDesc.code = shaderSource.c_str(); // payload = code block
 	return device.createShaderModule(shaderDesc);
+}
+
+bool ResourceManager::loadImage(
+    const std::filesystem::path& path,
+    Image& image
+) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return decodeImage(data.data(), data.size(), image);
+}
+
+bool ResourceManager::decodeImage(
+    const uint8_t* data,
+    size_t size,
+    Image& image
+) {
+    // PNM files say what they are, TGA files have no magic number
+    if (size >= 2 && data[0] == 'P' && (data[1] == '5' || data[1] == '6')) {
+        return decodePnm(data, size, image);
+    }
+    return decodeTga(data, size, image);
+}
+
+bool ResourceManager::loadKtx2(
+    const std::filesystem::path& path,
+    CompressedImage& image
+) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return decodeKtx2(data.data(), data.size(), image);
+}
+
+bool ResourceManager::decodeKtx2(
+    const uint8_t* data,
+    size_t size,
+    CompressedImage& image
+) {
+    if (size < kKtx2LevelIndexOffset || std::memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0) {
+        return false;
+    }
+    uint32_t vkFormat = readU32(data + 12);
+    uint32_t width = readU32(data + 20);
+    uint32_t height = readU32(data + 24);
+    uint32_t depth = readU32(data + 28);
+    uint32_t layerCount = readU32(data + 32);
+    uint32_t faceCount = readU32(data + 36);
+    // 0 asks the loader to generate mips, the texture gets what the file has
+    uint32_t levelCount = std::max(1u, readU32(data + 40));
+    uint32_t supercompression = readU32(data + 44);
+    // Basis and zstd payloads would need a transcoder we don't have
+    if (width == 0 || height == 0 || depth != 0 || layerCount > 1 || faceCount != 1 || supercompression != 0) {
+        return false;
+    }
+    image.format = formatFromVulkan(vkFormat);
+    if (image.format == TextureFormat::Undefined || levelCount > 32
+        || size < kKtx2LevelIndexOffset + 24 * static_cast<size_t>(levelCount)) {
+        return false;
+    }
+
+    uint32_t blockBytes = compressedBlockBytes(image.format);
+    image.width = width;
+    image.height = height;
+    image.levels.clear();
+    image.data.clear();
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        const uint8_t* entry = data + kKtx2LevelIndexOffset + 24 * static_cast<size_t>(level);
+        uint64_t offset = readU64(entry);
+        uint64_t length = readU64(entry + 8);
+        CompressedImage::Level info;
+        info.width = std::max(1u, width >> level);
+        info.height = std::max(1u, height >> level);
+        if (blockBytes > 0) {
+            info.bytesPerRow = (info.width + 3) / 4 * blockBytes;
+            info.rows = (info.height + 3) / 4;
+        }
+        else {
+            info.bytesPerRow = 4 * info.width;
+            info.rows = info.height;
+        }
+        info.size = static_cast<size_t>(info.bytesPerRow) * info.rows;
+        if (length != info.size || offset > size || length > size - offset) {
+            return false;
+        }
+        // levels are stored smallest first in the file, we keep them largest first
+        info.offset = image.data.size();
+        image.data.insert(image.data.end(), data + offset, data + offset + length);
+        image.levels.push_back(info);
+    }
+    return true;
+}
+
+bool ResourceManager::writeKtx2(
+    const std::filesystem::path& path,
+    const CompressedImage& image
+) {
+    uint32_t vkFormat = vulkanFromFormat(image.format);
+    if (vkFormat == 0 || image.levels.empty()) {
+        return false;
+    }
+    uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+    std::vector<uint8_t> dfd = dataFormatDescriptor(image.format);
+    uint32_t blockBytes = compressedBlockBytes(image.format);
+
+    std::vector<uint8_t> out(kKtx2Identifier, kKtx2Identifier + sizeof(kKtx2Identifier));
+    appendU32(out, vkFormat);
+    appendU32(out, 1); // type size, 1 for block compressed and 8 bit formats
+    appendU32(out, image.width);
+    appendU32(out, image.height);
+    appendU32(out, 0); // depth
+    appendU32(out, 0); // layers
+    appendU32(out, 1); // faces
+    appendU32(out, levelCount);
+    appendU32(out, 0); // no supercompression
+    uint32_t dfdOffset = static_cast<uint32_t>(kKtx2LevelIndexOffset + 24 * levelCount);
+    appendU32(out, dfdOffset);
+    appendU32(out, static_cast<uint32_t>(dfd.size()));
+    appendU32(out, 0); // no key / value data
+    appendU32(out, 0);
+    appendU64(out, 0); // no supercompression global data
+    appendU64(out, 0);
+
+    // level data after the descriptor, smallest level first, each aligned to its block size; rows
+    // are tightly packed in the file, whatever the stride in memory
+    size_t alignment = blockBytes > 0 ? blockBytes : 4;
+    std::vector<uint64_t> offsets(levelCount);
+    std::vector<uint64_t> sizes(levelCount);
+    uint64_t position = dfdOffset + dfd.size();
+    for (uint32_t level = levelCount; level-- > 0;) {
+        const CompressedImage::Level& info = image.levels[level];
+        uint32_t rowBytes = blockBytes > 0 ? (info.width + 3) / 4 * blockBytes : 4 * info.width;
+        if (info.bytesPerRow < rowBytes || info.offset + static_cast<size_t>(info.bytesPerRow) * (info.rows - 1) + rowBytes > image.data.size()) {
+            return false;
+        }
+        position = (position + alignment - 1) / alignment * alignment;
+        offsets[level] = position;
+        sizes[level] = static_cast<uint64_t>(rowBytes) * info.rows;
+        position += sizes[level];
+    }
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        appendU64(out, offsets[level]);
+        appendU64(out, sizes[level]);
+        appendU64(out, sizes[level]);
+    }
+    out.insert(out.end(), dfd.begin(), dfd.end());
+    for (uint32_t level = levelCount; level-- > 0;) {
+        out.resize(offsets[level], 0);
+        const CompressedImage::Level& info = image.levels[level];
+        size_t rowBytes = sizes[level] / info.rows;
+        for (uint32_t row = 0; row < info.rows; ++row) {
+            auto begin = image.data.begin() + info.offset + static_cast<size_t>(row) * info.bytesPerRow;
+            out.insert(out.end(), begin, begin + rowBytes);
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    return file.good();
+}
+
+bool ResourceManager::writeTga(
+    const std::filesystem::path& path,
+    uint32_t width,
+    uint32_t height,
+    const uint8_t* pixels,
+    uint32_t bytesPerRow
+) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open() || width > 0xffff || height > 0xffff) {
+        return false;
+    }
+    uint8_t header[18] = {};
+    header[2] = 2; // uncompressed true color
+    header[12] = width & 0xff;
+    header[13] = (width >> 8) & 0xff;
+    header[14] = height & 0xff;
+    header[15] = (height >> 8) & 0xff;
+    header[16] = 32;
+    header[17] = 0x20 | 8; // top-down rows, 8 alpha bits
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    std::vector<uint8_t> row(4 * static_cast<size_t>(width));
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* source = pixels + static_cast<size_t>(y) * bytesPerRow;
+        for (uint32_t x = 0; x < width; ++x) {
+            row[4 * x + 0] = source[4 * x + 2];
+            row[4 * x + 1] = source[4 * x + 1];
+            row[4 * x + 2] = source[4 * x + 0];
+            row[4 * x + 3] = source[4 * x + 3];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return file.good();
+}
+
+bool ResourceManager::writePng(
+    const std::filesystem::path& path,
+    uint32_t width,
+    uint32_t height,
+    const uint8_t* pixels,
+    uint32_t bytesPerRow
+) {
+    // stb takes the row stride directly, so padded rows don't need to be repacked
+    return stbi_write_png(
+        path.string().c_str(),
+        static_cast<int>(width),
+        static_cast<int>(height),
+        4,
+        pixels,
+        static_cast<int>(bytesPerRow)
+    ) != 0;
 }
\ No newline at end of file
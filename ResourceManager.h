@@ -1,8 +1,37 @@
 #pragma once
 #include <vector>
 #include <filesystem>
+#include <string>
 #include <webgpu/webgpu.hpp>
 
+// Decoded 8-bit RGBA pixels. Rows are `bytesPerRow` apart, padded to 256 bytes like texture
+// copies want them, so they upload as they are.
+struct Image {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t bytesPerRow = 0;
+	std::vector<uint8_t> pixels;
+};
+
+// Texture data the GPU samples as it is, e.g. from a KTX2 file: every mip level of one 2D image,
+// block compressed or plain RGBA8. Levels hold rows of blocks (of texels for RGBA8).
+struct CompressedImage {
+	struct Level {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t bytesPerRow = 0; // from one row of blocks to the next, tightly packed in files
+		uint32_t rows = 0; // of blocks
+		size_t offset = 0; // into `data`
+		size_t size = 0;
+	};
+
+	wgpu::TextureFormat format = wgpu::TextureFormat::Undefined;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<Level> levels; // largest first
+	std::vector<uint8_t> data;
+};
+
 class ResourceManager {
 public:
 	/**
@@ -15,6 +44,23 @@ public:
 		std::vector<uint16_t>& indexData
 	);
 
+	/**
+	 * Read a whole WGSL file into `source`, no device needed (startup reads it while the
+	 * device is being requested).
+	 */
+	static bool loadShaderSource(
+		const std::filesystem::path& path,
+		std::string& source
+	);
+
+	/**
+	 * Create a shader module for a given WebGPU `device` from WGSL `source`.
+	 */
+	static wgpu::ShaderModule createShaderModule(
+		const std::string& source,
+		wgpu::Device device
+	);
+
 	/**
 	 * Create a shader module for a given WebGPU `device` from a WGSL shader source
 	 * loaded from file `path`.
@@ -23,4 +69,76 @@ public:
 		const std::filesystem::path& path,
 		wgpu::Device device
 	);
+
+	/**
+	 * Read and decode the image file at `path`. Binary PPM / PGM (P6, P5, 8 bits) and TGA (true
+	 * color or grayscale, RLE or not) are understood: no general purpose decoder is vendored.
+	 * Safe to call from any thread.
+	 */
+	static bool loadImage(
+		const std::filesystem::path& path,
+		Image& image
+	);
+
+	/**
+	 * Decode an image file already in memory, see loadImage.
+	 */
+	static bool decodeImage(
+		const uint8_t* data,
+		size_t size,
+		Image& image
+	);
+
+	/**
+	 * Read a KTX2 file at `path`. Only what maps to a WebGPU texture without transcoding is
+	 * understood: a single 2D image (no array, no cube map) without supercompression, in BC1 RGBA,
+	 * BC3, BC7, ETC2, ASTC 4x4 or RGBA8. Whether the device can use the format is up to the caller
+	 * (see TextureCompression). Safe to call from any thread.
+	 */
+	static bool loadKtx2(
+		const std::filesystem::path& path,
+		CompressedImage& image
+	);
+
+	/**
+	 * Parse a KTX2 file already in memory, see loadKtx2.
+	 */
+	static bool decodeKtx2(
+		const uint8_t* data,
+		size_t size,
+		CompressedImage& image
+	);
+
+	/**
+	 * Write `image` as a KTX2 file loadKtx2 reads back, with the data format descriptor other
+	 * tools want. BC1, BC3 and RGBA8 only.
+	 */
+	static bool writeKtx2(
+		const std::filesystem::path& path,
+		const CompressedImage& image
+	);
+
+	/**
+	 * Write 8-bit RGBA pixels to an uncompressed 32-bit TGA file, which loadImage reads back.
+	 * `bytesPerRow` may be larger than 4 * width.
+	 */
+	static bool writeTga(
+		const std::filesystem::path& path,
+		uint32_t width,
+		uint32_t height,
+		const uint8_t* pixels,
+		uint32_t bytesPerRow
+	);
+
+	/**
+	 * Write 8-bit RGBA pixels to a PNG file. `bytesPerRow` may be larger than 4 * width, e.g.
+	 * for buffers read back from the GPU whose rows are padded to 256 bytes.
+	 */
+	static bool writePng(
+		const std::filesystem::path& path,
+		uint32_t width,
+		uint32_t height,
+		const uint8_t* pixels,
+		uint32_t bytesPerRow
+	);
 };
\ No newline at end of file
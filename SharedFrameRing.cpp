@@ -0,0 +1,272 @@
+// SharedFrameRing.cpp
+#include "SharedFrameRing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if !defined(__EMSCRIPTEN__) && (defined(__unix__) || defined(__APPLE__))
+#  define SHARED_FRAMES_SUPPORTED 1
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+#ifdef __linux__
+#  include <climits>
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#endif
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock free");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+namespace {
+
+constexpr uint64_t alignTo(uint64_t value, uint64_t step) {
+	return (value + step - 1) / step * step;
+}
+
+void wakeAll(std::atomic<uint32_t>& word) {
+#ifdef __linux__
+	// not FUTEX_PRIVATE_FLAG: the waiter is in another process
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+	(void)word;
+#endif
+}
+
+// wait until `word` is no longer `expected`, or about `timeoutMs`. May return early.
+void waitChange(std::atomic<uint32_t>& word, uint32_t expected, uint32_t timeoutMs) {
+#ifdef __linux__
+	timespec timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000;
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+#else
+	// no portable cross process wait, poll every millisecond
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (word.load(std::memory_order_acquire) == expected && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+#endif
+}
+
+SharedSlotHeader* slotAddress(SharedFrameHeader* header, uint64_t sequence) {
+	uint64_t index = (sequence - 1) % header->slotCount;
+	uint8_t* base = reinterpret_cast<uint8_t*>(header) + header->headerSize;
+	return reinterpret_cast<SharedSlotHeader*>(base + index * header->slotStride);
+}
+
+} // namespace
+
+uint64_t sharedFrameClockNs() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// -- writer
+
+SharedFrameWriter::~SharedFrameWriter() {
+	close();
+}
+
+bool SharedFrameWriter::open(const std::string& objectName, uint32_t slotCount, uint64_t slotSize) {
+#ifdef SHARED_FRAMES_SUPPORTED
+	uint64_t headerSize = alignTo(sizeof(SharedFrameHeader), 64);
+	uint64_t slotStride = alignTo(sizeof(SharedSlotHeader) + slotSize, 64);
+	mappedSize = static_cast<size_t>(headerSize + slotStride * slotCount);
+
+	// start from a fresh object, a previous run may have left one with another size
+	shm_unlink(objectName.c_str());
+	int fd = shm_open(objectName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		std::cerr << "shm_open(" << objectName << ") failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+	if (ftruncate(fd, static_cast<off_t>(mappedSize)) != 0) {
+		std::cerr << "Could not size " << objectName << ": " << std::strerror(errno) << std::endl;
+		::close(fd);
+		shm_unlink(objectName.c_str());
+		return false;
+	}
+	void* memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd); // the mapping keeps the object alive
+	if (memory == MAP_FAILED) {
+		std::cerr << "Could not map " << objectName << ": " << std::strerror(errno) << std::endl;
+		shm_unlink(objectName.c_str());
+		return false;
+	}
+
+	// ftruncate zero fills, so every atomic starts at 0 and every slot reads as "being written"
+	header = static_cast<SharedFrameHeader*>(memory);
+	header->version = SharedFrameVersion;
+	header->slotCount = slotCount;
+	header->headerSize = static_cast<uint32_t>(headerSize);
+	header->slotSize = slotSize;
+	header->slotStride = slotStride;
+	// written last, readers check it before anything else
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = SharedFrameMagic;
+
+	name = objectName;
+	sequence = 0;
+	return true;
+#else
+	(void)objectName; (void)slotCount; (void)slotSize;
+	std::cerr << "Shared memory frame output is not available on this platform" << std::endl;
+	return false;
+#endif
+}
+
+void SharedFrameWriter::close() {
+#ifdef SHARED_FRAMES_SUPPORTED
+	if (header == nullptr) return;
+	header->closed.store(1, std::memory_order_release);
+	// bump the futex word so that a waiting consumer notices
+	header->published.fetch_add(0x80000000u, std::memory_order_release);
+	wakeAll(header->published);
+	munmap(header, mappedSize);
+	// the consumer keeps its own mapping, unlinking only removes the name
+	shm_unlink(name.c_str());
+	header = nullptr;
+#endif
+}
+
+bool SharedFrameWriter::publish(const uint8_t* pixels, uint64_t size, uint32_t width, uint32_t height,
+	uint32_t bytesPerRow, uint32_t rowCount, SharedFrameFormat format, uint64_t frameIndex)
+{
+	if (header == nullptr || size > header->slotSize) return false;
+
+	uint64_t next = sequence + 1;
+	// the slot still holds frame next - slotCount, which the consumer may be reading
+	if (header->attached.load(std::memory_order_acquire) != 0
+		&& next > header->slotCount
+		&& header->consumed.load(std::memory_order_acquire) < next - header->slotCount)
+	{
+		header->dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	SharedSlotHeader* slot = slotAddress(header, next);
+	slot->sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	// WebGPU maps readback buffers into memory we do not own, so this copy is the only one
+	std::memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(SharedSlotHeader), pixels, size);
+	slot->frameIndex = frameIndex;
+	slot->size = size;
+	slot->width = width;
+	slot->height = height;
+	slot->bytesPerRow = bytesPerRow;
+	slot->rowCount = rowCount;
+	slot->format = format;
+	slot->publishTimeNs = sharedFrameClockNs();
+	slot->sequence.store(next, std::memory_order_release);
+
+	sequence = next;
+	header->publishedSequence.store(next, std::memory_order_release);
+	header->published.fetch_add(1, std::memory_order_release);
+	wakeAll(header->published);
+	return true;
+}
+
+uint64_t SharedFrameWriter::publishedFrames() const {
+	return sequence;
+}
+
+uint64_t SharedFrameWriter::droppedFrames() const {
+	return header ? header->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+// -- reader
+
+SharedFrameReader::~SharedFrameReader() {
+	close();
+}
+
+bool SharedFrameReader::open(const std::string& objectName) {
+#ifdef SHARED_FRAMES_SUPPORTED
+	int fd = shm_open(objectName.c_str(), O_RDWR, 0);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(SharedFrameHeader)) {
+		::close(fd);
+		return false;
+	}
+	mappedSize = static_cast<size_t>(status.st_size);
+	void* memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		return false;
+	}
+	header = static_cast<SharedFrameHeader*>(memory);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (header->magic != SharedFrameMagic || header->version != SharedFrameVersion) {
+		// not initialized yet, or not ours
+		munmap(memory, mappedSize);
+		header = nullptr;
+		return false;
+	}
+
+	// frames published before we came are skipped, and no longer hold the writer back
+	uint64_t last = header->publishedSequence.load(std::memory_order_acquire);
+	header->consumed.store(last, std::memory_order_release);
+	header->attached.store(1, std::memory_order_release);
+	next = last + 1;
+	return true;
+#else
+	(void)objectName;
+	return false;
+#endif
+}
+
+void SharedFrameReader::close() {
+#ifdef SHARED_FRAMES_SUPPORTED
+	if (header == nullptr) return;
+	header->attached.store(0, std::memory_order_release);
+	munmap(header, mappedSize);
+	header = nullptr;
+#endif
+}
+
+SharedSlotHeader* SharedFrameReader::slotAt(uint64_t sequence) const {
+	return slotAddress(header, sequence);
+}
+
+bool SharedFrameReader::acquire(SharedFrameView& frame, uint32_t timeoutMs) {
+	if (header == nullptr) return false;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	for (;;) {
+		uint32_t word = header->published.load(std::memory_order_acquire);
+		if (header->publishedSequence.load(std::memory_order_acquire) >= next) {
+			SharedSlotHeader* slot = slotAt(next);
+			if (slot->sequence.load(std::memory_order_acquire) == next) {
+				frame.slot = slot;
+				frame.pixels = reinterpret_cast<const uint8_t*>(slot) + sizeof(SharedSlotHeader);
+				frame.sequence = next;
+				return true;
+			}
+		}
+		if (writerClosed()) return false;
+		auto now = std::chrono::steady_clock::now();
+		if (now >= deadline) return false;
+		uint32_t remaining = static_cast<uint32_t>(
+			std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+		waitChange(header->published, word, std::max<uint32_t>(remaining, 1));
+	}
+}
+
+void SharedFrameReader::release(const SharedFrameView& frame) {
+	if (header == nullptr || frame.sequence != next) return;
+	header->consumed.store(frame.sequence, std::memory_order_release);
+	++next;
+}
+
+bool SharedFrameReader::writerClosed() const {
+	return header == nullptr || header->closed.load(std::memory_order_acquire) != 0;
+}
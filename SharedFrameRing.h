@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Frames handed to other local processes through a POSIX shared-memory ring.
+ *
+ * The object `name` (as given to shm_open, e.g. "/webgpu-frames") holds a SharedFrameHeader
+ * followed by `slotCount` slots of SharedSlotHeader + `slotSize` bytes of pixels. The App writes
+ * frames round robin, a consumer maps the same object and reads them in place:
+ *
+ *  - a slot's `sequence` is 0 while it is being written and the frame's sequence number (1, 2, ...)
+ *    once complete, so a reader can tell which frame a slot holds
+ *  - `published` is the sequence of the last complete frame. Its low 32 bits are a futex word
+ *    (Linux), woken on every frame. Other systems poll it
+ *  - the consumer stores the last sequence it is done with in `consumed`. While a consumer is
+ *    attached, the writer never overwrites a slot that has not been consumed: it drops the frame
+ *    instead (counted in `dropped`), so frames are never torn and rendering never waits
+ *
+ * Both sides only use lock-free atomics, which work across processes on everything we build for.
+ */
+constexpr uint32_t SharedFrameMagic = 0x57465246; // "FRFW"
+constexpr uint32_t SharedFrameVersion = 1;
+
+// Layout of the pixels in a slot, matches --capture
+enum class SharedFrameFormat : uint32_t {
+	Rgba8 = 0, // rows of bytesPerRow bytes (padded to 256)
+	Nv12 = 1, // bytesPerRow x rowCount luma, then bytesPerRow x rowCount/2 interleaved chroma
+	I420 = 2, // same luma, then two (bytesPerRow/2) x (rowCount/2) chroma planes
+};
+
+struct SharedFrameHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t headerSize; // offset of the first slot
+	uint64_t slotSize; // pixel bytes per slot
+	uint64_t slotStride; // SharedSlotHeader + pixels, rounded to 64 bytes
+	std::atomic<uint32_t> published; // futex word: low 32 bits of the last published sequence
+	std::atomic<uint32_t> attached; // non zero while a consumer has the ring open
+	std::atomic<uint64_t> publishedSequence; // same as `published`, full width
+	std::atomic<uint64_t> consumed; // written by the consumer
+	std::atomic<uint64_t> dropped; // frames the writer skipped because the consumer was behind
+	std::atomic<uint32_t> closed; // the writer is gone, no more frames will come
+};
+
+struct alignas(64) SharedSlotHeader {
+	std::atomic<uint64_t> sequence;
+	uint64_t frameIndex;
+	uint64_t publishTimeNs; // steady clock (CLOCK_MONOTONIC on Linux), comparable across processes
+	uint64_t size; // bytes of pixels actually used
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerRow;
+	uint32_t rowCount; // luma rows including padding, for the YUV layouts
+	SharedFrameFormat format;
+};
+
+// A frame seen from the consumer side, `pixels` points into the shared mapping
+struct SharedFrameView {
+	const SharedSlotHeader* slot = nullptr;
+	const uint8_t* pixels = nullptr;
+	uint64_t sequence = 0;
+};
+
+/**
+ * The App's side: creates the shared object, publishes frames into it, unlinks it on close.
+ */
+class SharedFrameWriter {
+public:
+	~SharedFrameWriter();
+
+	bool open(const std::string& name, uint32_t slotCount, uint64_t slotSize);
+	void close();
+	bool isOpen() const { return header != nullptr; }
+
+	/**
+	 * Copy a frame into the next slot and wake the consumer. Returns false (and counts a drop)
+	 * when an attached consumer has not released that slot yet. Called from one thread only.
+	 */
+	bool publish(const uint8_t* pixels, uint64_t size, uint32_t width, uint32_t height,
+		uint32_t bytesPerRow, uint32_t rowCount, SharedFrameFormat format, uint64_t frameIndex);
+
+	uint64_t publishedFrames() const;
+	uint64_t droppedFrames() const;
+
+private:
+	std::string name;
+	SharedFrameHeader* header = nullptr;
+	size_t mappedSize = 0;
+	uint64_t sequence = 0;
+};
+
+/**
+ * The consumer's side, see tools/shm_consumer.cpp.
+ */
+class SharedFrameReader {
+public:
+	~SharedFrameReader();
+
+	// Fails if the object does not exist yet or is not a frame ring
+	bool open(const std::string& name);
+	void close();
+
+	/**
+	 * Wait up to `timeoutMs` for the frame after the last one released and return it, read in
+	 * place. Returns false on timeout or once the writer closed the ring.
+	 */
+	bool acquire(SharedFrameView& frame, uint32_t timeoutMs);
+	// Done with `frame`, its slot can be written again
+	void release(const SharedFrameView& frame);
+
+	bool writerClosed() const;
+	const SharedFrameHeader* info() const { return header; }
+
+private:
+	SharedSlotHeader* slotAt(uint64_t sequence) const;
+
+	SharedFrameHeader* header = nullptr;
+	size_t mappedSize = 0;
+	uint64_t next = 1;
+};
+
+// steady clock in nanoseconds, what publishTimeNs is stamped with
+uint64_t sharedFrameClockNs();
@@ -0,0 +1,115 @@
+// Simulation.cpp
+#include "Simulation.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+Simulation::Simulation(double timestep)
+	: timestep(timestep)
+{
+	state.publishTime = Clock::now();
+	nextStepTime = state.publishTime;
+	// make the initial state visible so that sample() is valid before the first step
+	snapshots.writeBuffer() = state;
+	snapshots.publish();
+}
+
+Simulation::~Simulation() {
+	stop();
+}
+
+void Simulation::start() {
+	nextStepTime = Clock::now();
+#ifndef __EMSCRIPTEN__
+	running = true;
+	thread = std::thread(&Simulation::run, this);
+#endif
+}
+
+void Simulation::stop() {
+#ifndef __EMSCRIPTEN__
+	{
+		std::lock_guard<std::mutex> lock(pauseMutex);
+		running = false;
+	}
+	resumed.notify_all();
+	if (thread.joinable()) {
+		thread.join();
+	}
+#endif
+}
+
+void Simulation::update() {
+	if (paused) {
+		nextStepTime = Clock::now();
+		return;
+	}
+	// same catch-up rule as the threaded loop, bounded so a long hitch doesn't freeze the frame
+	for (int i = 0; i < 8 && Clock::now() >= nextStepTime; ++i) {
+		step();
+		nextStepTime += std::chrono::duration_cast<Clock::duration>(timestep);
+	}
+	if (Clock::now() > nextStepTime) {
+		nextStepTime = Clock::now();
+	}
+}
+
+void Simulation::setPaused(bool pause) {
+#ifndef __EMSCRIPTEN__
+	{
+		std::lock_guard<std::mutex> lock(pauseMutex);
+		paused = pause;
+	}
+	resumed.notify_all();
+#else
+	paused = pause;
+#endif
+}
+
+SimState Simulation::sample() {
+	snapshots.update();
+	const FrameSnapshot& snapshot = snapshots.read();
+
+	// `current` is valid from publishTime on, and the next step lands one timestep later. Showing the
+	// blend between previous and current delays by at most one step but never extrapolates.
+	double alpha = std::chrono::duration<double>(Clock::now() - snapshot.publishTime) / timestep;
+	alpha = std::clamp(alpha, 0.0, 1.0);
+
+	SimState blended;
+	blended.time = snapshot.previous.time + (snapshot.current.time - snapshot.previous.time) * alpha;
+	return blended;
+}
+
+void Simulation::step() {
+	TRACE_SCOPE("simulation step");
+	state.previous = state.current;
+	state.current.time += timestep.count();
+	state.tick += 1;
+	state.publishTime = Clock::now();
+
+	snapshots.writeBuffer() = state;
+	snapshots.publish();
+}
+
+void Simulation::run() {
+	Trace::setThreadName("simulation");
+	while (running) {
+		if (paused) {
+			// nothing to simulate: sleep instead of stepping a frozen clock 120 times per second
+			std::unique_lock<std::mutex> lock(pauseMutex);
+			resumed.wait(lock, [this]() { return !paused || !running; });
+			nextStepTime = Clock::now();
+			continue;
+		}
+		step();
+		nextStepTime += std::chrono::duration_cast<Clock::duration>(timestep);
+
+		// if we fell far behind (debugger, suspended laptop) restart the schedule instead of
+		// burning through hundreds of catch-up steps
+		Clock::time_point now = Clock::now();
+		if (now - nextStepTime > std::chrono::milliseconds(250)) {
+			nextStepTime = now;
+		}
+		std::this_thread::sleep_until(nextStepTime);
+	}
+}
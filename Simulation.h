@@ -0,0 +1,76 @@
+#pragma once
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#ifndef __EMSCRIPTEN__
+#  include <condition_variable>
+#  include <mutex>
+#  include <thread>
+#endif
+
+/**
+ * Everything the simulation produces for one step. Must stay trivially copyable, it is copied
+ * into the triple buffer each step.
+ */
+struct SimState {
+	double time = 0.0; // simulated seconds since start
+};
+
+/**
+ * Immutable snapshot handed from the simulation thread to the render loop. It holds the last two
+ * steps so that the renderer can interpolate between them.
+ */
+struct FrameSnapshot {
+	SimState previous;
+	SimState current;
+	uint64_t tick = 0; // number of steps taken when this snapshot was published
+	std::chrono::steady_clock::time_point publishTime; // wall clock time at which `current` became valid
+};
+
+/**
+ * Fixed timestep simulation running on its own thread. Frames are published through a lock-free
+ * triple buffer, so the render loop never waits on the simulation and vice versa.
+ * Without threads (emscripten), call update() from the main loop instead of start().
+ */
+class Simulation {
+public:
+	explicit Simulation(double timestep = 1.0 / 120.0);
+	~Simulation();
+
+	// Spawn the simulation thread
+	void start();
+	// Join the simulation thread
+	void stop();
+
+	// Single threaded fallback: take as many fixed steps as wall clock time allows
+	void update();
+
+	// Freeze simulated time. The thread sleeps until resumed, and resuming does not catch up on
+	// the steps that were skipped meanwhile.
+	void setPaused(bool paused);
+	bool isPaused() const { return paused; }
+
+	// Render side: newest state, interpolated between its last two steps for the current time
+	SimState sample();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void step();
+	void run();
+
+	std::chrono::duration<double> timestep;
+	FrameSnapshot state; // owned by the simulation thread
+	TripleBuffer<FrameSnapshot> snapshots;
+	Clock::time_point nextStepTime;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> paused{ false };
+#ifndef __EMSCRIPTEN__
+	std::thread thread;
+	// wakes the thread when pausing ends or on stop
+	std::mutex pauseMutex;
+	std::condition_variable resumed;
+#endif
+};
@@ -0,0 +1,176 @@
+// StagingBelt.cpp
+#include "StagingBelt.h"
+#include "GpuMemory.h"
+#include "LifetimeTracker.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+using namespace wgpu;
+
+StagingBelt::~StagingBelt() {
+	terminate();
+}
+
+void StagingBelt::initialize(Device gpuDevice, uint64_t size, LifetimeTracker* tracker) {
+	device = gpuDevice;
+	chunkSize = (size + kCopyAlignment - 1) & ~(kCopyAlignment - 1);
+	lifetimes = tracker;
+}
+
+void StagingBelt::terminate() {
+	// the device is done by now, and the tracker may already be
+	lifetimes = nullptr;
+	for (std::unique_ptr<Chunk>& chunk : chunks) {
+		GpuMemory::untrack(chunk->buffer);
+		chunk->buffer.destroy();
+		chunk->buffer.release();
+		// after the release, a pending map may still report back through it
+		chunk->mapCallback.reset();
+	}
+	chunks.clear();
+	current = nullptr;
+}
+
+StagingBelt::Chunk* StagingBelt::createChunk(uint64_t size) {
+	BufferDescriptor bufferDesc = {};
+	bufferDesc.label = "Staging chunk";
+	bufferDesc.size = size;
+	bufferDesc.usage = BufferUsage::MapWrite | BufferUsage::CopySrc;
+	// writable right away, no mapAsync round trip for the first use
+	bufferDesc.mappedAtCreation = true;
+	Buffer buffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Staging);
+	if (!buffer) return nullptr;
+	void* mapped = buffer.getMappedRange(0, size);
+	if (mapped == nullptr) {
+		GpuMemory::untrack(buffer);
+		buffer.release();
+		return nullptr;
+	}
+	++chunksCreated;
+
+	chunks.push_back(std::make_unique<Chunk>());
+	Chunk* chunk = chunks.back().get();
+	chunk->buffer = buffer;
+	chunk->size = size;
+	chunk->mapped = reinterpret_cast<uint8_t*>(mapped);
+	chunk->state = ChunkState::Ready;
+	return chunk;
+}
+
+StagingBelt::Chunk* StagingBelt::acquireChunk(uint64_t size) {
+	if (current != nullptr && current->size - current->used >= size) {
+		return current;
+	}
+	// the smallest mapped chunk that fits, so the oversized ones are kept for oversized uploads
+	Chunk* best = nullptr;
+	for (std::unique_ptr<Chunk>& chunk : chunks) {
+		if (chunk->state == ChunkState::Ready && chunk->size >= size && (best == nullptr || chunk->size < best->size)) {
+			best = chunk.get();
+		}
+	}
+	if (best == nullptr) {
+		best = createChunk(std::max(chunkSize, size));
+		if (best == nullptr) return nullptr;
+	}
+	// a full chunk stays in Writing until finish(), reservations in it are still being filled
+	current = best;
+	return current;
+}
+
+void* StagingBelt::reserve(CommandEncoder encoder, Buffer target, uint64_t offset, uint64_t size) {
+	size = (size + kCopyAlignment - 1) & ~(kCopyAlignment - 1);
+	Chunk* chunk = acquireChunk(size);
+	if (chunk == nullptr) return nullptr;
+
+	uint64_t chunkOffset = chunk->used;
+	chunk->used += size;
+	chunk->state = ChunkState::Writing;
+	encoder.copyBufferToBuffer(chunk->buffer, chunkOffset, target, offset, size);
+	uploaded += size;
+	return chunk->mapped + chunkOffset;
+}
+
+bool StagingBelt::write(CommandEncoder encoder, Buffer target, uint64_t offset, const void* data, uint64_t size) {
+	// the copy is rounded up to 4 bytes, the padding is whatever was in the chunk
+	void* destination = reserve(encoder, target, offset, size);
+	if (destination == nullptr) return false;
+	std::memcpy(destination, data, size);
+	return true;
+}
+
+void StagingBelt::finish() {
+	TRACE_SCOPE("staging finish");
+	for (std::unique_ptr<Chunk>& chunk : chunks) {
+		if (chunk->state != ChunkState::Writing) continue;
+		chunk->buffer.unmap();
+		chunk->mapped = nullptr;
+		chunk->state = ChunkState::Submitting;
+	}
+	// the next reservation picks a mapped chunk
+	current = nullptr;
+}
+
+void StagingBelt::recall() {
+	for (std::unique_ptr<Chunk>& chunk : chunks) {
+		if (chunk->state != ChunkState::Submitting) continue;
+		chunk->state = ChunkState::Mapping;
+		Chunk* mapping = chunk.get();
+		chunk->mapCallback = chunk->buffer.mapAsync(MapMode::Write, 0, chunk->size, [this, mapping](BufferMapAsyncStatus status) {
+			if (status != BufferMapAsyncStatus::Success) {
+				// device lost or buffer destroyed: keep it out of the pool
+				mapping->state = ChunkState::Failed;
+				++mapFailures;
+				return;
+			}
+			mapping->mapped = reinterpret_cast<uint8_t*>(mapping->buffer.getMappedRange(0, mapping->size));
+			mapping->used = 0;
+			mapping->state = ChunkState::Ready;
+		});
+	}
+}
+
+uint64_t StagingBelt::trim(uint64_t bytes) {
+	uint64_t freed = 0;
+	for (auto it = chunks.begin(); it != chunks.end() && freed < bytes;) {
+		Chunk* chunk = it->get();
+		// only idle chunks: the others are being written or the GPU may be copying out of them
+		if (chunk->state != ChunkState::Ready || chunk == current) {
+			++it;
+			continue;
+		}
+		freed += chunk->size;
+		// out of the budget now, destroyed along with whatever else the recorded commands use
+		GpuMemory::untrack(chunk->buffer);
+		if (lifetimes) {
+			lifetimes->release(chunk->buffer);
+		}
+		else {
+			chunk->buffer.destroy();
+			chunk->buffer.release();
+		}
+		it = chunks.erase(it);
+	}
+	return freed;
+}
+
+uint32_t StagingBelt::readyChunks() const {
+	return static_cast<uint32_t>(std::count_if(chunks.begin(), chunks.end(), [](const std::unique_ptr<Chunk>& chunk) {
+		return chunk->state == ChunkState::Ready;
+	}));
+}
+
+void StagingBelt::report(std::ostream& out) const {
+	uint64_t reserved = 0;
+	for (const std::unique_ptr<Chunk>& chunk : chunks) {
+		reserved += chunk->size;
+	}
+	out << "Staging belt: " << std::fixed << std::setprecision(2) << uploaded / (1024.0 * 1024.0) << " MiB uploaded through "
+		<< chunksCreated << " chunk(s), " << reserved / (1024.0 * 1024.0) << " MiB of staging memory";
+	if (mapFailures > 0) {
+		out << ", " << mapFailures << " failed map(s)";
+	}
+	out << std::defaultfloat << std::endl;
+}
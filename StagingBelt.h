@@ -0,0 +1,87 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+class LifetimeTracker;
+
+/**
+ * Uploads through staging memory we own instead of the driver's: a pool of MapWrite | CopySrc
+ * chunks that data is written into directly, then copied to its destination with
+ * copyBufferToBuffer in the frame's command encoder.
+ *
+ * A frame goes write... / finish() / submit / recall(). finish() unmaps the chunks written so
+ * the copies can be submitted, recall() maps them again; a chunk comes back to the pool when its
+ * mapAsync completes, i.e. once the GPU is done copying out of it. New chunks are created
+ * mappedAtCreation, so the first uploads (startup) do not wait for a map round trip.
+ *
+ * Uploads larger than a chunk get a chunk of their own, which is pooled like the others.
+ */
+class StagingBelt {
+public:
+	// copyBufferToBuffer offsets and sizes are multiples of this
+	static constexpr uint64_t kCopyAlignment = 4;
+
+	~StagingBelt();
+
+	// Without `lifetimes`, chunks trim() gives back are destroyed right away
+	void initialize(wgpu::Device device, uint64_t chunkSize = 1 << 20, LifetimeTracker* lifetimes = nullptr);
+	// Chunks still mapping are released too, their callbacks are dropped
+	void terminate();
+
+	/**
+	 * Reserve `size` bytes of mapped memory that will be copied to `target` at `offset` when
+	 * `encoder` is submitted. Fill it before finish(). `offset` and `size` must be multiples of
+	 * kCopyAlignment. Returns nullptr if no chunk could be created.
+	 */
+	void* reserve(wgpu::CommandEncoder encoder, wgpu::Buffer target, uint64_t offset, uint64_t size);
+	// reserve() and a memcpy
+	bool write(wgpu::CommandEncoder encoder, wgpu::Buffer target, uint64_t offset, const void* data, uint64_t size);
+
+	// Unmap the chunks written since the last call. Before submitting the encoder(s) used.
+	void finish();
+	// Map the chunks just submitted again, they are reused once mapped. After the submit.
+	void recall();
+	// Over the memory budget: destroy idle chunks until `bytes` are freed. Returns the bytes freed.
+	uint64_t trim(uint64_t bytes);
+
+	uint64_t uploadedBytes() const { return uploaded; }
+	uint64_t createdChunks() const { return chunksCreated; }
+	// chunks a reserve() could use right now without creating one
+	uint32_t readyChunks() const;
+	void report(std::ostream& out) const;
+
+private:
+	enum class ChunkState {
+		Ready, // mapped, nothing written yet
+		Writing, // mapped, some of it reserved this frame
+		Submitting, // unmapped by finish(), waiting for recall()
+		Mapping, // mapAsync requested, the GPU may still be copying out of it
+		Failed, // the map failed, never used again
+	};
+
+	struct Chunk {
+		wgpu::Buffer buffer = nullptr;
+		uint64_t size = 0;
+		uint64_t used = 0;
+		uint8_t* mapped = nullptr;
+		ChunkState state = ChunkState::Ready;
+		std::unique_ptr<wgpu::BufferMapCallback> mapCallback;
+	};
+
+	Chunk* acquireChunk(uint64_t size);
+	Chunk* createChunk(uint64_t size);
+
+	wgpu::Device device = nullptr;
+	LifetimeTracker* lifetimes = nullptr;
+	uint64_t chunkSize = 1 << 20;
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	// the chunk reservations go to until it is full
+	Chunk* current = nullptr;
+	uint64_t uploaded = 0;
+	uint64_t chunksCreated = 0;
+	uint64_t mapFailures = 0;
+};
@@ -0,0 +1,82 @@
+// StartupProfiler.cpp
+#include "StartupProfiler.h"
+
+#include <iomanip>
+
+void StartupProfiler::start() {
+	std::lock_guard<std::mutex> lock(mutex);
+	origin = Clock::now();
+	mainThread = std::this_thread::get_id();
+	spans.clear();
+	finished = false;
+	totalMilliseconds = 0.0;
+}
+
+double StartupProfiler::now() const {
+	return std::chrono::duration<double, std::milli>(Clock::now() - origin).count();
+}
+
+void StartupProfiler::begin(const std::string& name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (finished) return;
+	for (const Span& open : spans) {
+		if (open.endMs < 0.0 && open.name == name) return;
+	}
+	Span span;
+	span.name = name;
+	span.mainThread = std::this_thread::get_id() == mainThread;
+	span.startMs = now();
+	spans.push_back(span);
+}
+
+void StartupProfiler::end(const std::string& name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (finished) return;
+	for (size_t i = spans.size(); i-- > 0;) {
+		if (spans[i].endMs < 0.0 && spans[i].name == name) {
+			spans[i].endMs = now();
+			return;
+		}
+	}
+}
+
+bool StartupProfiler::finish() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (finished) return false;
+	totalMilliseconds = now();
+	finished = true;
+	return true;
+}
+
+void StartupProfiler::report(std::ostream& out) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	out << "Startup: " << std::fixed << std::setprecision(1) << totalMilliseconds << " ms to the first frame" << std::endl;
+	for (const Span& span : spans) {
+		out << "  " << std::left << std::setw(24) << span.name << std::right;
+		if (span.endMs < 0.0) {
+			out << "  still open";
+		}
+		else {
+			out << std::setw(9) << span.endMs - span.startMs << " ms";
+		}
+		out << "  at " << std::setw(8) << span.startMs << " ms" << (span.mainThread ? "" : "  (loader thread)") << std::endl;
+	}
+	out << std::defaultfloat;
+}
+
+void StartupProfiler::writeJson(std::ostream& out) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	out << std::fixed << std::setprecision(3) << "{\n"
+		<< "  \"time_to_first_frame_ms\": " << totalMilliseconds << ",\n"
+		<< "  \"phases\": [";
+	for (size_t i = 0; i < spans.size(); ++i) {
+		const Span& span = spans[i];
+		// still open at the first frame: count it up to there
+		double endMs = span.endMs < 0.0 ? totalMilliseconds : span.endMs;
+		out << (i == 0 ? "\n" : ",\n")
+			<< "    {\"name\": \"" << span.name << "\", \"start_ms\": " << span.startMs
+			<< ", \"duration_ms\": " << endMs - span.startMs
+			<< ", \"thread\": \"" << (span.mainThread ? "main" : "loader") << "\"}";
+	}
+	out << "\n  ]\n}" << std::defaultfloat << std::endl;
+}
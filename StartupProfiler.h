@@ -0,0 +1,65 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Times the phases of startup, from the beginning of Initialize to the first presented frame.
+ *
+ * Phases are named spans, opened with begin and closed with end, or timed by a Phase guard.
+ * They may overlap (files load on a thread while the device is requested) and be closed from
+ * another call than the one that opened them (the adapter request ends in its callback's tick).
+ * finish() stops the clock, report and writeJson describe what was recorded until then.
+ */
+class StartupProfiler {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Time zero, the start of Initialize
+	void start();
+	// Open the phase `name`, recorded for the calling thread. Ignored once finished, or while a
+	// phase of that name is already open (a first frame that had to be retried...)
+	void begin(const std::string& name);
+	// Close the most recent open phase called `name`
+	void end(const std::string& name);
+	// First frame is out: stop recording, return false if it was already finished
+	bool finish();
+	bool isFinished() const { return finished; }
+	double totalMs() const { return totalMilliseconds; }
+
+	// One line per phase, in start order, with the time to first frame
+	void report(std::ostream& out) const;
+	void writeJson(std::ostream& out) const;
+
+	// Times the enclosing scope as a phase
+	class Phase {
+	public:
+		Phase(StartupProfiler& profiler, const char* name) : profiler(profiler), name(name) { profiler.begin(name); }
+		~Phase() { profiler.end(name); }
+		Phase(const Phase&) = delete;
+		Phase& operator=(const Phase&) = delete;
+	private:
+		StartupProfiler& profiler;
+		const char* name;
+	};
+
+private:
+	struct Span {
+		std::string name;
+		bool mainThread = true;
+		double startMs = 0.0;
+		double endMs = -1.0; // negative while open
+	};
+
+	double now() const;
+
+	mutable std::mutex mutex; // phases are recorded from the loader thread too
+	Clock::time_point origin;
+	std::thread::id mainThread;
+	std::vector<Span> spans;
+	bool finished = false;
+	double totalMilliseconds = 0.0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+/**
+ * Order statistics of a series of measurements (times in milliseconds, usually).
+ */
+struct Summary {
+	size_t count = 0;
+	double min = 0.0;
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+
+	// Takes `samples` by value since it needs to sort them
+	static Summary of(std::vector<double> samples) {
+		Summary summary;
+		summary.count = samples.size();
+		if (samples.empty()) {
+			return summary;
+		}
+		std::sort(samples.begin(), samples.end());
+		double sum = 0.0;
+		for (double sample : samples) {
+			sum += sample;
+		}
+		summary.min = samples.front();
+		summary.max = samples.back();
+		summary.mean = sum / static_cast<double>(samples.size());
+		summary.p50 = percentile(samples, 0.50);
+		summary.p95 = percentile(samples, 0.95);
+		summary.p99 = percentile(samples, 0.99);
+		return summary;
+	}
+
+	// nearest-rank percentile of an already sorted series, `q` in [0, 1]
+	static double percentile(const std::vector<double>& sorted, double q) {
+		size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(sorted.size())));
+		return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+	}
+
+	// JSON object with all the fields, no trailing newline
+	void writeJson(std::ostream& out) const {
+		out << "{\"count\": " << count
+			<< ", \"min\": " << min
+			<< ", \"mean\": " << mean
+			<< ", \"p50\": " << p50
+			<< ", \"p95\": " << p95
+			<< ", \"p99\": " << p99
+			<< ", \"max\": " << max << "}";
+	}
+};
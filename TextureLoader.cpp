@@ -0,0 +1,331 @@
+// TextureLoader.cpp
+#include "TextureLoader.h"
+#include "GpuMemory.h"
+#include "MipmapGenerator.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+using namespace wgpu;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool isKtx2(const std::filesystem::path& path) {
+	return path.extension() == ".ktx2";
+}
+} // namespace
+
+void TextureLoader::initialize(Device gpuDevice, Queue gpuQueue, MipmapGenerator* mipmapGenerator,
+	TextureCompression compressionFeatures) {
+	device = gpuDevice;
+	queue = gpuQueue;
+	mipmaps = mipmapGenerator;
+	supported = compressionFeatures;
+	compression = CompressionStats();
+}
+
+LoadedTexture TextureLoader::upload(const Image& image, const char* label) {
+	CommandEncoder encoder = nullptr;
+	if (mipmaps) {
+		CommandEncoderDescriptor encoderDesc = {};
+		encoderDesc.label = "Texture mipmaps";
+		encoder = device.createCommandEncoder(encoderDesc);
+	}
+	LoadedTexture loaded = createTexture(image, label, encoder);
+	if (encoder) {
+		CommandBufferDescriptor cmdBufferDescriptor = {};
+		CommandBuffer command = encoder.finish(cmdBufferDescriptor);
+		encoder.release();
+		queue.submit(1, &command);
+		command.release();
+	}
+	return loaded;
+}
+
+LoadedTexture TextureLoader::createTexture(const Image& image, const char* label, CommandEncoder encoder) {
+	TRACE_SCOPE("upload texture");
+	// sampled as sRGB either way, but storage textures (to write mips) can't have that format
+	TextureFormat viewFormat = TextureFormat::RGBA8UnormSrgb;
+	TextureDescriptor textureDesc = {};
+	textureDesc.label = label;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { image.width, image.height, 1 };
+	textureDesc.format = TextureFormat::RGBA8UnormSrgb;
+	textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::CopyDst;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	if (mipmaps) {
+		textureDesc.format = TextureFormat::RGBA8Unorm;
+		textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::CopyDst | TextureUsage::StorageBinding;
+		textureDesc.mipLevelCount = MipmapGenerator::mipLevelCount(image.width, image.height);
+		textureDesc.viewFormatCount = 1;
+		textureDesc.viewFormats = (WGPUTextureFormat*)&viewFormat;
+	}
+
+	LoadedTexture loaded;
+	loaded.texture = GpuMemory::createTexture(device, textureDesc, MemoryCategory::Texture);
+	if (!loaded.texture) return loaded;
+	TextureViewDescriptor viewDesc = {};
+	viewDesc.format = viewFormat;
+	viewDesc.dimension = TextureViewDimension::_2D;
+	viewDesc.baseMipLevel = 0;
+	viewDesc.mipLevelCount = textureDesc.mipLevelCount;
+	viewDesc.baseArrayLayer = 0;
+	viewDesc.arrayLayerCount = 1;
+	viewDesc.aspect = TextureAspect::All;
+	loaded.view = loaded.texture.createView(viewDesc);
+	loaded.width = image.width;
+	loaded.height = image.height;
+	loaded.format = textureDesc.format;
+	loaded.bytes = textureBytes(textureDesc);
+
+	ImageCopyTexture destination = {};
+	destination.texture = loaded.texture;
+	destination.mipLevel = 0;
+	destination.origin = { 0, 0, 0 };
+	destination.aspect = TextureAspect::All;
+	TextureDataLayout source = {};
+	source.offset = 0;
+	// writeTexture takes any stride, but the decoder already padded rows to what copies need
+	source.bytesPerRow = image.bytesPerRow;
+	source.rowsPerImage = image.height;
+	queue.writeTexture(destination, image.pixels.data(), image.pixels.size(), source, textureDesc.size);
+
+	// the write is on the queue before the submit of `encoder`, whenever that is
+	if (mipmaps && encoder) {
+		mipmaps->generate(encoder, loaded.texture, image.width, image.height, textureDesc.mipLevelCount, true);
+	}
+	return loaded;
+}
+
+bool TextureLoader::needsDecompression(const CompressedImage& image) const {
+	if (compressedBlockBytes(image.format) == 0) return false;
+	// WebGPU wants compressed textures in whole blocks, at least at level 0
+	return !supported.supports(image.format) || image.width % 4 != 0 || image.height % 4 != 0;
+}
+
+LoadedTexture TextureLoader::uploadCompressed(const CompressedImage& image, const char* label) {
+	if (!needsDecompression(image)) {
+		return createLevels(image, label);
+	}
+	Clock::time_point start = Clock::now();
+	CompressedImage decompressed;
+	if (!decompressImage(image, decompressed)) {
+		std::cerr << "No " << compressedFormatName(image.format) << " texture support on this device, and no CPU decoder for it" << std::endl;
+		++compression.failed;
+		return LoadedTexture();
+	}
+	compression.decompressMs += elapsedMs(start);
+	++compression.decompressed;
+	return createLevels(decompressed, label);
+}
+
+LoadedTexture TextureLoader::createLevels(const CompressedImage& image, const char* label) {
+	TRACE_SCOPE("upload compressed texture");
+	uint32_t blockBytes = compressedBlockBytes(image.format);
+	TextureDescriptor textureDesc = {};
+	textureDesc.label = label;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { image.width, image.height, 1 };
+	textureDesc.format = image.format;
+	textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::CopyDst;
+	textureDesc.mipLevelCount = static_cast<uint32_t>(image.levels.size());
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+
+	LoadedTexture loaded;
+	loaded.texture = GpuMemory::createTexture(device, textureDesc, MemoryCategory::Texture);
+	if (!loaded.texture) {
+		++compression.failed;
+		return loaded;
+	}
+	// the texture's own format is the one sampled, sRGB or not as the file says
+	loaded.view = wgpuTextureCreateView(loaded.texture, nullptr);
+	loaded.width = image.width;
+	loaded.height = image.height;
+	loaded.format = image.format;
+	loaded.bytes = textureBytes(textureDesc);
+
+	for (uint32_t level = 0; level < textureDesc.mipLevelCount; ++level) {
+		const CompressedImage::Level& info = image.levels[level];
+		ImageCopyTexture destination = {};
+		destination.texture = loaded.texture;
+		destination.mipLevel = level;
+		destination.origin = { 0, 0, 0 };
+		destination.aspect = TextureAspect::All;
+		TextureDataLayout source = {};
+		source.offset = 0;
+		source.bytesPerRow = info.bytesPerRow;
+		source.rowsPerImage = info.rows;
+		// copies of compressed levels cover whole blocks, even the 2x2 and 1x1 mips
+		Extent3D copySize;
+		copySize.width = blockBytes > 0 ? (info.width + 3) & ~3u : info.width;
+		copySize.height = blockBytes > 0 ? (info.height + 3) & ~3u : info.height;
+		copySize.depthOrArrayLayers = 1;
+		queue.writeTexture(destination, image.data.data() + info.offset, info.size, source, copySize);
+	}
+
+	if (blockBytes > 0) {
+		++compression.uploadedAsBlocks;
+	}
+	// the same chain in RGBA8, to see what compression saves
+	textureDesc.format = TextureFormat::RGBA8Unorm;
+	compression.gpuBytes += loaded.bytes;
+	compression.rgba8Bytes += textureBytes(textureDesc);
+	return loaded;
+}
+
+void TextureLoader::reportCompression(std::ostream& out) const {
+	if (compression.rgba8Bytes == 0 && compression.failed == 0) return;
+	auto mib = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+	out << "KTX2 textures: " << compression.uploadedAsBlocks << " uploaded as blocks, " << compression.decompressed
+		<< " decompressed on the CPU (" << compression.decompressMs << " ms)";
+	if (compression.failed > 0) {
+		out << ", " << compression.failed << " failed";
+	}
+	out << std::fixed << std::setprecision(2) << ", " << mib(compression.gpuBytes) << " MiB of VRAM instead of "
+		<< mib(compression.rgba8Bytes) << " MiB as RGBA8: " << mib(compression.savedBytes()) << " MiB saved"
+		<< std::defaultfloat << std::endl;
+}
+
+std::vector<LoadedTexture> TextureLoader::load(const std::vector<std::filesystem::path>& paths, ThreadPool& pool,
+	size_t maxThreads) {
+	TRACE_SCOPE("load textures");
+	stats = Stats();
+	Clock::time_point start = Clock::now();
+	std::vector<LoadedTexture> textures(paths.size());
+	std::vector<Image> images(paths.size());
+	std::vector<CompressedImage> compressed(paths.size());
+	std::vector<char> decoded(paths.size(), 0);
+	std::vector<char> decompressed(paths.size(), 0); // KTX2 blocks turned into RGBA8 on the CPU
+	std::atomic<uint64_t> decodeNs{ 0 };
+	std::atomic<uint64_t> decompressNs{ 0 };
+	std::atomic<uint32_t> decompressedCount{ 0 };
+
+	// decoded images waiting for the upload, in whatever order the workers finish them
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<size_t> toUpload;
+	auto decode = [&](size_t i) {
+		TRACE_SCOPE("decode image");
+		Clock::time_point decodeStart = Clock::now();
+		if (!isKtx2(paths[i])) {
+			decoded[i] = ResourceManager::loadImage(paths[i], images[i]) ? 1 : 0;
+		}
+		else if (ResourceManager::loadKtx2(paths[i], compressed[i])) {
+			decoded[i] = 1;
+			// decompressed here rather than on the uploading thread, when the device can't take the blocks
+			if (needsDecompression(compressed[i])) {
+				Clock::time_point decompressStart = Clock::now();
+				CompressedImage texels;
+				if (decompressImage(compressed[i], texels)) {
+					compressed[i] = std::move(texels);
+					decompressed[i] = 1;
+					++decompressedCount;
+				}
+				decompressNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - decompressStart).count();
+			}
+		}
+		decodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - decodeStart).count();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			toUpload.push_back(i);
+		}
+		ready.notify_one();
+	};
+
+	// the pool's workers decode while this thread uploads; without workers (emscripten) begin()
+	// decodes everything, then the loop below uploads
+	std::function<void(size_t)> task = decode;
+	pool.begin(paths.size(), task, maxThreads);
+
+	// the mips of the whole batch in one submit, after all the writes
+	CommandEncoder encoder = nullptr;
+	if (mipmaps) {
+		CommandEncoderDescriptor encoderDesc = {};
+		encoderDesc.label = "Texture mipmaps";
+		encoder = device.createCommandEncoder(encoderDesc);
+	}
+
+	for (size_t done = 0; done < paths.size(); ++done) {
+		size_t i;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			ready.wait(lock, [&] { return !toUpload.empty(); });
+			i = toUpload.front();
+			toUpload.pop_front();
+		}
+		if (!decoded[i]) {
+			std::cerr << "Could not load texture " << paths[i].string() << std::endl;
+			++stats.failed;
+			continue;
+		}
+		Clock::time_point uploadStart = Clock::now();
+		std::string label = paths[i].filename().string();
+		// still compressed if it had to be and couldn't: uploadCompressed reports it
+		textures[i] = isKtx2(paths[i]) ? uploadCompressed(compressed[i], label.c_str()) : createTexture(images[i], label.c_str(), encoder);
+		stats.uploadMs += elapsedMs(uploadStart);
+		if (textures[i].isValid()) {
+			++stats.loaded;
+			if (!isKtx2(paths[i])) {
+				stats.decodedBytes += 4ull * textures[i].width * textures[i].height;
+			}
+			else if (decompressed[i]) {
+				for (const CompressedImage::Level& level : compressed[i].levels) {
+					stats.decodedBytes += 4ull * level.width * level.height;
+				}
+			}
+			else {
+				// nothing decoded, the file's levels went up as they are
+				stats.storedBytes += compressed[i].data.size();
+			}
+		}
+		else {
+			++stats.failed;
+		}
+		// the queue copied it
+		images[i] = Image();
+		compressed[i] = CompressedImage();
+	}
+	// every task queued its image, this only picks up the workers
+	pool.wait();
+	if (encoder) {
+		CommandBufferDescriptor cmdBufferDescriptor = {};
+		CommandBuffer command = encoder.finish(cmdBufferDescriptor);
+		encoder.release();
+		queue.submit(1, &command);
+		command.release();
+	}
+
+	compression.decompressed += decompressedCount.load();
+	compression.decompressMs += decompressNs.load() / 1e6;
+	stats.decodeMs = decodeNs.load() / 1e6;
+	stats.wallMs = elapsedMs(start);
+	return textures;
+}
+
+void TextureLoader::release(LoadedTexture& texture) {
+	if (texture.view) texture.view.release();
+	if (texture.texture) {
+		GpuMemory::untrack(texture.texture);
+		texture.texture.destroy();
+		texture.texture.release();
+	}
+	texture = LoadedTexture();
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "BlockCompression.h"
+#include "ResourceManager.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+class MipmapGenerator;
+class ThreadPool;
+
+// A sampled texture and its sRGB view of every mip, owned by whoever loaded it (see TextureLoader::release)
+struct LoadedTexture {
+	wgpu::Texture texture = nullptr;
+	wgpu::TextureView view = nullptr;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	wgpu::TextureFormat format = wgpu::TextureFormat::Undefined; // of the texture, not the view
+	uint64_t bytes = 0; // on the GPU, see textureBytes
+
+	bool isValid() const { return texture != nullptr; }
+};
+
+/**
+ * Loads image files into sampled textures. Files are read and decoded on a ThreadPool while the
+ * calling thread creates the textures and writes the images decoded so far with
+ * queue.writeTexture, so decoding and uploading overlap. Decoded rows are already padded to 256
+ * bytes (see Image), nothing gets repacked on the way.
+ *
+ * Textures are RGBA8 with sRGB contents: color images are stored gamma encoded and sampled linear
+ * through an RGBA8UnormSrgb view. With a MipmapGenerator they get their full mip chain, generated
+ * on the GPU in the submit that follows the uploads; the texture itself is then RGBA8Unorm, as the
+ * generator writes it as a storage texture.
+ *
+ * KTX2 files (see ResourceManager::loadKtx2) bring their own mips. Their blocks are uploaded as
+ * they are when the device has the format, at 1/4 (BC3, ETC2 RGBA8, ASTC 4x4) to 1/8 (BC1, ETC2
+ * RGB8) of the memory and bandwidth of RGBA8. Otherwise BC1, BC3 and ETC2 get decompressed on the
+ * CPU and uploaded as RGBA8; BC7 and ASTC fail, they have no CPU decoder.
+ */
+class TextureLoader {
+public:
+	struct Stats {
+		uint32_t loaded = 0;
+		uint32_t failed = 0;
+		uint64_t decodedBytes = 0; // RGBA8, without the row padding: images, and KTX2 decompressed on the CPU
+		uint64_t storedBytes = 0; // KTX2 levels uploaded as stored in the file, blocks mostly
+		double decodeMs = 0.0; // summed over the threads
+		double uploadMs = 0.0;
+		double wallMs = 0.0;
+
+		// decode throughput, stored uploads don't count
+		double megabytesPerSecond() const { return wallMs > 0.0 ? decodedBytes / 1e6 / (wallMs / 1e3) : 0.0; }
+	};
+
+	// KTX2 textures since initialize
+	struct CompressionStats {
+		uint32_t uploadedAsBlocks = 0;
+		uint32_t decompressed = 0; // on the CPU, the device lacked the format
+		uint32_t failed = 0;
+		uint64_t gpuBytes = 0; // what they take
+		uint64_t rgba8Bytes = 0; // what they would take as RGBA8 with the same mips
+		double decompressMs = 0.0;
+
+		uint64_t savedBytes() const { return rgba8Bytes > gpuBytes ? rgba8Bytes - gpuBytes : 0; }
+	};
+
+	// Without `mipmaps`, textures have a single level. `compression`: the block compressed formats
+	// the device was created with.
+	void initialize(wgpu::Device device, wgpu::Queue queue, MipmapGenerator* mipmaps = nullptr,
+		TextureCompression compression = TextureCompression());
+
+	/**
+	 * Load every file of `paths`, in the same order. Failures are reported and give an invalid
+	 * texture. Files ending in .ktx2 go through uploadCompressed, decompressing on the pool when
+	 * needed. `pool` must not be running anything else meanwhile. Its workers decode, at most
+	 * `maxThreads` of them (0: all), while the calling thread uploads.
+	 */
+	std::vector<LoadedTexture> load(const std::vector<std::filesystem::path>& paths, ThreadPool& pool,
+		size_t maxThreads = 0);
+
+	// Create a texture for an image decoded elsewhere and upload it
+	LoadedTexture upload(const Image& image, const char* label);
+
+	// Create a texture for a KTX2 image and upload all its levels, decompressing them first if
+	// the device doesn't have the format
+	LoadedTexture uploadCompressed(const CompressedImage& image, const char* label);
+
+	// Whether the device can't take the blocks of `image` as they are
+	bool needsDecompression(const CompressedImage& image) const;
+
+	// Destroy `texture` right away: the GPU must be done with it (see LifetimeTracker otherwise)
+	static void release(LoadedTexture& texture);
+
+	// Of the last load()
+	const Stats& lastStats() const { return stats; }
+
+	const CompressionStats& compressionStats() const { return compression; }
+	// One line of VRAM saved by compressed textures, nothing if none was loaded
+	void reportCompression(std::ostream& out) const;
+
+private:
+	// create and write the texture, record its mips into `encoder` if there is a generator
+	LoadedTexture createTexture(const Image& image, const char* label, wgpu::CommandEncoder encoder);
+	// create and write a texture of the format of `image`, which the device must have
+	LoadedTexture createLevels(const CompressedImage& image, const char* label);
+
+	wgpu::Device device = nullptr;
+	wgpu::Queue queue = nullptr;
+	MipmapGenerator* mipmaps = nullptr;
+	TextureCompression supported;
+	Stats stats;
+	CompressionStats compression;
+};
@@ -0,0 +1,155 @@
+// TexturePool.cpp
+#include "TexturePool.h"
+#include "GpuMemory.h"
+#include "LifetimeTracker.h"
+
+#include <iomanip>
+
+using namespace wgpu;
+
+uint32_t textureFormatSize(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::R8Unorm:
+	case TextureFormat::Stencil8:
+		return 1;
+	case TextureFormat::RG8Unorm:
+	case TextureFormat::R16Float:
+	case TextureFormat::Depth16Unorm:
+		return 2;
+	case TextureFormat::RGBA16Float:
+	case TextureFormat::RG32Float:
+		return 8;
+	case TextureFormat::RGBA32Float:
+		return 16;
+	default:
+		// RGBA8 / BGRA8 in all flavours, R32Float, RG16Float, RGB10A2, Depth24Plus, Depth32Float...
+		return 4;
+	}
+}
+
+TexturePool::~TexturePool() {
+	terminate();
+}
+
+void TexturePool::initialize(Device gpuDevice, uint32_t idleFrames, LifetimeTracker* tracker) {
+	device = gpuDevice;
+	maxIdleFrames = idleFrames;
+	lifetimes = tracker;
+}
+
+void TexturePool::terminate() {
+	// the device is done by now, and the tracker may already be
+	lifetimes = nullptr;
+	while (!entries.empty()) {
+		evict(entries.size() - 1);
+	}
+}
+
+PooledTexture TexturePool::acquire(const TextureKey& key, const char* label) {
+	for (Entry& entry : entries) {
+		if (!entry.inUse && entry.key == key) {
+			entry.inUse = true;
+			entry.lastUsedFrame = frame;
+			++stats.hits;
+			return entry.texture;
+		}
+	}
+
+	TextureDescriptor textureDesc = {};
+	textureDesc.label = label ? label : "Pooled texture";
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { key.width, key.height, 1 };
+	textureDesc.format = key.format;
+	textureDesc.usage = key.usage;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = key.sampleCount;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+
+	Entry entry;
+	entry.key = key;
+	entry.texture.texture = GpuMemory::createTexture(device, textureDesc, MemoryCategory::RenderTarget);
+	entry.texture.view = wgpuTextureCreateView(entry.texture.texture, nullptr);
+	// the size GpuMemory tracks it with, so that budget eviction adds up
+	entry.bytes = textureBytes(textureDesc);
+	entry.inUse = true;
+	entry.lastUsedFrame = frame;
+	entries.push_back(entry);
+
+	++stats.allocations;
+	stats.residentBytes += entry.bytes;
+	++stats.residentTextures;
+	return entry.texture;
+}
+
+void TexturePool::release(const PooledTexture& texture) {
+	for (Entry& entry : entries) {
+		if (static_cast<WGPUTexture>(entry.texture.texture) == static_cast<WGPUTexture>(texture.texture)) {
+			entry.inUse = false;
+			entry.lastUsedFrame = frame;
+			return;
+		}
+	}
+}
+
+void TexturePool::endFrame() {
+	++frame;
+	for (size_t i = entries.size(); i-- > 0;) {
+		if (!entries[i].inUse && frame - entries[i].lastUsedFrame > maxIdleFrames) {
+			evict(i);
+		}
+	}
+}
+
+void TexturePool::onResize(uint32_t width, uint32_t height) {
+	for (size_t i = entries.size(); i-- > 0;) {
+		const Entry& entry = entries[i];
+		if (!entry.inUse && (entry.key.width != width || entry.key.height != height)) {
+			evict(i);
+		}
+	}
+}
+
+uint64_t TexturePool::trim(uint64_t bytes) {
+	uint64_t freed = 0;
+	while (freed < bytes) {
+		// the idle texture unused for the longest time goes first
+		size_t oldest = entries.size();
+		for (size_t i = 0; i < entries.size(); ++i) {
+			if (!entries[i].inUse && (oldest == entries.size() || entries[i].lastUsedFrame < entries[oldest].lastUsedFrame)) {
+				oldest = i;
+			}
+		}
+		if (oldest == entries.size()) break;
+		freed += entries[oldest].bytes;
+		++stats.trimmed;
+		evict(oldest);
+	}
+	return freed;
+}
+
+void TexturePool::evict(size_t index) {
+	Entry& entry = entries[index];
+	// an idle texture may still be used by commands recorded this frame and not submitted yet:
+	// out of the budget now, destroyed once they completed
+	entry.texture.view.release();
+	GpuMemory::untrack(entry.texture.texture);
+	if (lifetimes) {
+		lifetimes->release(entry.texture.texture);
+	}
+	else {
+		entry.texture.texture.destroy();
+		entry.texture.texture.release();
+	}
+	stats.residentBytes -= entry.bytes;
+	--stats.residentTextures;
+	++stats.evictions;
+	entries.erase(entries.begin() + index);
+}
+
+void TexturePool::report(std::ostream& out) const {
+	out << "Texture pool: " << stats.hits << " hit(s), " << stats.allocations << " allocation(s), "
+		<< stats.evictions << " eviction(s) (" << stats.trimmed << " over budget), " << stats.residentTextures << " resident texture(s) using "
+		<< std::fixed << std::setprecision(2) << stats.residentBytes / (1024.0 * 1024.0) << " MiB"
+		<< std::defaultfloat << std::endl;
+}
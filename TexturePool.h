@@ -0,0 +1,92 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class LifetimeTracker;
+
+// What makes two textures interchangeable
+struct TextureKey {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	wgpu::TextureFormat format = wgpu::TextureFormat::Undefined;
+	WGPUTextureUsageFlags usage = wgpu::TextureUsage::RenderAttachment;
+	uint32_t sampleCount = 1;
+
+	bool operator==(const TextureKey& other) const {
+		return width == other.width && height == other.height && format == other.format
+			&& usage == other.usage && sampleCount == other.sampleCount;
+	}
+};
+
+// A texture handed out by the pool, with a default view of it. Both stay owned by the pool.
+struct PooledTexture {
+	wgpu::Texture texture = nullptr;
+	wgpu::TextureView view = nullptr;
+};
+
+/**
+ * Recycles render targets (depth buffers, offscreen and MSAA targets...) instead of creating and
+ * destroying them whenever a pass or a resize asks for one.
+ *
+ * A released texture stays resident and goes to the next acquire with the same key. Textures that
+ * nobody acquired for `maxIdleFrames` frames are destroyed, and so are idle textures of another
+ * size than the surface when it gets reconfigured, since they are unlikely to be asked for again.
+ * Evicted textures leave the memory budget at once but are destroyed through the LifetimeTracker,
+ * once the commands recorded so far completed.
+ */
+class TexturePool {
+public:
+	struct Counters {
+		uint64_t hits = 0; // acquires served by a resident texture
+		uint64_t allocations = 0; // acquires that had to create one
+		uint64_t evictions = 0;
+		uint64_t trimmed = 0; // evictions asked for by the memory budget
+		uint64_t residentBytes = 0; // in use and idle
+		uint32_t residentTextures = 0;
+	};
+
+	~TexturePool();
+
+	// Without `lifetimes`, evicted textures are destroyed right away
+	void initialize(wgpu::Device device, uint32_t maxIdleFrames = 3, LifetimeTracker* lifetimes = nullptr);
+	void terminate();
+
+	PooledTexture acquire(const TextureKey& key, const char* label = nullptr);
+	// Give a texture back, it must not be used by commands recorded after this
+	void release(const PooledTexture& texture);
+
+	// Age idle textures and evict the ones unused for too long. Once per frame.
+	void endFrame();
+	// The target size changed: drop idle textures of any other size right away
+	void onResize(uint32_t width, uint32_t height);
+	// Over the memory budget: evict idle textures, least recently used first, until `bytes` are
+	// freed or none is idle. Returns the bytes freed.
+	uint64_t trim(uint64_t bytes);
+
+	const Counters& counters() const { return stats; }
+	void report(std::ostream& out) const;
+
+private:
+	struct Entry {
+		TextureKey key;
+		PooledTexture texture;
+		uint64_t bytes = 0;
+		bool inUse = false;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	void evict(size_t index);
+
+	wgpu::Device device = nullptr;
+	LifetimeTracker* lifetimes = nullptr;
+	uint32_t maxIdleFrames = 3;
+	uint64_t frame = 0;
+	std::vector<Entry> entries;
+	Counters stats;
+};
+
+// Rough size of one texel, for memory accounting. Unknown formats count as 4 bytes.
+uint32_t textureFormatSize(wgpu::TextureFormat format);
@@ -0,0 +1,113 @@
+// ThreadPool.cpp
+#include "ThreadPool.h"
+#include "Trace.h"
+
+ThreadPool::ThreadPool(size_t workerCount) {
+#ifndef __EMSCRIPTEN__
+	workers.reserve(workerCount);
+	for (size_t i = 0; i < workerCount; ++i) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+#else
+	(void)workerCount;
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeWorkers.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(size_t taskCount, const std::function<void(size_t)>& task, size_t maxThreads) {
+	if (taskCount == 1 || maxThreads == 1) {
+		// not worth waking anyone up
+		for (size_t i = 0; i < taskCount; ++i) {
+			task(i);
+		}
+		return;
+	}
+	begin(taskCount, task, maxThreads);
+	wait();
+}
+
+void ThreadPool::begin(size_t taskCount, const std::function<void(size_t)>& task, size_t maxThreads) {
+	if (taskCount == 0) {
+		return;
+	}
+	if (workers.empty()) {
+		for (size_t i = 0; i < taskCount; ++i) {
+			task(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &task;
+		jobSize = taskCount;
+		nextTask = 0;
+		finishedTasks = 0;
+		threadLimit = maxThreads == 0 ? threadCount() : maxThreads;
+		participants = 0;
+		++jobGeneration;
+	}
+	wakeWorkers.notify_all();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (job == nullptr) {
+		// begin() ran it all, or there was nothing to run
+		return;
+	}
+	// the caller is a worker too, if the job has room for one more
+	if (participants < threadLimit) {
+		++participants;
+		lock.unlock();
+		drain();
+		lock.lock();
+	}
+	jobDone.wait(lock, [this] { return finishedTasks == jobSize; });
+	job = nullptr;
+}
+
+void ThreadPool::drain() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (job != nullptr && nextTask < jobSize) {
+		size_t index = nextTask++;
+		const std::function<void(size_t)>& task = *job;
+		lock.unlock();
+		task(index);
+		lock.lock();
+		if (++finishedTasks == jobSize) {
+			jobDone.notify_all();
+		}
+	}
+}
+
+void ThreadPool::workerLoop() {
+	Trace::setThreadName("pool worker");
+	uint64_t seenGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeWorkers.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+			if (stopping) {
+				return;
+			}
+			seenGeneration = jobGeneration;
+			if (participants >= threadLimit) {
+				// the job has all the threads it may use, sit this one out
+				continue;
+			}
+			++participants;
+		}
+		drain();
+	}
+}
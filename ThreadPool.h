@@ -0,0 +1,60 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small persistent worker pool. Threads are spawned once and sleep between jobs, so handing work
+ * to them every frame only costs a wake-up. Without threads (emscripten, or a pool of size 0)
+ * everything runs inline on the calling thread.
+ */
+class ThreadPool {
+public:
+	// `workerCount` extra threads, the calling thread always takes part too
+	explicit ThreadPool(size_t workerCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Number of threads that take part in parallelFor, caller included
+	size_t threadCount() const { return workers.size() + 1; }
+
+	/**
+	 * Call `task(i)` for every i in [0, taskCount) spread over the pool, and return once all calls
+	 * are done. Tasks are handed out in order but may complete in any order. At most `maxThreads`
+	 * threads take part, caller included (0: all of them).
+	 */
+	void parallelFor(size_t taskCount, const std::function<void(size_t)>& task, size_t maxThreads = 0);
+
+	/**
+	 * parallelFor in two halves, for a caller with something else to do meanwhile: begin() hands
+	 * the job to the workers and returns, wait() helps with what is left (if `maxThreads` allows)
+	 * and returns once all calls are done. `task` must live until then. Without workers, begin()
+	 * runs every call itself.
+	 */
+	void begin(size_t taskCount, const std::function<void(size_t)>& task, size_t maxThreads = 0);
+	void wait();
+
+private:
+	void workerLoop();
+	// grab and run tasks of the current job until there are none left
+	void drain();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeWorkers;
+	std::condition_variable jobDone;
+	const std::function<void(size_t)>* job = nullptr;
+	size_t jobSize = 0;
+	size_t nextTask = 0;
+	size_t finishedTasks = 0;
+	size_t threadLimit = 0; // of the current job
+	size_t participants = 0; // threads that joined it so far
+	uint64_t jobGeneration = 0;
+	bool stopping = false;
+};
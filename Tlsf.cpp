@@ -0,0 +1,245 @@
+// Tlsf.cpp
+#include "Tlsf.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// index of the lowest set bit, `bits` is not 0
+uint32_t lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_ctzll(bits));
+#endif
+}
+
+// index of the highest set bit, `bits` is not 0
+uint32_t highestBit(uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, bits);
+	return static_cast<uint32_t>(index);
+#else
+	return 63u - static_cast<uint32_t>(__builtin_clzll(bits));
+#endif
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+Tlsf::Tlsf(uint64_t capacity) {
+	reset(capacity);
+}
+
+void Tlsf::reset(uint64_t capacity) {
+	totalSize = capacity / kGranularity * kGranularity;
+	// the first level index must fit the bins
+	assert(totalSize / kGranularity < (uint64_t(1) << (kFirstLevelCount + kSecondLevelLog2 - 1)));
+	usedSize = 0;
+	allocationCount = 0;
+	firstLevelBitmap = 0;
+	std::fill(std::begin(secondLevelBitmaps), std::end(secondLevelBitmaps), 0u);
+	for (auto& firstLevel : bins) {
+		std::fill(std::begin(firstLevel), std::end(firstLevel), kInvalid);
+	}
+	nodes.clear();
+	unusedNodes.clear();
+	if (totalSize == 0) return;
+
+	// one free block spanning everything
+	uint32_t node = newNode();
+	nodes[node].offset = 0;
+	nodes[node].size = totalSize;
+	insertFree(node);
+}
+
+void Tlsf::mappingInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) {
+	uint64_t units = size / kGranularity;
+	if (units < kSecondLevelCount) {
+		firstLevel = 0;
+		secondLevel = static_cast<uint32_t>(units);
+		return;
+	}
+	uint32_t top = highestBit(units);
+	firstLevel = top - kSecondLevelLog2 + 1;
+	secondLevel = static_cast<uint32_t>(units >> (top - kSecondLevelLog2)) - kSecondLevelCount;
+}
+
+void Tlsf::mappingSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) {
+	uint64_t units = size / kGranularity;
+	if (units >= kSecondLevelCount) {
+		// round up to the next bin boundary, so that any block of the bin found is large enough
+		uint32_t top = highestBit(units);
+		units += (uint64_t(1) << (top - kSecondLevelLog2)) - 1;
+	}
+	mappingInsert(units * kGranularity, firstLevel, secondLevel);
+}
+
+uint32_t Tlsf::findFreeBlock(uint64_t size) const {
+	uint32_t firstLevel, secondLevel;
+	mappingSearch(size, firstLevel, secondLevel);
+	if (firstLevel >= kFirstLevelCount) return kInvalid;
+
+	// a non empty bin of this first level, at or above the second level index...
+	uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if (secondLevelMap == 0) {
+		// ...or the smallest non empty bin of a larger first level
+		uint64_t firstLevelMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+		if (firstLevelMap == 0) return kInvalid;
+		firstLevel = lowestBit(firstLevelMap);
+		secondLevelMap = secondLevelBitmaps[firstLevel];
+	}
+	return bins[firstLevel][lowestBit(secondLevelMap)];
+}
+
+void Tlsf::insertFree(uint32_t node) {
+	Block& block = nodes[node];
+	uint32_t firstLevel, secondLevel;
+	mappingInsert(block.size, firstLevel, secondLevel);
+	uint32_t head = bins[firstLevel][secondLevel];
+	block.isFree = true;
+	block.prevFree = kInvalid;
+	block.nextFree = head;
+	if (head != kInvalid) nodes[head].prevFree = node;
+	bins[firstLevel][secondLevel] = node;
+	firstLevelBitmap |= uint64_t(1) << firstLevel;
+	secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void Tlsf::removeFree(uint32_t node) {
+	Block& block = nodes[node];
+	uint32_t firstLevel, secondLevel;
+	mappingInsert(block.size, firstLevel, secondLevel);
+	if (block.prevFree != kInvalid) nodes[block.prevFree].nextFree = block.nextFree;
+	if (block.nextFree != kInvalid) nodes[block.nextFree].prevFree = block.prevFree;
+	if (bins[firstLevel][secondLevel] == node) {
+		bins[firstLevel][secondLevel] = block.nextFree;
+		if (block.nextFree == kInvalid) {
+			secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (secondLevelBitmaps[firstLevel] == 0) {
+				firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+			}
+		}
+	}
+	block.isFree = false;
+	block.prevFree = kInvalid;
+	block.nextFree = kInvalid;
+}
+
+uint32_t Tlsf::newNode() {
+	if (!unusedNodes.empty()) {
+		uint32_t node = unusedNodes.back();
+		unusedNodes.pop_back();
+		nodes[node] = Block();
+		return node;
+	}
+	nodes.emplace_back();
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void Tlsf::releaseNode(uint32_t node) {
+	unusedNodes.push_back(node);
+}
+
+uint32_t Tlsf::split(uint32_t node, uint64_t size) {
+	uint32_t remainder = newNode(); // may grow `nodes`, take references after this
+	Block& block = nodes[node];
+	Block& rest = nodes[remainder];
+	rest.offset = block.offset + size;
+	rest.size = block.size - size;
+	rest.prevPhysical = node;
+	rest.nextPhysical = block.nextPhysical;
+	if (block.nextPhysical != kInvalid) nodes[block.nextPhysical].prevPhysical = remainder;
+	block.nextPhysical = remainder;
+	block.size = size;
+	insertFree(remainder);
+	return remainder;
+}
+
+void Tlsf::mergeNext(uint32_t node) {
+	Block& block = nodes[node];
+	uint32_t next = block.nextPhysical;
+	Block& absorbed = nodes[next];
+	block.size += absorbed.size;
+	block.nextPhysical = absorbed.nextPhysical;
+	if (absorbed.nextPhysical != kInvalid) nodes[absorbed.nextPhysical].prevPhysical = node;
+	releaseNode(next);
+}
+
+bool Tlsf::allocate(uint64_t size, uint64_t alignment, Allocation& allocation) {
+	size = alignUp(std::max<uint64_t>(size, 1), kGranularity);
+	alignment = std::max(alignment, kGranularity);
+	// block offsets are only granule aligned: leave room to move the start up to the alignment
+	uint64_t searchSize = size + (alignment - kGranularity);
+	uint32_t node = findFreeBlock(searchSize);
+	if (node == kInvalid) return false;
+	removeFree(node);
+
+	uint64_t padding = alignUp(nodes[node].offset, alignment) - nodes[node].offset;
+	if (padding > 0) {
+		// the front stays free, the allocation starts in the part cut off
+		uint32_t aligned = split(node, padding);
+		removeFree(aligned);
+		insertFree(node);
+		node = aligned;
+	}
+	if (nodes[node].size > size) {
+		// the rest goes back to the bins. Its physical successor was next to a free block, so it
+		// is in use: nothing to merge
+		split(node, size);
+	}
+
+	usedSize += nodes[node].size;
+	++allocationCount;
+	allocation.offset = nodes[node].offset;
+	allocation.size = nodes[node].size;
+	allocation.node = node;
+	return true;
+}
+
+void Tlsf::free(uint32_t node) {
+	assert(node < nodes.size() && !nodes[node].isFree);
+	usedSize -= nodes[node].size;
+	--allocationCount;
+
+	uint32_t next = nodes[node].nextPhysical;
+	if (next != kInvalid && nodes[next].isFree) {
+		removeFree(next);
+		mergeNext(node);
+	}
+	uint32_t prev = nodes[node].prevPhysical;
+	if (prev != kInvalid && nodes[prev].isFree) {
+		removeFree(prev);
+		mergeNext(prev);
+		node = prev;
+	}
+	insertFree(node);
+}
+
+Tlsf::Stats Tlsf::stats() const {
+	Stats stats;
+	stats.capacity = totalSize;
+	stats.usedBytes = usedSize;
+	stats.freeBytes = totalSize - usedSize;
+	stats.allocations = allocationCount;
+	for (uint32_t firstLevel = 0; firstLevel < kFirstLevelCount; ++firstLevel) {
+		for (uint32_t secondLevel = 0; secondLevel < kSecondLevelCount; ++secondLevel) {
+			for (uint32_t node = bins[firstLevel][secondLevel]; node != kInvalid; node = nodes[node].nextFree) {
+				++stats.freeBlocks;
+				stats.largestFreeBlock = std::max(stats.largestFreeBlock, nodes[node].size);
+			}
+		}
+	}
+	return stats;
+}
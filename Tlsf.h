@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/**
+ * Two-Level Segregated Fit allocator over an abstract range [0, capacity): it hands out offsets,
+ * the memory itself lives elsewhere (a GPU buffer, see GpuBufferAllocator).
+ *
+ * Free blocks are binned by size: the first level is the power of two, the second level splits
+ * each power of two into kSecondLevelCount linear ranges. Two bitmaps say which bins are not
+ * empty, so both allocate and free are O(1): a couple of bit scans, no search through lists.
+ * Freed blocks are merged with free neighbours right away.
+ *
+ * Block bookkeeping lives in a node array on the side, indices into it are the handles.
+ */
+class Tlsf {
+public:
+	static constexpr uint32_t kInvalid = UINT32_MAX;
+	// offsets and sizes are multiples of this
+	static constexpr uint64_t kGranularity = 16;
+
+	struct Allocation {
+		uint64_t offset = 0;
+		uint64_t size = 0; // rounded up to kGranularity
+		uint32_t node = kInvalid;
+	};
+
+	struct Stats {
+		uint64_t capacity = 0;
+		uint64_t usedBytes = 0;
+		uint64_t freeBytes = 0;
+		uint64_t largestFreeBlock = 0;
+		uint32_t allocations = 0;
+		uint32_t freeBlocks = 0;
+		// share of free memory not in the largest free block: 0 = all in one piece
+		double fragmentation() const {
+			return freeBytes == 0 ? 0.0 : 1.0 - static_cast<double>(largestFreeBlock) / static_cast<double>(freeBytes);
+		}
+	};
+
+	explicit Tlsf(uint64_t capacity = 0);
+
+	// Forget every allocation and manage [0, capacity) afresh
+	void reset(uint64_t capacity);
+
+	// `alignment` is a power of two. Returns false when no free block can hold it.
+	bool allocate(uint64_t size, uint64_t alignment, Allocation& allocation);
+	void free(uint32_t node);
+
+	uint64_t capacity() const { return totalSize; }
+	bool isEmpty() const { return allocationCount == 0; }
+	Stats stats() const;
+
+private:
+	static constexpr uint32_t kSecondLevelLog2 = 5;
+	static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelLog2;
+	// sizes below this all go to the first level 0, linearly
+	static constexpr uint64_t kSmallSize = kSecondLevelCount * kGranularity;
+	static constexpr uint32_t kFirstLevelCount = 48;
+
+	struct Block {
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t prevPhysical = kInvalid;
+		uint32_t nextPhysical = kInvalid;
+		uint32_t prevFree = kInvalid;
+		uint32_t nextFree = kInvalid;
+		bool isFree = false;
+	};
+
+	// bin holding blocks of `size`
+	static void mappingInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+	// first bin whose blocks are all at least `size`
+	static void mappingSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+
+	uint32_t findFreeBlock(uint64_t size) const;
+	void insertFree(uint32_t node);
+	void removeFree(uint32_t node);
+	uint32_t newNode();
+	void releaseNode(uint32_t node);
+	// cut `node` at `size`, the remainder becomes a new free block. Returns the remainder.
+	uint32_t split(uint32_t node, uint64_t size);
+	// absorb the physical successor of `node`, which must be free and out of its bin
+	void mergeNext(uint32_t node);
+
+	uint64_t totalSize = 0;
+	uint64_t usedSize = 0;
+	uint32_t allocationCount = 0;
+	uint64_t firstLevelBitmap = 0;
+	uint32_t secondLevelBitmaps[kFirstLevelCount] = {};
+	uint32_t bins[kFirstLevelCount][kSecondLevelCount];
+	std::vector<Block> nodes;
+	std::vector<uint32_t> unusedNodes;
+};
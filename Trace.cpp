@@ -0,0 +1,130 @@
+// Trace.cpp
+#include "Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::enabledFlag{ false };
+
+namespace {
+
+struct Event {
+	const char* name;
+	int64_t beginNs; // since traceEpoch
+	int64_t durationNs;
+};
+
+// Fixed size ring, written by its owner thread only. The exporter reads `head` with acquire
+// ordering and the last kCapacity events before it; older events get overwritten.
+constexpr uint64_t kExportMargin = 256;
+
+struct ThreadBuffer {
+	static constexpr size_t kCapacity = 1 << 16;
+	std::array<Event, kCapacity> events;
+	std::atomic<uint64_t> head{ 0 };
+	uint32_t threadId = 0;
+	std::string threadName;
+};
+
+const Trace::Clock::time_point traceEpoch = Trace::Clock::now();
+
+// Buffers are registered once per thread and never freed, so a thread exiting before the export
+// does not lose its events
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+// set by setThreadName, possibly before the thread records anything
+thread_local std::string threadName;
+
+// The calling thread's ring, registered on its first event
+ThreadBuffer& localBuffer() {
+	if (threadBuffer == nullptr) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		registry.push_back(std::make_unique<ThreadBuffer>());
+		threadBuffer = registry.back().get();
+		threadBuffer->threadId = static_cast<uint32_t>(registry.size());
+		threadBuffer->threadName = threadName;
+	}
+	return *threadBuffer;
+}
+
+// minimal JSON string escaping, zone names are plain identifiers in practice
+void writeJsonString(std::ostream& out, const std::string& text) {
+	out << '"';
+	for (char c : text) {
+		if (c == '"' || c == '\\') out << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+		else out << c;
+	}
+	out << '"';
+}
+
+} // namespace
+
+void Trace::record(const char* name, Clock::time_point begin, Clock::time_point end) {
+	ThreadBuffer& buffer = localBuffer();
+	uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	Event& event = buffer.events[head % ThreadBuffer::kCapacity];
+	event.name = name;
+	event.beginNs = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - traceEpoch).count();
+	event.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const char* name) {
+	// a thread that never records, e.g. with tracing disabled, must not get a ring for its name:
+	// rings are never freed
+	threadName = name;
+	if (threadBuffer != nullptr) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threadBuffer->threadName = name;
+	}
+}
+
+bool Trace::exportChromeJson(const std::string& path) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	bool first = true;
+	auto separator = [&]() {
+		if (!first) file << ",\n";
+		first = false;
+	};
+
+	for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+		if (!buffer->threadName.empty()) {
+			separator();
+			file << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << buffer->threadId
+				<< ", \"args\": {\"name\": ";
+			writeJsonString(file, buffer->threadName);
+			file << "}}";
+		}
+
+		// leave a margin at the old end of a full ring, the owner may be overwriting it right now
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t count = std::min<uint64_t>(head, ThreadBuffer::kCapacity - kExportMargin);
+		for (uint64_t i = head - count; i < head; ++i) {
+			const Event& event = buffer->events[i % ThreadBuffer::kCapacity];
+			separator();
+			// complete events ("X"), timestamps in microseconds
+			file << "{\"ph\": \"X\", \"name\": ";
+			writeJsonString(file, event.name);
+			file << ", \"pid\": 1, \"tid\": " << buffer->threadId
+				<< ", \"ts\": " << static_cast<double>(event.beginNs) * 1e-3
+				<< ", \"dur\": " << static_cast<double>(event.durationNs) * 1e-3 << "}";
+		}
+	}
+	file << "\n]}\n";
+	return file.good();
+}
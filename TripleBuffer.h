@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free single producer / single consumer triple buffer.
+ *
+ * The writer always owns one slot, the reader owns another, and the third one sits in the middle.
+ * Publishing swaps the writer's slot with the middle one, reading swaps the middle one with the
+ * reader's slot, so neither side ever waits and the reader always sees the newest complete value.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+	// Writer side: slot to fill before calling publish(). Only touched by the writer thread.
+	T& writeBuffer() {
+		return buffers[writeIndex];
+	}
+
+	// Writer side: hand the filled slot over to the reader
+	void publish() {
+		uint8_t previous = middle.exchange(writeIndex | dirtyBit, std::memory_order_acq_rel);
+		writeIndex = previous & indexMask;
+	}
+
+	// Reader side: pick up the newest published slot if there is one, return true if it changed
+	bool update() {
+		if ((middle.load(std::memory_order_relaxed) & dirtyBit) == 0) {
+			return false;
+		}
+		uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & indexMask;
+		return true;
+	}
+
+	// Reader side: last value picked up by update(). Only touched by the reader thread.
+	const T& read() const {
+		return buffers[readIndex];
+	}
+
+private:
+	static constexpr uint8_t indexMask = 0x3;
+	static constexpr uint8_t dirtyBit = 0x4; // middle slot holds something the reader has not seen yet
+
+	std::array<T, 3> buffers{};
+	uint8_t writeIndex = 0;
+	uint8_t readIndex = 1;
+	std::atomic<uint8_t> middle{ 2 };
+};
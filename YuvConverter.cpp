@@ -0,0 +1,200 @@
+// YuvConverter.cpp
+#include "YuvConverter.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "ResourceManager.h"
+
+#include <iostream>
+
+using namespace wgpu;
+
+bool YuvConverter::initialize(Device gpuDevice, uint32_t sourceWidth, uint32_t sourceHeight, YuvFormat format, bool srgbSource) {
+	device = gpuDevice;
+	width = sourceWidth;
+	height = sourceHeight;
+	paddedWidth = padWidth(width);
+	paddedHeight = padHeight(height);
+
+	ShaderModule shaderModule = ResourceManager::loadShaderModule(RESOURCE_DIR "/rgb_to_yuv.wgsl", device);
+	if (shaderModule == nullptr) {
+		std::cerr << "Could not load YUV conversion shader" << std::endl;
+		return false;
+	}
+
+	// source texture, output planes, parameters
+	std::vector<BindGroupLayoutEntry> bindingLayouts(3, Default);
+	bindingLayouts[0].binding = 0;
+	bindingLayouts[0].visibility = ShaderStage::Compute;
+	bindingLayouts[0].texture.sampleType = TextureSampleType::Float;
+	bindingLayouts[0].texture.viewDimension = TextureViewDimension::_2D;
+	bindingLayouts[1].binding = 1;
+	bindingLayouts[1].visibility = ShaderStage::Compute;
+	bindingLayouts[1].buffer.type = BufferBindingType::Storage;
+	bindingLayouts[1].buffer.minBindingSize = outputSize();
+	bindingLayouts[2].binding = 2;
+	bindingLayouts[2].visibility = ShaderStage::Compute;
+	bindingLayouts[2].buffer.type = BufferBindingType::Uniform;
+	bindingLayouts[2].buffer.minBindingSize = sizeof(Params);
+
+	BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+	bindGroupLayoutDesc.entryCount = static_cast<uint32_t>(bindingLayouts.size());
+	bindGroupLayoutDesc.entries = bindingLayouts.data();
+	bindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
+
+	PipelineLayoutDescriptor layoutDesc{};
+	layoutDesc.bindGroupLayoutCount = 1;
+	layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
+	layout = device.createPipelineLayout(layoutDesc);
+
+	ComputePipelineDescriptor pipelineDesc{};
+	pipelineDesc.label = "RGB to YUV";
+	pipelineDesc.layout = layout;
+	pipelineDesc.compute.module = shaderModule;
+	pipelineDesc.compute.entryPoint = "cs_main";
+	pipelineDesc.compute.constantCount = 0;
+	pipelineDesc.compute.constants = nullptr;
+	pipeline = device.createComputePipeline(pipelineDesc);
+	shaderModule.release();
+
+	BufferDescriptor bufferDesc = {};
+	bufferDesc.label = "YUV planes";
+	bufferDesc.size = outputSize();
+	bufferDesc.usage = BufferUsage::Storage | BufferUsage::CopySrc;
+	bufferDesc.mappedAtCreation = false;
+	output = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Other);
+
+	bufferDesc.label = "YUV parameters";
+	bufferDesc.size = sizeof(Params);
+	bufferDesc.usage = BufferUsage::Uniform | BufferUsage::CopyDst;
+	paramsBuffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Uniform);
+
+	Params params = {};
+	params.width = width;
+	params.height = height;
+	params.paddedWidth = paddedWidth;
+	params.paddedHeight = paddedHeight;
+	params.format = format == YuvFormat::NV12 ? 0 : 1;
+	params.srgbEncode = srgbSource ? 1 : 0;
+	device.getQueue().writeBuffer(paramsBuffer, 0, &params, sizeof(Params));
+	return true;
+}
+
+void YuvConverter::terminate() {
+	if (bindGroup) bindGroup.release();
+	if (paramsBuffer) {
+		GpuMemory::untrack(paramsBuffer);
+		paramsBuffer.release();
+	}
+	if (output) {
+		GpuMemory::untrack(output);
+		output.release();
+	}
+	if (pipeline) pipeline.release();
+	if (layout) layout.release();
+	if (bindGroupLayout) bindGroupLayout.release();
+	bindGroup = nullptr;
+	boundView = nullptr;
+}
+
+void YuvConverter::encode(CommandEncoder encoder, TextureView source, GpuProfiler& profiler) {
+	if (bindGroup == nullptr || boundView != source) {
+		if (bindGroup) bindGroup.release();
+		std::vector<BindGroupEntry> bindings(3);
+		bindings[0].binding = 0;
+		bindings[0].textureView = source;
+		bindings[1].binding = 1;
+		bindings[1].buffer = output;
+		bindings[1].offset = 0;
+		bindings[1].size = outputSize();
+		bindings[2].binding = 2;
+		bindings[2].buffer = paramsBuffer;
+		bindings[2].offset = 0;
+		bindings[2].size = sizeof(Params);
+
+		BindGroupDescriptor bindGroupDesc{};
+		bindGroupDesc.layout = bindGroupLayout;
+		bindGroupDesc.entryCount = static_cast<uint32_t>(bindings.size());
+		bindGroupDesc.entries = bindings.data();
+		bindGroup = device.createBindGroup(bindGroupDesc);
+		boundView = source;
+	}
+
+	ComputePassDescriptor passDesc = {};
+	passDesc.label = "RGB to YUV";
+	passDesc.timestampWrites = profiler.computePass("rgb to yuv");
+	ComputePassEncoder pass = encoder.beginComputePass(passDesc);
+	pass.setPipeline(pipeline);
+	pass.setBindGroup(0, bindGroup, 0, nullptr);
+	// one invocation per 8x2 block, 8x8 invocations per workgroup
+	uint32_t blocksX = paddedWidth / 8;
+	uint32_t blocksY = paddedHeight / 2;
+	pass.dispatchWorkgroups((blocksX + 7) / 8, (blocksY + 7) / 8, 1);
+	pass.end();
+	pass.release();
+}
+
+YuvWriter::~YuvWriter() {
+	close();
+}
+
+bool YuvWriter::open(const std::string& path, YuvFormat yuvFormat, uint32_t frameWidth, uint32_t frameHeight, uint32_t fps) {
+	format = yuvFormat;
+	width = frameWidth;
+	height = frameHeight;
+	// y4m has no NV12 colorspace, semi-planar output is always raw
+	y4m = format == YuvFormat::I420 && path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+
+	file = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	if (y4m) {
+		std::fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+	}
+	return true;
+}
+
+void YuvWriter::close() {
+	if (file != nullptr && file != stdout) {
+		std::fclose(file);
+	}
+	else if (file == stdout) {
+		std::fflush(stdout);
+	}
+	file = nullptr;
+}
+
+void YuvWriter::write(const ReadbackFrame& frame) {
+	if (file == nullptr) {
+		return;
+	}
+	uint32_t paddedWidth = YuvConverter::padWidth(width);
+	uint32_t paddedHeight = YuvConverter::padHeight(height);
+	uint32_t chromaWidth = (width + 1) / 2;
+	uint32_t chromaHeight = (height + 1) / 2;
+	const uint8_t* luma = frame.data;
+	const uint8_t* chroma = luma + static_cast<size_t>(paddedWidth) * paddedHeight;
+
+	if (y4m) {
+		std::fputs("FRAME\n", file);
+	}
+	// rows one by one to drop the padding
+	for (uint32_t y = 0; y < height; ++y) {
+		std::fwrite(luma + static_cast<size_t>(y) * paddedWidth, 1, width, file);
+	}
+	if (format == YuvFormat::NV12) {
+		for (uint32_t y = 0; y < chromaHeight; ++y) {
+			std::fwrite(chroma + static_cast<size_t>(y) * paddedWidth, 1, 2 * chromaWidth, file);
+		}
+	}
+	else {
+		uint32_t chromaStride = paddedWidth / 2;
+		const uint8_t* v = chroma + static_cast<size_t>(chromaStride) * (paddedHeight / 2);
+		for (uint32_t y = 0; y < chromaHeight; ++y) {
+			std::fwrite(chroma + static_cast<size_t>(y) * chromaStride, 1, chromaWidth, file);
+		}
+		for (uint32_t y = 0; y < chromaHeight; ++y) {
+			std::fwrite(v + static_cast<size_t>(y) * chromaStride, 1, chromaWidth, file);
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "ReadbackRing.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <cstdio>
+#include <string>
+
+class GpuProfiler;
+
+enum class YuvFormat {
+	NV12, // luma plane + one interleaved UV plane
+	I420, // luma plane + U plane + V plane
+};
+
+/**
+ * Converts a color texture to 4:2:0 YUV with a compute pass, into a storage buffer ready to be
+ * read back. Planes are stored with the width padded to 8 and the height to 2, see
+ * resources/rgb_to_yuv.wgsl; YuvWriter strips the padding.
+ */
+class YuvConverter {
+public:
+	// `srgbSource` when the source is sampled through an sRGB view (values come out linear)
+	bool initialize(wgpu::Device device, uint32_t width, uint32_t height, YuvFormat format, bool srgbSource);
+	void terminate();
+
+	// Record the conversion of `source` (same size as given to initialize)
+	void encode(wgpu::CommandEncoder encoder, wgpu::TextureView source, GpuProfiler& profiler);
+
+	wgpu::Buffer outputBuffer() const { return output; }
+	uint64_t outputSize() const { return static_cast<uint64_t>(paddedWidth) * paddedHeight * 3 / 2; }
+
+	static uint32_t padWidth(uint32_t width) { return (width + 7) & ~7u; }
+	static uint32_t padHeight(uint32_t height) { return (height + 1) & ~1u; }
+
+private:
+	struct Params {
+		uint32_t width;
+		uint32_t height;
+		uint32_t paddedWidth;
+		uint32_t paddedHeight;
+		uint32_t format;
+		uint32_t srgbEncode;
+		uint32_t _pad[2];
+	};
+	static_assert(sizeof(Params) % 16 == 0);
+
+	wgpu::Device device = nullptr;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t paddedWidth = 0;
+	uint32_t paddedHeight = 0;
+	wgpu::ComputePipeline pipeline = nullptr;
+	wgpu::BindGroupLayout bindGroupLayout = nullptr;
+	wgpu::PipelineLayout layout = nullptr;
+	wgpu::Buffer output = nullptr;
+	wgpu::Buffer paramsBuffer = nullptr;
+	// the bind group depends on the source view, cached for the last one seen
+	wgpu::BindGroup bindGroup = nullptr;
+	WGPUTextureView boundView = nullptr;
+};
+
+/**
+ * Writes converted frames as they come out of the readback ring, either as a .y4m stream (I420
+ * only, playable by ffmpeg/mpv) or as raw planes, to a file, a named pipe, or stdout ("-").
+ */
+class YuvWriter {
+public:
+	~YuvWriter();
+
+	bool open(const std::string& path, YuvFormat format, uint32_t width, uint32_t height, uint32_t fps);
+	void close();
+	// `frame.data` holds the padded planes produced by YuvConverter
+	void write(const ReadbackFrame& frame);
+
+private:
+	FILE* file = nullptr;
+	bool y4m = false;
+	YuvFormat format = YuvFormat::I420;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
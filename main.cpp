@@ -5,6 +5,26 @@
 #include <GLFW/glfw3.h>
 #include <glfw3webgpu.h>
 #include "ResourceManager.h"
+#include "Simulation.h"
+#include "ThreadPool.h"
+#include "ParallelEncoder.h"
+#include "DrawQueue.h"
+#include "Options.h"
+#include "GpuProfiler.h"
+#include "Trace.h"
+#include "FrameBenchmark.h"
+#include "StartupProfiler.h"
+#include "ReadbackRing.h"
+#include "YuvConverter.h"
+#include "SharedFrameRing.h"
+#include "FrameGraph.h"
+#include "GpuBufferAllocator.h"
+#include "GpuMemory.h"
+#include "StagingBelt.h"
+#include "TextureLoader.h"
+#include "MipmapGenerator.h"
+#include "LifetimeTracker.h"
+#include "DynamicResolution.h"
 
 #ifdef __EMSCRIPTEN__
 #  include <emscripten.h>
@@ -14,6 +34,19 @@
 #include <cassert>
 #include <vector>
 #include <array>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <ctime>
+#include <cstring>
+#include <future>
+#include <string>
 
 // no need to add wgpu prefix in front of everything
 using namespace wgpu;
@@ -26,10 +59,25 @@ uint32_t ceilToNextMultiple(uint32_t value, uint32_t step) {
     return step * divide_and_ceil;
 }
 
+// how long the framebuffer size must stay put before the surface gets reconfigured
+constexpr double kResizeDebounceSeconds = 0.1;
+
+// depth of the two draws of the scene. The second one used to be drawn last and cover the first,
+// so it is the closest one
+constexpr float kDrawDepths[2] = { 0.5f, 0.25f };
+
 class Application {
     public:
-        // Initialize everything, return success
-        bool Initialize();
+        // Open the window and request the adapter, return success. The device and everything that
+        // needs it come later, see TickInitialization
+        bool Initialize(const Options& options);
+
+        // Advance the startup once the adapter / device requests it waits for have been answered,
+        // returns true once everything is ready to render. MainLoop calls it until then.
+        bool TickInitialization();
+        // natively, block until TickInitialization is done, returns false if it failed
+        bool WaitUntilReady();
+        bool HasFailed() const { return initState == InitState::Failed; }
 
         // Unitialize everything
         void Terminate();
@@ -40,6 +88,32 @@ class Application {
         // Reeturn true while loop should keep running
         bool IsRunning();
 
+        // Time the recording of `drawCount` draws with 1..N encoding threads and print the results
+        void ReportEncodingScaling(uint32_t drawCount);
+
+        // Time radix sorting `packetCount` random draw packets against std::sort and print the results
+        void ReportSortCost(uint32_t packetCount);
+
+        // Time `allocationCount` mesh sized buffer allocations with one createBuffer each against the
+        // sub-allocator, then churn the sub-allocator and print its fragmentation
+        void ReportAllocatorCost(uint32_t allocationCount);
+
+        // Time `uploadCount` uploads of a few sizes through writeBuffer, the staging belt and
+        // mappedAtCreation, until the GPU is done with them, and print the results
+        void ReportStagingCost(uint32_t uploadCount);
+
+        // Time loading `textureCount` generated image files with 1..N decode threads and print
+        // the throughput
+        void ReportTextureLoading(uint32_t textureCount);
+
+        // Time mip chain generation of a `size` x `size` texture and of an odd sized one, with the
+        // compute generator and with one render pass per level, and check their smallest level
+        void ReportMipmapCost(uint32_t size);
+
+        // Write a `size` x `size` test image with its mips as RGBA8, BC1 and BC3 KTX2 files, load
+        // them and print what each takes on the GPU
+        void ReportTextureCompression(uint32_t size);
+
     private: 
         // internal structs
         /** same structure as in wgsl shader */
@@ -48,45 +122,291 @@ class Application {
             std::array<float, 4> color;
             // offset = 16 = 4 * sizeof(f32) -> OK
             float time;
-            float _pad[3];
+            // width / height of the target surface, updated whenever the surface is reconfigured
+            float ratio;
+            // depth of the draw, front to back sorting and the depth test both use it
+            float depth;
+            float _pad[1];
         };
         static_assert(sizeof(MyUniforms) % 16 == 0);
 
     private:
-        // retrieves next target texture view
+        // startup steps, see Initialize
+        enum class InitState {
+            RequestingAdapter,
+            RequestingDevice,
+            Ready,
+            Failed,
+        };
+        // read the geometry and shader source, needs no device
+        bool LoadAssets();
+        void RequestDevice();
+        // everything that needs the device: pipelines, buffers, surface, encoders...
+        bool FinishInitialization();
+        // first frame is out: print the startup phases, write them with --startup-out
+        void ReportStartup();
+
+        // view to render the next frame into: offscreen target when headless, surface otherwise
+        TextureView GetNextTargetView();
+        // retrieves next target texture view, reconfiguring the surface if it went out of date
         TextureView GetNextSurfaceTextureView();
 
+        // (re)configure the surface for a given framebuffer size, without touching pipelines or buffers
+        void ConfigureSurface(uint32_t width, uint32_t height, bool force = false);
+        // reconfigure once the framebuffer size stopped changing for long enough
+        void ApplyPendingResize();
+        static void OnFramebufferResize(GLFWwindow* window, int width, int height);
+        static void OnWindowRefresh(GLFWwindow* window);
+
+        // on demand rendering: whether this frame has to be drawn, firing the timers that are due
+        bool WantsFrame();
+        // something visible changed, draw at the next opportunity
+        void RequestRedraw() { frameDirty = true; }
+        // draw again in `delaySeconds`, waking the loop up if it is waiting for events
+        void ScheduleRedraw(double delaySeconds);
+        // block in glfwWaitEvents until an event arrives or the next timer is due
+        void WaitForEvents();
+        // start or stop the simulation, and the continuous redraw that goes with it
+        void SetAnimating(bool animate);
+        // one frame of MainLoop, without the benchmark bookkeeping around it
+        void RenderFrame();
+        // wait for the benchmark's outstanding GPU work and write its report
+        void WriteBenchmarkReport();
+        // write width / height into both uniform slots
+        void UpdateAspectRatio(uint32_t width, uint32_t height);
+
+        // headless mode: offscreen color target plus the readback ring frames are copied into
+        void InitializeOffscreenTarget(uint32_t width, uint32_t height);
+        // whether frames are read back this run (headless, unless benchmarking without --capture / --shm)
+        bool IsCapturing() const {
+            return options.headless
+                && (!benchmark || options.capture != CaptureFormat::None || !options.sharedMemory.empty());
+        }
+        // what is read back, PNG frames unless asked otherwise
+        CaptureFormat GetCaptureFormat() const {
+            return options.capture == CaptureFormat::None ? CaptureFormat::Rgba : options.capture;
+        }
+        // --shm: create the shared memory ring, `frameSize` bytes per slot. Exits on failure
+        void OpenSharedFrames(uint64_t frameSize);
+        // readback consumer, runs on the ring's thread
+        void SaveFrame(const ReadbackFrame& frame) const;
+        // --overdraw: print how many fragments were shaded per covered pixel of a heatmap frame
+        void ReportOverdraw(const ReadbackFrame& frame) const;
+        // process pending callbacks (map, work done...), blocking until there is progress if `wait`
+        void PollDevice(bool wait);
+        // block until everything submitted so far completed, for measurements
+        void WaitForQueue();
+        static void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+        // the pipelines the scene is drawn with
+        enum class ScenePass {
+            Color, // shades the scene, depth tested as options.depth says
+            DepthPrepass, // position only, writes depth for the Equal test of the color pass
+        };
+
         // Substeps of Initialize to create render pipeline
         void InitializePipeline();
+        RenderPipeline CreateScenePipeline(ShaderModule shaderModule, ScenePass pass);
         RequiredLimits GetRequiredLimits(Adapter adapter);
         void InitializeBuffers();
+        void InitializeTextures();
         void InitializeBindGroups();
+
+        // fill the frame's draw list, sorted for the fewest state changes
+        void RecordDraws(std::vector<DrawCommand>& drawList);
+        // record the whole frame into `targetView`
+        CommandBuffer EncodeFrame(TextureView targetView);
+        // declare the frame's passes for a `width` x `height` target and compile them
+        void BuildFrameGraph(uint32_t width, uint32_t height);
+        // the "scene" pass: clear `targetView` and replay frameBundles into it, depth tested
+        // against `depthView` unless depth is off
+        void EncodeScenePass(CommandEncoder encoder, TextureView targetView, TextureView depthView);
+        // the "depth prepass": lay down the opaque draws' depth into `depthView`
+        void EncodeDepthPrepass(CommandEncoder encoder, TextureView depthView);
+        // --dynamic-res: restrict a scene pass to the part of its target the current scale covers
+        void SetSceneViewport(RenderPassEncoder renderPass);
+        // --dynamic-res: feed the last frame time to the controller, log scale changes
+        void UpdateResolution();
     
     private:
         // shared vars between init and main loop
-        GLFWwindow *window;
+        Options options;
+        GLFWwindow *window = nullptr;
+        // startup state, the instance and adapter only live until the device is there
+        InitState initState = InitState::RequestingAdapter;
+        Instance instance = nullptr;
+        Adapter adapter = nullptr;
+        std::unique_ptr<RequestAdapterCallback> adapterRequest;
+        std::unique_ptr<RequestDeviceCallback> deviceRequest;
+        bool adapterAnswered = false;
+        bool deviceAnswered = false;
+        bool timestampsSupported = false;
+        TextureCompression textureCompression; // block compressed formats requested on the device
+        // files read while the adapter and device are requested, consumed by the Initialize* steps
+        std::future<bool> assetLoad;
+        bool assetsLoaded = false;
+        std::vector<float> pointData;
+        std::vector<uint16_t> indexData;
+        std::string shaderSource;
+        Image sceneImage; // decoded --texture, empty without one
+        CompressedImage sceneCompressed; // --texture when it is a KTX2 file
         Device device = nullptr;
         Queue queue = nullptr;
         Surface surface = nullptr; // connects device to window
         TextureFormat surfaceFormat = TextureFormat::Undefined;
+        SurfaceConfiguration surfaceConfig = {}; // kept around so that resizing only changes width/height
+        TextureViewDescriptor surfaceViewDesc = {}; // rebuilt on configure, reused for every frame's view
+        // resize bookkeeping -- framebuffer callbacks only record the request, MainLoop applies it
+        bool resizePending = false;
+        bool resizeForced = false; // reconfigure even if the size is the same
+        uint32_t pendingWidth = 0;
+        uint32_t pendingHeight = 0;
+        double lastResizeEventTime = 0.0;
+        // configured size the surface was last reported suboptimal at, reconfigured once for it
+        uint32_t suboptimalWidth = 0;
+        uint32_t suboptimalHeight = 0;
+        // on demand rendering state, see WantsFrame
+        bool frameDirty = true;
+        bool animating = true;
+        std::vector<double> redrawTimers; // glfwGetTime deadlines
+        // utilization summary printed on exit
+        uint64_t framesRendered = 0;
+        uint64_t idleWaits = 0;
+        std::chrono::steady_clock::time_point startTime;
+        std::clock_t startCpuTime = 0;
+        // fixed timestep update, runs on its own thread and hands over snapshots to the render loop
+        Simulation simulation;
         std::unique_ptr<ErrorCallback> uncapturedErrorCallbackHandle; 
         RenderPipeline pipeline = nullptr;
+        RenderPipeline depthPrepassPipeline = nullptr; // only with --depth prepass
+        TextureFormat depthFormat = TextureFormat::Depth24Plus;
         uint32_t indexCount;
-        Buffer pointBuffer = nullptr;
-        Buffer indexBuffer = nullptr;
-        Buffer uniformBuffer = nullptr;
+        // geometry and uniforms live in shared blocks, bound at these offsets
+        GpuBufferAllocator bufferAllocator;
+        BufferAllocation pointAllocation;
+        BufferAllocation indexAllocation;
+        BufferAllocation uniformAllocation;
+        // frees what the GPU may still use once its last submit completed
+        LifetimeTracker lifetimes;
+        // uploads through mapped chunks we recycle, written between the frame's encode and submit
+        StagingBelt stagingBelt;
+        MipmapGenerator mipmaps;
+        TextureLoader textureLoader;
+        LoadedTexture sceneTexture;
+        Sampler sceneSampler = nullptr;
+        // what gives memory back when over the budget, see GpuMemory::addEvictionCallback
+        std::vector<uint32_t> memoryEvictors;
         PipelineLayout layout = nullptr;
         BindGroupLayout bindGroupLayout = nullptr;
         BindGroup bindGroup = nullptr;
         uint32_t uniformStride; // Required offset for dynamic uniform buffers
+        uint32_t uniformAlignment = 256; // minUniformBufferOffsetAlignment, a power of two
+        std::vector<WGPUFeatureName> requiredFeatures; // must outlive the device request
+        // draws are recorded into render bundles on these threads
+        std::unique_ptr<ThreadPool> threadPool;
+        std::unique_ptr<ParallelEncoder> parallelEncoder;
+        std::vector<DrawCommand> draws; // reused every frame to avoid reallocating
+        DrawQueue drawQueue; // sort keys of the frame's draws
+        std::vector<RenderBundle> frameBundles; // this frame's recorded draws, replayed by the scene pass
+        // same draws with the prepass pipeline, recorded for a depth only render pass
+        std::unique_ptr<ParallelEncoder> depthPrepassEncoder;
+        std::vector<DrawCommand> prepassDraws;
+        std::vector<RenderBundle> prepassBundles;
+        // render targets recycled across frame graph rebuilds, outlives frameGraph
+        TexturePool texturePool;
+        // passes of a frame, rebuilt whenever the target size changes
+        FrameGraph frameGraph;
+        // per pass GPU timings, no-op when the adapter has no timestamp queries
+        GpuProfiler gpuProfiler;
+        // --dynamic-res: scale picked from GPU timings, or work done callbacks without timestamps
+        ResolutionController resolution;
+        WorkDoneTimer workDoneTimer;
+        Upscaler upscaler;
+        // size of the frame graph's target, and of the scene target sized for the largest scale
+        uint32_t targetWidth = 0;
+        uint32_t targetHeight = 0;
+        uint32_t sceneWidth = 0;
+        uint32_t sceneHeight = 0;
+        // headless target, replaces the surface texture when options.headless is set
+        Texture offscreenTexture = nullptr;
+        TextureView offscreenSampleView = nullptr; // source of the YUV conversion
+        // frames on their way back to the CPU, delivered to SaveFrame a few frames later
+        ReadbackRing readbackRing;
+        // --capture nv12 / i420: converted on the GPU, read back, written as a stream
+        YuvConverter yuvConverter;
+        YuvWriter yuvWriter;
+        // --shm: frames go to another process instead of files
+        SharedFrameWriter sharedFrames;
+        uint32_t frameIndex = 0;
+        // only set in --bench mode
+        std::unique_ptr<FrameBenchmark> benchmark;
+        // phases from Initialize to the first frame, reported by ReportStartup
+        StartupProfiler startup;
 };
 
-int main () {
+int main (int argc, char* argv[]) {
+    Options options;
+    if (!Options::parse(argc, argv, options)) {
+        return 1;
+    }
+
     Application app;
 
-    if (!app.Initialize()) {
+    if (!app.Initialize(options)) {
         return 1;
     }
+
+#ifndef __EMSCRIPTEN__
+    // the measurement modes run straight away, without a main loop to wait for the device in
+    if (options.isMeasurementRun()) {
+        if (!app.WaitUntilReady()) {
+            app.Terminate();
+            return 1;
+        }
+    }
+
+    if (options.encodeScalingDraws > 0) {
+        app.ReportEncodingScaling(options.encodeScalingDraws);
+        app.Terminate();
+        return 0;
+    }
+
+    if (options.sortBenchPackets > 0) {
+        app.ReportSortCost(options.sortBenchPackets);
+        app.Terminate();
+        return 0;
+    }
+
+    if (options.allocBenchCount > 0) {
+        app.ReportAllocatorCost(options.allocBenchCount);
+        app.Terminate();
+        return 0;
+    }
+
+    if (options.stagingBenchUploads > 0) {
+        app.ReportStagingCost(options.stagingBenchUploads);
+        app.Terminate();
+        return 0;
+    }
+
+    if (options.textureBenchCount > 0) {
+        app.ReportTextureLoading(options.textureBenchCount);
+        app.Terminate();
+        return 0;
+    }
+
+    if (options.mipBenchSize > 0) {
+        app.ReportMipmapCost(options.mipBenchSize);
+        app.Terminate();
+        return 0;
+    }
+
+    if (options.compressionBenchSize > 0) {
+        app.ReportTextureCompression(options.compressionBenchSize);
+        app.Terminate();
+        return 0;
+    }
+#endif
     
 #ifdef __EMSCRIPTEN__
     auto callback = [](void *arg) {
@@ -102,29 +422,63 @@ int main () {
     }
 #endif
 
+    bool failed = app.HasFailed();
     app.Terminate();
-    return 0;
+    return failed ? 1 : 0;
 }
 
-bool Application::Initialize() {
-    // Open Window
-    // Initialize library
-    if (!glfwInit()) {
-        std::cerr << "Could not initialize GLFW!" << std::endl;
-        return 1;
+bool Application::Initialize(const Options& appOptions) {
+    startup.start();
+    options = appOptions;
+    if (!options.tracePath.empty()) {
+        Trace::setEnabled(true);
+        Trace::setThreadName("main");
     }
-    // Setting extra arguments before creating window
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // ignore graphics api
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // prevents resizable window
-    window = glfwCreateWindow(640, 480, "Learn WebGPU", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Could not open window" << std::endl;
-        glfwTerminate();
-        return 1;
+
+#ifdef __EMSCRIPTEN__
+    if (options.headless) {
+        // frames are read back by blocking on the device, which the browser can't do
+        std::cerr << "Headless mode is not available on the web" << std::endl;
+        return false;
+    }
+    if (options.isMeasurementRun()) {
+        // they would have to block until the device arrives, which only happens between frames
+        std::cerr << options.measurementFlag() << " is not available on the web" << std::endl;
+        return false;
+    }
+#endif
+
+    // Open Window -- headless mode has no window and never touches GLFW, so it runs without a display
+    if (!options.headless) {
+        // Initialize library
+        startup.begin("glfw init");
+        if (!glfwInit()) {
+            std::cerr << "Could not initialize GLFW!" << std::endl;
+            return 1;
+        }
+        startup.end("glfw init");
+        // Setting extra arguments before creating window
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // ignore graphics api
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE); // surface gets reconfigured in MainLoop on resize
+        startup.begin("create window");
+        window = glfwCreateWindow(640, 480, "Learn WebGPU", nullptr, nullptr);
+        startup.end("create window");
+        if (!window) {
+            std::cerr << "Could not open window" << std::endl;
+            glfwTerminate();
+            return 1;
+        }
+        // let the static GLFW callbacks find their way back to this object
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, OnFramebufferResize);
+        glfwSetKeyCallback(window, OnKey);
+        glfwSetWindowRefreshCallback(window, OnWindowRefresh);
     }
 
     // Create WebGPU instance
-    Instance instance = wgpuCreateInstance(nullptr);
+    startup.begin("create instance");
+    instance = wgpuCreateInstance(nullptr);
+    startup.end("create instance");
     // Check instance
     if (!instance) {
         std::cerr << "could not initialise webgpu" << std::endl;
@@ -132,21 +486,141 @@ bool Application::Initialize() {
     }
 
     // Get Adapter
-    surface = glfwGetWGPUSurface(instance, window);
+    if (!options.headless) {
+        StartupProfiler::Phase phase(startup, "create surface");
+        surface = glfwGetWGPUSurface(instance, window);
+    }
+
+    // The rest of the startup waits for the adapter and the device, which arrive through callbacks:
+    // MainLoop calls TickInitialization until they did. Reading the geometry and the shader needs
+    // neither, so it happens meanwhile -- on a thread natively, where backends tend to do the
+    // adapter and device work inside the request calls themselves.
+#ifndef __EMSCRIPTEN__
+    assetLoad = std::async(std::launch::async, [this]() { return LoadAssets(); });
+#endif
 
     std::cout << "Requesting adapter..." << std::endl;
     RequestAdapterOptions adapterOpts = {};
-    adapterOpts.compatibleSurface = surface;
-    Adapter adapter = instance.requestAdapter(adapterOpts);
-    std::cout << "Got adapter: " << adapter << std::endl;
-    // inspectAdapter(adapter);
-    // No longer need instance once we have adapter -- instance not destroyed bc referenced by adapter.
-    instance.release();
+    adapterOpts.compatibleSurface = surface; // nullptr when headless, any adapter will do
+    adapterOpts.forceFallbackAdapter = options.softwareAdapter;
+    initState = InitState::RequestingAdapter;
+    // ends when TickInitialization sees the answer, like the device request
+    startup.begin("request adapter");
+    adapterRequest = instance.requestAdapter(adapterOpts, [this](RequestAdapterStatus status, Adapter result, char const* message) {
+        if (status == RequestAdapterStatus::Success) {
+            adapter = result;
+        }
+        else {
+            std::cerr << "Could not get adapter: " << (message ? message : "no message") << std::endl;
+        }
+        adapterAnswered = true;
+    });
+
+#ifdef __EMSCRIPTEN__
+    // no threads on the web, but the browser only answers the request once we return to it, so
+    // reading the files right now still overlaps with it
+    assetsLoaded = LoadAssets();
+#endif
+    return true;
+}
+
+bool Application::LoadAssets() {
+    TRACE_SCOPE("load assets");
+    StartupProfiler::Phase phase(startup, "load assets");
+    // hardcording the file path here is an issue depending on the directory from which command is called
+    // Instead use auto generated path from cmake (alternatively could use command line arg), could switch to just being careful for distribution
+    // define RESOURCE_DIR "/home/me/code/myproject/resources"
+    if (!ResourceManager::loadGeometry(RESOURCE_DIR "/webgpu.txt", pointData, indexData)) {
+        std::cerr << "could not load geometry... " << std::endl;
+        return false;
+    }
+    if (!ResourceManager::loadShaderSource(RESOURCE_DIR "/shader.wgsl", shaderSource)) {
+        std::cerr << "Could not load shader" << std::endl;
+        return false;
+    }
+    if (!options.texturePath.empty()) {
+        // KTX2 blocks are only parsed here, whether they can be uploaded as they are is known with the device
+        bool isKtx2 = std::filesystem::path(options.texturePath).extension() == ".ktx2";
+        bool loaded = isKtx2 ? ResourceManager::loadKtx2(options.texturePath, sceneCompressed)
+            : ResourceManager::loadImage(options.texturePath, sceneImage);
+        if (!loaded) {
+            std::cerr << "Could not load texture " << options.texturePath << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
+bool Application::TickInitialization() {
+#ifdef WEBGPU_BACKEND_DAWN
+    // Dawn delivers the request callbacks from here
+    if (instance) {
+        instance.processEvents();
+    }
+#endif
+    switch (initState) {
+    case InitState::RequestingAdapter:
+        if (!adapterAnswered) break;
+        startup.end("request adapter");
+        adapterRequest.reset();
+        if (!adapter) {
+            initState = InitState::Failed;
+            break;
+        }
+        std::cout << "Got adapter: " << adapter << std::endl;
+        // inspectAdapter(adapter);
+        RequestDevice();
+        break;
+    case InitState::RequestingDevice:
+        if (!deviceAnswered) break;
+        startup.end("request device");
+        deviceRequest.reset();
+        if (!device) {
+            initState = InitState::Failed;
+            break;
+        }
+        std::cout << "Got device: " << device << std::endl;
+        initState = FinishInitialization() ? InitState::Ready : InitState::Failed;
+        break;
+    default:
+        break;
+    }
+    return initState == InitState::Ready;
+}
+
+void Application::RequestDevice() {
     std::cout << "Requesting device..." << std::endl;
 	DeviceDescriptor deviceDesc = {};
 	deviceDesc.label = "My Device";
-	deviceDesc.requiredFeatureCount = 0;
+#ifdef WEBGPU_BACKEND_DAWN
+	// Dawn only lets several threads record into the same device with this feature on
+	if (adapter.hasFeature(FeatureName::ImplicitDeviceSynchronization)) {
+		requiredFeatures.push_back(WGPUFeatureName_ImplicitDeviceSynchronization);
+	}
+	else {
+		options.encodeThreads = 1;
+	}
+#endif
+	// timestamp queries are optional, the profiler turns itself off without them
+	timestampsSupported = GpuProfiler::isSupported(adapter);
+	if (timestampsSupported) {
+		requiredFeatures.push_back(WGPUFeatureName_TimestampQuery);
+	}
+	// block compressed textures where the adapter has them, KTX2 files get decompressed otherwise
+	if (options.textureCompression) {
+		textureCompression = TextureCompression::query(adapter);
+	}
+	if (textureCompression.bc) {
+		requiredFeatures.push_back(WGPUFeatureName_TextureCompressionBC);
+	}
+	if (textureCompression.etc2) {
+		requiredFeatures.push_back(WGPUFeatureName_TextureCompressionETC2);
+	}
+	if (textureCompression.astc) {
+		requiredFeatures.push_back(WGPUFeatureName_TextureCompressionASTC);
+	}
+	deviceDesc.requiredFeatureCount = requiredFeatures.size();
+	deviceDesc.requiredFeatures = requiredFeatures.data();
 	deviceDesc.requiredLimits = nullptr;
 	deviceDesc.defaultQueue.nextInChain = nullptr;
 	deviceDesc.defaultQueue.label = "The default queue";
@@ -158,9 +632,21 @@ bool Application::Initialize() {
 	// Before adapter.requestDevice(deviceDesc)
 	RequiredLimits requiredLimits = GetRequiredLimits(adapter);
 	deviceDesc.requiredLimits = &requiredLimits;
-	device = adapter.requestDevice(deviceDesc);
-	std::cout << "Got device: " << device << std::endl;
+    initState = InitState::RequestingDevice;
+    startup.begin("request device");
+    // the descriptor is read during the call, only the callback has to outlive it
+    deviceRequest = adapter.requestDevice(deviceDesc, [this](RequestDeviceStatus status, Device result, char const* message) {
+        if (status == RequestDeviceStatus::Success) {
+            device = result;
+        }
+        else {
+            std::cerr << "Could not get device: " << (message ? message : "no message") << std::endl;
+        }
+        deviceAnswered = true;
+    });
+}
 
+bool Application::FinishInitialization() {
     // Uncaptured error callbacks happen when we misuse the API, informative feedback. SET AFTER DEVICE CREATION 
     uncapturedErrorCallbackHandle = device.setUncapturedErrorCallback([](ErrorType type, char const* message) {
 		std::cout << "Uncaptured device error: type " << type;
@@ -171,65 +657,554 @@ bool Application::Initialize() {
 
     // Look at Queue
     queue = device.getQueue();
+    gpuProfiler.initialize(device, queue, timestampsSupported);
+    texturePool.initialize(device, 3, &lifetimes);
+    // over budget, idle memory goes back cheapest to refill first: staging chunks, then pooled
+    // targets, then empty geometry blocks
+    GpuMemory::setBudget(static_cast<uint64_t>(options.memoryBudgetMiB) << 20);
+    memoryEvictors.push_back(GpuMemory::addEvictionCallback("staging belt", [this](uint64_t bytes) { return stagingBelt.trim(bytes); }));
+    memoryEvictors.push_back(GpuMemory::addEvictionCallback("texture pool", [this](uint64_t bytes) { return texturePool.trim(bytes); }));
+    memoryEvictors.push_back(GpuMemory::addEvictionCallback("buffer allocator", [this](uint64_t bytes) { return bufferAllocator.trim(bytes); }));
 
     // Configure the surface
-	SurfaceConfiguration config = {};
-	// Configuration of the textures created for the underlying swap chain
-	config.width = 640;
-	config.height = 480;
-	config.usage = TextureUsage::RenderAttachment;
-	surfaceFormat = surface.getPreferredFormat(adapter);
-	config.format = surfaceFormat;
+	// Configuration of the textures created for the underlying swap chain, size is filled by ConfigureSurface
+	surfaceConfig.usage = TextureUsage::RenderAttachment;
+	// headless renders to a texture of our choosing, sRGB like most surfaces so the shader's gamma handling holds
+	surfaceFormat = options.headless ? TextureFormat::RGBA8UnormSrgb : surface.getPreferredFormat(adapter);
+	surfaceConfig.format = surfaceFormat;
 	// And we do not need any particular view format:
-	config.viewFormatCount = 0;
-	config.viewFormats = nullptr;
-	config.device = device;
-	config.presentMode = PresentMode::Fifo;
-	config.alphaMode = CompositeAlphaMode::Auto;
-
-    surface.configure(config);
+	surfaceConfig.viewFormatCount = 0;
+	surfaceConfig.viewFormats = nullptr;
+	surfaceConfig.device = device;
+	surfaceConfig.presentMode = PresentMode::Fifo;
+	surfaceConfig.alphaMode = CompositeAlphaMode::Auto;
     adapter.release();
+    adapter = nullptr;
+    // no more requests to process events for
+    instance.release();
+    instance = nullptr;
 
+    // the files were read while the adapter and device were on their way
+#ifndef __EMSCRIPTEN__
+    startup.begin("wait for assets");
+    assetsLoaded = assetLoad.get();
+    startup.end("wait for assets");
+#endif
+    if (!assetsLoaded) {
+        return false;
+    }
     InitializePipeline();
+    startup.begin("buffer upload");
     InitializeBuffers();
+    startup.end("buffer upload");
+    startup.begin("textures");
+    InitializeTextures();
+    startup.end("textures");
+    startup.begin("bind groups");
     InitializeBindGroups();
+    startup.end("bind groups");
+    if (options.dynamicResolution) {
+        if (!upscaler.initialize(device, surfaceFormat)) {
+            return false;
+        }
+        resolution.configure(options.minScale, options.maxScale, options.frameBudgetMs);
+    }
+
+    // the calling thread records too, so the pool only needs the extra ones
+    startup.begin("encoder threads");
+    uint32_t encodeThreads = options.encodeThreads;
+    if (encodeThreads == 0) {
+        encodeThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadPool = std::make_unique<ThreadPool>(encodeThreads - 1);
+    parallelEncoder = std::make_unique<ParallelEncoder>(*threadPool);
+    parallelEncoder->setAttachmentFormats(surfaceFormat, options.depth == DepthMode::Off ? TextureFormat::Undefined : depthFormat);
+    if (options.depth == DepthMode::Prepass) {
+        depthPrepassEncoder = std::make_unique<ParallelEncoder>(*threadPool);
+        depthPrepassEncoder->setAttachmentFormats(TextureFormat::Undefined, depthFormat);
+    }
+    startup.end("encoder threads");
+
+    if (options.bench) {
+        benchmark = std::make_unique<FrameBenchmark>(options.warmup, options.frameCount());
+    }
+
+    // configure last so that the ratio uniform is written into an existing buffer
+    // (the frame graph and its targets are built here too)
+    StartupProfiler::Phase phase(startup, "configure surface");
+    if (options.headless) {
+        InitializeOffscreenTarget(options.width, options.height);
+    }
+    else {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        ConfigureSurface(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    }
+
+    simulation.start();
+    SetAnimating(!options.paused);
+    startTime = std::chrono::steady_clock::now();
+    startCpuTime = std::clock();
 
     return true;
 }
 
+bool Application::WaitUntilReady() {
+    while (!TickInitialization()) {
+        if (initState == InitState::Failed) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void Application::ReportStartup() {
+    startup.finish();
+    startup.report(std::cout);
+    if (benchmark) {
+        benchmark->setStartupMs(startup.totalMs());
+    }
+    if (options.startupOutput.empty()) {
+        return;
+    }
+    std::ofstream file(options.startupOutput);
+    if (!file) {
+        std::cerr << "Could not write startup report to " << options.startupOutput << std::endl;
+        return;
+    }
+    startup.writeJson(file);
+    std::cout << "Wrote startup report to " << options.startupOutput << std::endl;
+}
+
 void Application::Terminate() {
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (initState != InitState::Ready) {
+        // stopped (or failed) during startup: only what Initialize and the ticks created exists
+        if (assetLoad.valid()) {
+            assetLoad.wait();
+        }
+        adapterRequest.reset();
+        deviceRequest.reset();
+        if (device) device.release();
+        if (adapter) adapter.release();
+        if (surface) surface.release();
+        if (instance) instance.release();
+        if (window) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+        return;
+    }
+    if (!options.headless && framesRendered > 0) {
+        // process CPU time, all threads: compare --on-demand with the default continuous loop
+        double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        double cpuSeconds = static_cast<double>(std::clock() - startCpuTime) / CLOCKS_PER_SEC;
+        std::cout << "Rendered " << framesRendered << " frame(s) in " << wallSeconds << " s ("
+            << framesRendered / wallSeconds << " fps), " << idleWaits << " idle wait(s), CPU time "
+            << cpuSeconds << " s (" << 100.0 * cpuSeconds / wallSeconds << "% of one core)" << std::endl;
+    }
+    // before the teardown, so that "in use" is what the App was running with
+    GpuMemory::report(std::cout);
+    for (uint32_t evictor : memoryEvictors) {
+        GpuMemory::removeEvictionCallback(evictor);
+    }
+    memoryEvictors.clear();
+    if (IsCapturing()) {
+        // frames still in flight are part of the output
+        readbackRing.flush([this]() { PollDevice(true); });
+        std::cout << "Read back " << readbackRing.deliveredFrames() << " frame(s), dropped "
+            << readbackRing.droppedFrames() << std::endl;
+        if (benchmark) {
+            uint64_t frameSize = GetCaptureFormat() == CaptureFormat::Rgba
+                ? static_cast<uint64_t>(ceilToNextMultiple(4 * options.width, 256)) * options.height
+                : yuvConverter.outputSize();
+            benchmark->setReadbackStats(frameSize, readbackRing.deliveredFrames(), readbackRing.droppedFrames());
+        }
+    }
+    readbackRing.terminate();
+    if (sharedFrames.isOpen()) {
+        std::cout << "Published " << sharedFrames.publishedFrames() << " frame(s) to " << options.sharedMemory
+            << ", " << sharedFrames.droppedFrames() << " dropped by a slow consumer" << std::endl;
+        sharedFrames.close();
+    }
+    yuvWriter.close();
+    yuvConverter.terminate();
+    if (benchmark) {
+        WriteBenchmarkReport();
+        benchmark.reset();
+    }
+    simulation.stop();
+    if (parallelEncoder) {
+        const EncodeStats& encodeStats = parallelEncoder->lastStats();
+        std::cout << "Last frame: " << encodeStats.draws << " draw(s), " << encodeStats.stateChanges()
+            << " state change(s) (" << encodeStats.pipelines << " pipeline, " << encodeStats.bindGroups
+            << " bind group, " << encodeStats.vertexBuffers << " vertex buffer, " << encodeStats.indexBuffers
+            << " index buffer)" << std::endl;
+    }
+    depthPrepassEncoder.reset();
+    parallelEncoder.reset();
+    threadPool.reset();
+    frameGraph.report(std::cout);
+    frameGraph.terminate();
+    if (options.dynamicResolution) {
+        resolution.report(std::cout);
+        upscaler.terminate();
+    }
+    texturePool.report(std::cout);
+    texturePool.terminate();
+    bufferAllocator.report(std::cout);
+    lifetimes.report(std::cout);
+    stagingBelt.report(std::cout);
+    gpuProfiler.report(std::cout);
+    gpuProfiler.terminate();
+    if (Trace::isEnabled()) {
+        if (Trace::exportChromeJson(options.tracePath)) {
+            std::cout << "Wrote CPU trace to " << options.tracePath << std::endl;
+        }
+        else {
+            std::cerr << "Could not write CPU trace to " << options.tracePath << std::endl;
+        }
+    }
+
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 
     layout.release();
     bindGroupLayout.release();
     bindGroup.release();
-    pointBuffer.release();
-    indexBuffer.release();
-    uniformBuffer.release();
+    TextureLoader::release(sceneTexture);
+    sceneSampler.release();
+    mipmaps.terminate();
+    // nothing will be submitted anymore: lifetimes.terminate() runs these, and whatever else is
+    // still deferred, before the allocators are gone
+    bufferAllocator.retire(pointAllocation, lifetimes);
+    bufferAllocator.retire(indexAllocation, lifetimes);
+    bufferAllocator.retire(uniformAllocation, lifetimes);
+    lifetimes.terminate();
+    bufferAllocator.terminate();
+    stagingBelt.terminate();
     pipeline.release();
+    if (depthPrepassPipeline) depthPrepassPipeline.release();
+    if (offscreenTexture) {
+        offscreenSampleView.release();
+        GpuMemory::untrack(offscreenTexture);
+        offscreenTexture.destroy();
+        offscreenTexture.release();
+    }
     queue.release();
     device.release();
-    surface.unconfigure();
-    surface.release();
+    if (surface) {
+        surface.unconfigure();
+        surface.release();
+    }
 }
 
 void Application::MainLoop() {
-    glfwPollEvents();
-    // update uniform
-    float time = static_cast<float>(glfwGetTime()); 
-    // offsetof auto calculates num bytes so that we can selectively replace attributes
-    queue.writeBuffer(uniformBuffer, offsetof(MyUniforms, time), &time, sizeof(float));
+    if (initState != InitState::Ready) {
+        // still starting up: keep the window responsive and see whether the device arrived
+        if (!options.headless) {
+            glfwPollEvents();
+        }
+        InitState before = initState;
+        if (!TickInitialization() && initState == before) {
+#ifndef __EMSCRIPTEN__
+            // nothing happened, don't spin while the backend works
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+        }
+        return;
+    }
+    TRACE_SCOPE("frame");
+    if (benchmark) {
+        benchmark->beginFrame();
+        RenderFrame();
+        benchmark->endFrame();
+    }
+    else {
+        RenderFrame();
+    }
+}
+
+void Application::RenderFrame() {
+    if (!options.headless) {
+        if (!WantsFrame()) {
+            // nothing changed since the last frame: sleep until something does
+            WaitForEvents();
+        }
+        else {
+            TRACE_SCOPE("poll events");
+            glfwPollEvents();
+        }
+        ApplyPendingResize();
+        // minimized window -- nothing to draw into, don't spin on getCurrentTexture
+        if (surfaceConfig.width == 0 || surfaceConfig.height == 0) {
+            return;
+        }
+        // woken up by an event that changes nothing on screen (mouse moves...)
+        if (!WantsFrame()) {
+            return;
+        }
+    }
+#ifdef __EMSCRIPTEN__
+    // no simulation thread on the web, step it here
+    simulation.update();
+#endif
+    // update uniform from the newest simulation snapshot
+    float time = static_cast<float>(simulation.sample().time);
+    {
+        TRACE_SCOPE("write uniforms");
+        // offsetof auto calculates num bytes so that we can selectively replace attributes
+        queue.writeBuffer(uniformAllocation.buffer, uniformAllocation.offset + offsetof(MyUniforms, time), &time, sizeof(float));
+    }
 
+    if (IsCapturing() && !options.dropFrames) {
+        // batch rendering wants every frame: wait for the consumer rather than drop one
+        TRACE_SCOPE("wait readback slot");
+        while (!readbackRing.hasFreeSlot()) {
+            PollDevice(true);
+            readbackRing.update();
+        }
+    }
+
+    // from here to present, the first time around
+    startup.begin("first frame");
     // get next target texture view
-    TextureView targetView = GetNextSurfaceTextureView();
+    TextureView targetView = nullptr;
+    {
+        TRACE_SCOPE("get current texture");
+        targetView = GetNextTargetView();
+    }
     if (!targetView) {return;}
     
+    CommandBuffer command = EncodeFrame(targetView);
+    // whatever went through the belt this frame must be unmapped before the copies run
+    stagingBelt.finish();
+
+    {
+        TRACE_SCOPE("submit");
+        queue.submit(1, &command);
+    }
+    command.release();
+    stagingBelt.recall();
+    lifetimes.onSubmit();
+    if (benchmark) {
+        benchmark->onSubmit(queue);
+    }
+    gpuProfiler.afterSubmit();
+    if (options.dynamicResolution) {
+        if (!gpuProfiler.isEnabled()) {
+            workDoneTimer.onSubmit(queue);
+        }
+        UpdateResolution();
+    }
+    readbackRing.afterSubmit();
+    texturePool.endFrame();
+
+    //end of frame
+    targetView.release();
+#ifndef __EMSCRIPTEN__
+    if (!options.headless) {
+        TRACE_SCOPE("present");
+        surface.present();
+    }
+#endif
+    // only once it is on screen: a frame dropped above (no surface texture) is tried again
+    frameDirty = false;
+    if (!startup.isFinished()) {
+        startup.end("first frame");
+        ReportStartup();
+    }
+    if (benchmark) {
+        benchmark->onPresent();
+    }
+    ++frameIndex;
+    ++framesRendered;
+
+    {
+        TRACE_SCOPE("device poll");
+        PollDevice(false);
+    }
+    readbackRing.update();
+    lifetimes.collect();
+    // between frames, when no pool is in the middle of handing something out
+    GpuMemory::enforceBudget();
+}
+
+CommandBuffer Application::EncodeFrame(TextureView targetView) {
+    TRACE_SCOPE("encode");
+    // record the draws into bundles on the worker threads while nothing else needs them
+    RecordDraws(draws);
+    frameBundles = parallelEncoder->encode(device, draws);
+    if (depthPrepassEncoder) {
+        // opaque draws only: translucent ones must not hide what is behind them
+        prepassDraws.clear();
+        for (DrawCommand draw : draws) {
+            if (draw.pipeline != pipeline) continue;
+            draw.pipeline = depthPrepassPipeline;
+            prepassDraws.push_back(draw);
+        }
+        prepassBundles = depthPrepassEncoder->encode(device, prepassDraws);
+    }
+    if (benchmark) {
+        benchmark->onEncode(parallelEncoder->lastStats().stateChanges());
+    }
+
     // Create command encoder
 	CommandEncoderDescriptor encoderDesc = {};
 	encoderDesc.label = "My command encoder";
 	CommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &encoderDesc);
+    gpuProfiler.beginFrame();
+
+    // the passes themselves are declared in BuildFrameGraph
+    frameGraph.setTexture("backbuffer", targetView, options.headless ? offscreenTexture : nullptr);
+    frameGraph.execute(encoder);
+    for (RenderBundle& bundle : frameBundles) {
+        bundle.release();
+    }
+    frameBundles.clear();
+    for (RenderBundle& bundle : prepassBundles) {
+        bundle.release();
+    }
+    prepassBundles.clear();
 
+    // Finally encode the render pass, MainLoop submits it
+	CommandBufferDescriptor cmdBufferDescriptor = {};
+	cmdBufferDescriptor.label = "Command buffer";
+    gpuProfiler.endFrame(encoder);
+	CommandBuffer command = encoder.finish(cmdBufferDescriptor);
+	encoder.release();
+    return command;
+}
+
+void Application::BuildFrameGraph(uint32_t width, uint32_t height) {
+    // the scene color view the upscaler samples goes away with the old graph
+    upscaler.invalidate();
+    frameGraph.reset();
+    // the surface texture, or the offscreen target when headless
+    frameGraph.importTexture("backbuffer");
+    targetWidth = width;
+    targetHeight = height;
+    sceneWidth = width;
+    sceneHeight = height;
+
+    // Dynamic resolution draws the scene into its own target, then stretches it over the backbuffer.
+    // The target is sized for the largest scale and smaller scales only use its top left corner, so
+    // changing the scale is a viewport change instead of a rebuild of the graph and its textures.
+    std::string sceneTarget = "backbuffer";
+    if (options.dynamicResolution) {
+        sceneWidth = std::max(1u, static_cast<uint32_t>(std::ceil(width * options.maxScale)));
+        sceneHeight = std::max(1u, static_cast<uint32_t>(std::ceil(height * options.maxScale)));
+        FrameGraph::TextureDesc colorDesc;
+        colorDesc.width = sceneWidth;
+        colorDesc.height = sceneHeight;
+        colorDesc.format = surfaceFormat; // what the scene pipelines are built for
+        colorDesc.usage = TextureUsage::RenderAttachment | TextureUsage::TextureBinding;
+        frameGraph.createTexture("scene color", colorDesc);
+        sceneTarget = "scene color";
+    }
+
+    if (options.depth != DepthMode::Off) {
+        // only lives during the frame, so it comes from the pool and may share memory with other targets
+        FrameGraph::TextureDesc depthDesc;
+        depthDesc.width = sceneWidth;
+        depthDesc.height = sceneHeight;
+        depthDesc.format = depthFormat;
+        depthDesc.usage = TextureUsage::RenderAttachment;
+        frameGraph.createTexture("depth", depthDesc);
+    }
+    if (options.depth == DepthMode::Prepass) {
+        frameGraph.addPass("depth prepass", [](FrameGraph::PassBuilder& pass) {
+            pass.write("depth");
+        }, [this](CommandEncoder encoder, const FrameGraph::Resources& resources) {
+            EncodeDepthPrepass(encoder, resources.textureView("depth"));
+        });
+    }
+
+    frameGraph.addPass("scene", [this, sceneTarget](FrameGraph::PassBuilder& pass) {
+        pass.write(sceneTarget);
+        if (options.depth == DepthMode::On) pass.write("depth");
+        if (options.depth == DepthMode::Prepass) pass.read("depth");
+    }, [this, sceneTarget](CommandEncoder encoder, const FrameGraph::Resources& resources) {
+        EncodeScenePass(encoder, resources.textureView(sceneTarget), resources.textureView("depth"));
+    });
+
+    if (options.dynamicResolution) {
+        frameGraph.addPass("upscale", [](FrameGraph::PassBuilder& pass) {
+            pass.read("scene color");
+            pass.write("backbuffer");
+        }, [this](CommandEncoder encoder, const FrameGraph::Resources& resources) {
+            upscaler.encode(encoder, resources.textureView("scene color"), sceneWidth, sceneHeight,
+                resolution.scaled(targetWidth), resolution.scaled(targetHeight), resources.textureView("backbuffer"), gpuProfiler);
+        });
+    }
+
+    if (IsCapturing() && GetCaptureFormat() != CaptureFormat::Rgba) {
+        // the conversion's output belongs to yuvConverter, the graph only orders around it
+        frameGraph.importBuffer("yuv");
+        frameGraph.addPass("rgb to yuv", [](FrameGraph::PassBuilder& pass) {
+            pass.read("backbuffer");
+            pass.write("yuv");
+        }, [this](CommandEncoder encoder, const FrameGraph::Resources&) {
+            // convert to YUV on the GPU so that only 1.5 bytes per pixel cross the bus
+            yuvConverter.encode(encoder, offscreenSampleView, gpuProfiler);
+        });
+        frameGraph.addPass("readback", [](FrameGraph::PassBuilder& pass) {
+            pass.read("yuv");
+            pass.sideEffect();
+        }, [this, width, height](CommandEncoder encoder, const FrameGraph::Resources&) {
+            readbackRing.enqueueBuffer(encoder, yuvConverter.outputBuffer(), 0, yuvConverter.outputSize(), width, height, frameIndex);
+        });
+    }
+    else if (IsCapturing()) {
+        frameGraph.addPass("readback", [](FrameGraph::PassBuilder& pass) {
+            pass.read("backbuffer");
+            pass.sideEffect();
+        }, [this, width, height](CommandEncoder encoder, const FrameGraph::Resources& resources) {
+            // copy the frame out, it reaches SaveFrame once mapped. Counted as dropped if the ring is full
+            readbackRing.enqueueTexture(encoder, resources.texture("backbuffer"), width, height, frameIndex);
+        });
+    }
+
+    if (!frameGraph.compile(device, texturePool)) {
+        exit(1);
+    }
+}
+
+void Application::EncodeDepthPrepass(CommandEncoder encoder, TextureView depthView) {
+    RenderPassDepthStencilAttachment depthAttachment = {};
+    depthAttachment.view = depthView;
+    // far plane everywhere, then the closest opaque depth per pixel
+    depthAttachment.depthClearValue = 1.0f;
+    depthAttachment.depthLoadOp = LoadOp::Clear;
+    depthAttachment.depthStoreOp = StoreOp::Store; // the scene pass tests against it
+    depthAttachment.depthReadOnly = false;
+    // Depth24Plus has no stencil aspect
+    depthAttachment.stencilClearValue = 0;
+#ifdef WEBGPU_BACKEND_WGPU
+    depthAttachment.stencilLoadOp = LoadOp::Clear;
+    depthAttachment.stencilStoreOp = StoreOp::Store;
+#else
+    depthAttachment.stencilLoadOp = LoadOp::Undefined;
+    depthAttachment.stencilStoreOp = StoreOp::Undefined;
+#endif
+    depthAttachment.stencilReadOnly = true;
+
+    RenderPassDescriptor renderPassDesc = {};
+    renderPassDesc.colorAttachmentCount = 0;
+    renderPassDesc.colorAttachments = nullptr;
+    renderPassDesc.depthStencilAttachment = &depthAttachment;
+    renderPassDesc.timestampWrites = gpuProfiler.renderPass("depth prepass");
+
+    RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+    SetSceneViewport(renderPass);
+    renderPass.executeBundles(prepassBundles.size(), prepassBundles.data());
+    renderPass.end();
+    renderPass.release();
+}
+
+void Application::EncodeScenePass(CommandEncoder encoder, TextureView targetView, TextureView depthView) {
     // Create render pass that clears screen with color
     RenderPassDescriptor renderPassDesc = {};
 
@@ -240,88 +1215,801 @@ void Application::MainLoop() {
     renderPassColorAttachment.loadOp = LoadOp::Clear; // load operation to perform prior to execution
     renderPassColorAttachment.storeOp = StoreOp::Store; // op after executing render pass (stored or discarded)
     renderPassColorAttachment.clearValue = WGPUColor{ 0.32, 0.52, 0.06, 1.0 }; // value to clear screen with
+    if (options.overdraw) {
+        // the heatmap counts up from black
+        renderPassColorAttachment.clearValue = WGPUColor{ 0.0, 0.0, 0.0, 1.0 };
+    }
 #ifndef WEBGPU_BACKEND_WGPU
-    // not using depth buffer
+    // 2D target, no slice to pick
     renderPassColorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
 #endif
-    // special attachments to come back to later
-    renderPassDesc.depthStencilAttachment = nullptr;
-    renderPassDesc.timestampWrites = nullptr;
+
+    // depth buffer: cleared here, or kept from the prepass and only tested
+    RenderPassDepthStencilAttachment depthAttachment = {};
+    depthAttachment.view = depthView;
+    depthAttachment.depthClearValue = 1.0f;
+    depthAttachment.depthLoadOp = options.depth == DepthMode::Prepass ? LoadOp::Load : LoadOp::Clear;
+    depthAttachment.depthStoreOp = StoreOp::Discard; // nothing reads it after this pass
+    depthAttachment.depthReadOnly = false;
+    depthAttachment.stencilClearValue = 0;
+#ifdef WEBGPU_BACKEND_WGPU
+    depthAttachment.stencilLoadOp = LoadOp::Clear;
+    depthAttachment.stencilStoreOp = StoreOp::Store;
+#else
+    depthAttachment.stencilLoadOp = LoadOp::Undefined;
+    depthAttachment.stencilStoreOp = StoreOp::Undefined;
+#endif
+    depthAttachment.stencilReadOnly = true;
+    renderPassDesc.depthStencilAttachment = options.depth == DepthMode::Off ? nullptr : &depthAttachment;
+    renderPassDesc.timestampWrites = gpuProfiler.renderPass("scene");
     // attaching the texture to which we edit
     renderPassDesc.colorAttachmentCount = 1;
     renderPassDesc.colorAttachments = &renderPassColorAttachment;
 
     // Create render pass
     RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+    SetSceneViewport(renderPass);
 
-    // set rendering pipeline
-    renderPass.setPipeline(pipeline);
-    uint32_t dynamicOffset = 0;
-    // set buffer
-    renderPass.setVertexBuffer(0, pointBuffer, 0, pointBuffer.getSize());
-    renderPass.setIndexBuffer(indexBuffer, IndexFormat::Uint16, 0, indexBuffer.getSize());
-
-    // set binding group number 1
-    dynamicOffset = 0 * uniformStride;
-    renderPass.setBindGroup(0, bindGroup, 1, &dynamicOffset); // 0, nullptr
-    renderPass.drawIndexed(indexCount, 1, 0, 0, 0);
-
-    // set binding group number 2
-    dynamicOffset = 1 * uniformStride;
-    renderPass.setBindGroup(0, bindGroup, 1, &dynamicOffset); // 0, nullptr
-    renderPass.drawIndexed(indexCount, 1, 0, 0, 0);
+    // bundles replay in list order, so this is the same as drawing them one by one here
+    renderPass.executeBundles(frameBundles.size(), frameBundles.data());
 
     // End
     renderPass.end();
     renderPass.release();
+}
 
-    // Finally encode and submit the render pass
-	CommandBufferDescriptor cmdBufferDescriptor = {};
-	cmdBufferDescriptor.label = "Command buffer";
-	CommandBuffer command = encoder.finish(cmdBufferDescriptor);
-	encoder.release();
-
-    queue.submit(1, &command);
-    command.release();
-
-    //end of frame
-    targetView.release();
-#ifndef __EMSCRIPTEN__
-    surface.present();
-#endif
+void Application::SetSceneViewport(RenderPassEncoder renderPass) {
+    if (!options.dynamicResolution) {
+        return;
+    }
+    // bundles do not set the viewport, the draws they replay use the pass's
+    uint32_t width = resolution.scaled(targetWidth);
+    uint32_t height = resolution.scaled(targetHeight);
+    renderPass.setViewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f);
+    renderPass.setScissorRect(0, 0, width, height);
+}
 
-#if defined(WEBGPU_BACKEND_DAWN)
-    device.tick();
-#elif defined(WEBGPU_BACKEND_WGPU)
-    wgpuDevicePoll(device, false, nullptr);
-#endif
+void Application::UpdateResolution() {
+    // timestamps when the adapter has them, otherwise an estimate from work done callbacks
+    double frameMs = gpuProfiler.isEnabled() ? gpuProfiler.lastFrameMs() : workDoneTimer.lastFrameMs();
+    if (!resolution.update(frameMs)) {
+        return;
+    }
+    std::cout << "Resolution scale " << std::fixed << std::setprecision(2) << resolution.scale() << " ("
+        << resolution.scaled(targetWidth) << "x" << resolution.scaled(targetHeight) << "), frame time "
+        << std::setprecision(1) << resolution.changeMs() << " ms for a " << resolution.budgetMs() << " ms budget ("
+        << (gpuProfiler.isEnabled() ? "GPU timestamps" : "work done callbacks") << ")" << std::defaultfloat << std::endl;
 }
 
 bool Application::IsRunning() {
+    if (initState == InitState::Failed) {
+        return false;
+    }
+    if (initState != InitState::Ready) {
+        return options.headless || !glfwWindowShouldClose(window);
+    }
+    if (benchmark) {
+        return !benchmark->isDone() && (options.headless || !glfwWindowShouldClose(window));
+    }
+    if (options.headless) {
+        return frameIndex < options.frameCount();
+    }
     return !glfwWindowShouldClose(window);
 }
 
+void Application::WriteBenchmarkReport() {
+    // the last frames' work-done callbacks only fire once the device gets polled
+    while (!benchmark->allWorkDone()) {
+        PollDevice(true);
+    }
+
+    uint32_t width = options.headless ? options.width : surfaceConfig.width;
+    uint32_t height = options.headless ? options.height : surfaceConfig.height;
+    if (options.benchOutput.empty()) {
+        benchmark->writeJson(std::cout, width, height, options.headless);
+        return;
+    }
+    std::ofstream file(options.benchOutput);
+    if (!file.is_open()) {
+        std::cerr << "Could not write benchmark report to " << options.benchOutput << std::endl;
+        return;
+    }
+    benchmark->writeJson(file, width, height, options.headless);
+    std::cout << "Wrote benchmark report to " << options.benchOutput << std::endl;
+}
+
+void Application::RecordDraws(std::vector<DrawCommand>& drawList) {
+    drawQueue.clear();
+
+    DrawCommand draw;
+    draw.pipeline = pipeline;
+    draw.bindGroup = bindGroup;
+    draw.vertexBuffer = pointAllocation.buffer;
+    draw.vertexOffset = pointAllocation.offset;
+    draw.vertexSize = pointAllocation.size;
+    draw.indexBuffer = indexAllocation.buffer;
+    draw.indexOffset = indexAllocation.offset;
+    draw.indexSize = indexAllocation.size;
+    draw.indexFormat = IndexFormat::Uint16;
+    draw.indexCount = indexCount;
+
+    // same geometry twice, each with its own slot of the dynamic uniform buffer. Both are opaque
+    // scene geometry (layer 0): front to back with a depth buffer so that hidden fragments fail
+    // the depth test early, back to front (painter's order) without one
+    bool backToFront = options.depth == DepthMode::Off;
+    draw.dynamicOffset = 0 * uniformStride;
+    drawQueue.push(draw, 0, kDrawDepths[0], backToFront);
+    draw.dynamicOffset = 1 * uniformStride;
+    drawQueue.push(draw, 0, kDrawDepths[1], backToFront);
+
+    drawQueue.sort();
+    drawQueue.flatten(drawList);
+}
+
+void Application::ReportEncodingScaling(uint32_t drawCount) {
+    // synthetic draw list: the scene's draws repeated until we reach drawCount
+    std::vector<DrawCommand> sceneDraws;
+    RecordDraws(sceneDraws);
+    std::vector<DrawCommand> bigList;
+    bigList.reserve(drawCount);
+    for (uint32_t i = 0; i < drawCount; ++i) {
+        bigList.push_back(sceneDraws[i % sceneDraws.size()]);
+    }
+
+    constexpr int kRepetitions = 20;
+    double singleThreadMs = 0.0;
+    std::cout << "Encoding " << drawCount << " draws (average of " << kRepetitions << " runs)" << std::endl;
+    for (size_t threads = 1; threads <= threadPool->threadCount(); ++threads) {
+        // one untimed run to warm up the workers and the driver
+        for (RenderBundle& bundle : parallelEncoder->encode(device, bigList, threads)) {
+            bundle.release();
+        }
+
+        double totalMs = 0.0;
+        for (int rep = 0; rep < kRepetitions; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<RenderBundle> bundles = parallelEncoder->encode(device, bigList, threads);
+            auto stop = std::chrono::steady_clock::now();
+            totalMs += std::chrono::duration<double, std::milli>(stop - start).count();
+            for (RenderBundle& bundle : bundles) {
+                bundle.release();
+            }
+        }
+        double averageMs = totalMs / kRepetitions;
+        if (threads == 1) {
+            singleThreadMs = averageMs;
+        }
+        std::cout << "  " << threads << " thread(s): " << averageMs << " ms"
+            << " (x" << singleThreadMs / averageMs << ")" << std::endl;
+    }
+}
+
+void Application::ReportSortCost(uint32_t packetCount) {
+    // keys spread like a busy scene's: a few layers, dozens of pipelines, many bind groups
+    std::mt19937 random(42);
+    std::uniform_int_distribution<uint32_t> layer(0, 3), pipelineId(0, 63), bindGroupId(0, 4095);
+    std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+    std::vector<DrawPacket> input(packetCount);
+    for (uint32_t i = 0; i < packetCount; ++i) {
+        input[i].key = DrawQueue::makeKey(static_cast<uint8_t>(layer(random)), static_cast<uint16_t>(pipelineId(random)),
+            static_cast<uint16_t>(bindGroupId(random)), DrawQueue::sortableDepth(depth(random)));
+        input[i].payload = i;
+    }
+
+    constexpr int kRepetitions = 20;
+    std::vector<DrawPacket> packets, scratch;
+    double radixMs = 0.0, stdSortMs = 0.0;
+    for (int rep = 0; rep <= kRepetitions; ++rep) {
+        packets = input;
+        auto start = std::chrono::steady_clock::now();
+        DrawQueue::radixSort(packets, scratch);
+        auto stop = std::chrono::steady_clock::now();
+        // first run only warms up caches and the scratch allocation
+        if (rep > 0) radixMs += std::chrono::duration<double, std::milli>(stop - start).count();
+
+        packets = input;
+        start = std::chrono::steady_clock::now();
+        std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+        stop = std::chrono::steady_clock::now();
+        if (rep > 0) stdSortMs += std::chrono::duration<double, std::milli>(stop - start).count();
+    }
+    radixMs /= kRepetitions;
+    stdSortMs /= kRepetitions;
+    std::cout << "Sorting " << packetCount << " draw packets (average of " << kRepetitions << " runs)" << std::endl;
+    std::cout << "  radix sort: " << radixMs << " ms (" << radixMs * 1e6 / packetCount << " ns/packet)" << std::endl;
+    std::cout << "  std::sort:  " << stdSortMs << " ms (" << stdSortMs * 1e6 / packetCount << " ns/packet)" << std::endl;
+}
+
+void Application::ReportAllocatorCost(uint32_t allocationCount) {
+    // mesh sized requests, a few hundred bytes to 64 KiB of vertex data
+    std::mt19937 random(42);
+    std::uniform_int_distribution<uint64_t> meshSize(256, 64 << 10);
+    std::vector<uint64_t> sizes(allocationCount);
+    for (uint64_t& size : sizes) {
+        size = meshSize(random) & ~uint64_t(3);
+    }
+    using Clock = std::chrono::steady_clock;
+    auto elapsedUs = [](Clock::time_point start, Clock::time_point stop) {
+        return std::chrono::duration<double, std::micro>(stop - start).count();
+    };
+
+    // one buffer per mesh, accounted like the allocator's blocks so that both pay the same
+    std::vector<Buffer> buffers;
+    buffers.reserve(allocationCount);
+    BufferDescriptor bufferDesc = {};
+    bufferDesc.usage = BufferUsage::Vertex | BufferUsage::CopyDst;
+    bufferDesc.mappedAtCreation = false;
+    auto start = Clock::now();
+    for (uint64_t size : sizes) {
+        bufferDesc.size = size;
+        buffers.push_back(GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Mesh));
+    }
+    auto created = Clock::now();
+    for (Buffer& buffer : buffers) {
+        GpuMemory::untrack(buffer);
+        buffer.destroy();
+        buffer.release();
+    }
+    auto released = Clock::now();
+    buffers.clear();
+
+    // the same requests carved out of shared blocks, creating the blocks is part of the cost
+    GpuBufferAllocator allocator;
+    allocator.initialize(device);
+    std::vector<BufferAllocation> allocations;
+    allocations.reserve(allocationCount);
+    auto allocStart = Clock::now();
+    for (uint64_t size : sizes) {
+        allocations.push_back(allocator.allocate(BufferClass::Vertex, size));
+    }
+    double allocUs = elapsedUs(allocStart, Clock::now());
+    uint64_t allocCount = allocationCount;
+
+    // churn: free a random half and fill the holes with new sizes, like streaming meshes would
+    constexpr int kRounds = 8;
+    double freeUs = 0.0;
+    uint64_t freeCount = 0;
+    std::bernoulli_distribution coin(0.5);
+    for (int round = 0; round < kRounds; ++round) {
+        std::vector<size_t> freed;
+        auto freeStart = Clock::now();
+        for (size_t i = 0; i < allocations.size(); ++i) {
+            if (coin(random)) {
+                allocator.free(allocations[i]);
+                freed.push_back(i);
+            }
+        }
+        freeUs += elapsedUs(freeStart, Clock::now());
+        freeCount += freed.size();
+        for (size_t i : freed) {
+            sizes[i] = meshSize(random) & ~uint64_t(3);
+        }
+        allocStart = Clock::now();
+        for (size_t i : freed) {
+            allocations[i] = allocator.allocate(BufferClass::Vertex, sizes[i]);
+        }
+        allocUs += elapsedUs(allocStart, Clock::now());
+        allocCount += freed.size();
+    }
+
+    std::cout << "Allocating " << allocationCount << " vertex buffers of 256 B to 64 KiB" << std::endl;
+    std::cout << "  createBuffer:  " << elapsedUs(start, created) / allocationCount << " us/allocation, "
+        << elapsedUs(created, released) / allocationCount << " us/release, " << allocationCount << " GPU buffer(s)" << std::endl;
+    std::cout << "  sub-allocator: " << allocUs * 1000.0 / allocCount << " ns/allocation, "
+        << (freeCount ? freeUs * 1000.0 / freeCount : 0.0) << " ns/free over " << kRounds
+        << " rounds of freeing and refilling half, " << allocator.createdBuffers() << " GPU buffer(s)" << std::endl;
+    allocator.report(std::cout);
+
+    for (BufferAllocation& allocation : allocations) {
+        allocator.free(allocation);
+    }
+    allocator.terminate();
+}
+
+void Application::ReportStagingCost(uint32_t uploadCount) {
+    using Clock = std::chrono::steady_clock;
+    auto elapsedUs = [](Clock::time_point start, Clock::time_point stop) {
+        return std::chrono::duration<double, std::micro>(stop - start).count();
+    };
+    // every upload is submitted on its own, like one upload per frame
+    auto submitFrame = [this](CommandEncoder encoder, StagingBelt* belt) {
+        CommandBufferDescriptor cmdBufferDescriptor = {};
+        CommandBuffer command = encoder.finish(cmdBufferDescriptor);
+        encoder.release();
+        if (belt) belt->finish();
+        queue.submit(1, &command);
+        command.release();
+        if (belt) belt->recall();
+        PollDevice(false);
+    };
+    CommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.label = "Upload benchmark";
+
+    const uint64_t kSizes[] = { 4 << 10, 64 << 10, 1 << 20, 16 << 20 };
+    std::vector<uint8_t> data(kSizes[3]);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+    BufferDescriptor targetDesc = {};
+    targetDesc.label = "Upload target";
+    targetDesc.size = kSizes[3];
+    targetDesc.usage = BufferUsage::Vertex | BufferUsage::CopyDst;
+    targetDesc.mappedAtCreation = false;
+    Buffer target = GpuMemory::createBuffer(device, targetDesc, MemoryCategory::Mesh);
+
+    std::cout << "Uploading " << uploadCount << " time(s) per size, one submit each: CPU time per upload, "
+        << "throughput until the GPU is done" << std::endl;
+    for (uint64_t size : kSizes) {
+        double megabytes = static_cast<double>(size) * uploadCount / 1e6;
+
+        // the driver's staging
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < uploadCount; ++i) {
+            queue.writeBuffer(target, 0, data.data(), size);
+            submitFrame(device.createCommandEncoder(encoderDesc), nullptr);
+        }
+        double writeCpuUs = elapsedUs(start, Clock::now());
+        // totals only count once the GPU is done copying
+        WaitForQueue();
+        double writeTotalUs = elapsedUs(start, Clock::now());
+
+        // ours, a fresh belt so that creating its chunks is part of the cost
+        StagingBelt belt;
+        belt.initialize(device);
+        start = Clock::now();
+        for (uint32_t i = 0; i < uploadCount; ++i) {
+            CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+            belt.write(encoder, target, 0, data.data(), size);
+            submitFrame(encoder, &belt);
+        }
+        double beltCpuUs = elapsedUs(start, Clock::now());
+        WaitForQueue();
+        double beltTotalUs = elapsedUs(start, Clock::now());
+        uint64_t beltChunks = belt.createdChunks();
+        belt.terminate();
+
+        // one-off uploads into new buffers: writeBuffer against writing the mapped buffer itself
+        BufferDescriptor bufferDesc = targetDesc;
+        bufferDesc.size = size;
+        start = Clock::now();
+        for (uint32_t i = 0; i < uploadCount; ++i) {
+            Buffer buffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Mesh);
+            queue.writeBuffer(buffer, 0, data.data(), size);
+            GpuMemory::untrack(buffer);
+            buffer.destroy();
+            buffer.release();
+        }
+        double newWriteUs = elapsedUs(start, Clock::now());
+        bufferDesc.mappedAtCreation = true;
+        start = Clock::now();
+        for (uint32_t i = 0; i < uploadCount; ++i) {
+            Buffer buffer = GpuMemory::createBuffer(device, bufferDesc, MemoryCategory::Mesh);
+            std::memcpy(buffer.getMappedRange(0, size), data.data(), size);
+            buffer.unmap();
+            GpuMemory::untrack(buffer);
+            buffer.destroy();
+            buffer.release();
+        }
+        double newMappedUs = elapsedUs(start, Clock::now());
+        WaitForQueue();
+
+        std::cout << "  " << std::setw(5) << size / 1024 << " KiB: writeBuffer " << writeCpuUs / uploadCount << " us, "
+            << megabytes / (writeTotalUs * 1e-6) << " MB/s; staging belt " << beltCpuUs / uploadCount << " us, "
+            << megabytes / (beltTotalUs * 1e-6) << " MB/s, " << beltChunks << " chunk(s); new buffer: writeBuffer "
+            << newWriteUs / uploadCount << " us, mappedAtCreation " << newMappedUs / uploadCount << " us" << std::endl;
+    }
+    GpuMemory::untrack(target);
+    target.destroy();
+    target.release();
+}
+
+void Application::ReportTextureLoading(uint32_t textureCount) {
+    // generated 256x256 files, different contents so that nothing gets cached along the way
+    constexpr uint32_t kSize = 256;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "webgpu-texture-bench";
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::vector<std::filesystem::path> paths;
+    std::vector<uint8_t> pixels(4 * kSize * kSize);
+    for (uint32_t i = 0; i < textureCount; ++i) {
+        for (uint32_t texel = 0; texel < kSize * kSize; ++texel) {
+            uint32_t x = texel % kSize, y = texel / kSize;
+            pixels[4 * texel + 0] = static_cast<uint8_t>(x + i);
+            pixels[4 * texel + 1] = static_cast<uint8_t>(y * 3 + i);
+            pixels[4 * texel + 2] = static_cast<uint8_t>((x ^ y) + 7 * i);
+            pixels[4 * texel + 3] = 255;
+        }
+        paths.push_back(directory / ("texture_" + std::to_string(i) + ".tga"));
+        if (!ResourceManager::writeTga(paths.back(), kSize, kSize, pixels.data(), 4 * kSize)) {
+            std::cerr << "Could not write " << paths.back().string() << std::endl;
+            return;
+        }
+    }
+
+    // 1, 2, 4... decode threads, and all of them
+    std::vector<size_t> threadCounts;
+    size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads < hardwareThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardwareThreads);
+
+    std::cout << "Loading " << textureCount << " " << kSize << "x" << kSize << " TGA textures (decode overlapped with upload)" << std::endl;
+    double singleThreadMs = 0.0;
+    // one worker per decode thread, this one uploads; the same pool for every count
+    ThreadPool pool(hardwareThreads);
+    for (size_t threads : threadCounts) {
+        std::vector<LoadedTexture> textures = textureLoader.load(paths, pool, threads);
+        // the uploads are only done once the queue is
+        WaitForQueue();
+        TextureLoader::Stats stats = textureLoader.lastStats();
+        if (threads == 1) {
+            singleThreadMs = stats.wallMs;
+        }
+        std::cout << "  " << threads << " thread(s): " << stats.wallMs << " ms, " << stats.megabytesPerSecond()
+            << " MB/s, " << 1000.0 * stats.loaded / stats.wallMs << " textures/s (x" << singleThreadMs / stats.wallMs
+            << "), decode " << stats.decodeMs << " ms over all threads, upload " << stats.uploadMs << " ms";
+        if (stats.failed > 0) {
+            std::cout << ", " << stats.failed << " failed";
+        }
+        std::cout << std::endl;
+        for (LoadedTexture& texture : textures) {
+            TextureLoader::release(texture);
+        }
+    }
+    std::filesystem::remove_all(directory, error);
+}
+
+void Application::ReportMipmapCost(uint32_t size) {
+    using Clock = std::chrono::steady_clock;
+    constexpr uint32_t kRuns = 20;
+    // a power of two square, and an odd sized one (1537x1153 for 2048) that a 2x2 filter gets wrong
+    const uint32_t sizes[2][2] = { { size, size }, { size * 3 / 4 + 1, size * 9 / 16 + 1 } };
+
+    auto toLinear = [](double c) { return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4); };
+    auto toSrgb = [](double c) { return c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055; };
+
+    std::cout << "Mipmap generation, sRGB contents, " << kRuns << " runs each";
+    if (!gpuProfiler.isEnabled()) {
+        std::cout << " (no timestamp queries, wall time only)";
+    }
+    std::cout << std::endl;
+
+    for (const auto& extent : sizes) {
+        uint32_t width = extent[0], height = extent[1];
+        uint32_t levelCount = MipmapGenerator::mipLevelCount(width, height);
+        TextureFormat srgbFormat = TextureFormat::RGBA8UnormSrgb;
+        TextureDescriptor textureDesc = {};
+        textureDesc.label = "Mipmap benchmark";
+        textureDesc.dimension = TextureDimension::_2D;
+        textureDesc.size = { width, height, 1 };
+        textureDesc.format = TextureFormat::RGBA8Unorm;
+        textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::StorageBinding | TextureUsage::RenderAttachment
+            | TextureUsage::CopyDst | TextureUsage::CopySrc;
+        textureDesc.mipLevelCount = levelCount;
+        textureDesc.sampleCount = 1;
+        textureDesc.viewFormatCount = 1;
+        textureDesc.viewFormats = (WGPUTextureFormat*)&srgbFormat;
+        Texture texture = GpuMemory::createTexture(device, textureDesc, MemoryCategory::Texture);
+
+        // noise, so that a filter skipping texels shows in the average; mean taken in linear space
+        uint32_t bytesPerRow = (4 * width + 255) & ~255u;
+        std::vector<uint8_t> pixels(static_cast<size_t>(bytesPerRow) * height, 255);
+        std::mt19937 rng(width * 31 + height);
+        double mean[3] = { 0.0, 0.0, 0.0 };
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                uint8_t* texel = &pixels[static_cast<size_t>(y) * bytesPerRow + 4 * x];
+                for (int c = 0; c < 3; ++c) {
+                    // brighter on the last row and column, which a skipping filter tends to drop
+                    texel[c] = (x + 1 == width || y + 1 == height) ? 255 : static_cast<uint8_t>(rng() & 0xff);
+                    mean[c] += toLinear(texel[c] / 255.0);
+                }
+            }
+        }
+        ImageCopyTexture destination = {};
+        destination.texture = texture;
+        destination.mipLevel = 0;
+        destination.origin = { 0, 0, 0 };
+        destination.aspect = TextureAspect::All;
+        TextureDataLayout layout = {};
+        layout.offset = 0;
+        layout.bytesPerRow = bytesPerRow;
+        layout.rowsPerImage = height;
+        queue.writeTexture(destination, pixels.data(), pixels.size(), layout, textureDesc.size);
+
+        BufferDescriptor readbackDesc = {};
+        readbackDesc.label = "Mipmap benchmark readback";
+        readbackDesc.size = 256;
+        readbackDesc.usage = BufferUsage::CopyDst | BufferUsage::MapRead;
+        readbackDesc.mappedAtCreation = false;
+        Buffer readback = GpuMemory::createBuffer(device, readbackDesc, MemoryCategory::Readback);
+
+        double gpuMs[2] = { 0.0, 0.0 };
+        double wallMs[2] = { 0.0, 0.0 };
+        uint32_t gpuRuns[2] = { 0, 0 };
+        uint32_t steps[2] = { 0, 0 };
+        double error[2] = { 0.0, 0.0 };
+        for (int method = 0; method < 2; ++method) {
+            for (uint32_t run = 0; run < kRuns; ++run) {
+                CommandEncoderDescriptor encoderDesc = {};
+                encoderDesc.label = "Mipmap benchmark";
+                CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+                gpuProfiler.beginFrame();
+                steps[method] = method == 0
+                    ? mipmaps.generate(encoder, texture, width, height, levelCount, true, &gpuProfiler)
+                    : mipmaps.generateWithBlits(encoder, texture, levelCount, true, &gpuProfiler);
+                gpuProfiler.endFrame(encoder);
+                if (run + 1 == kRuns) {
+                    // the 1x1 level, against the true average
+                    ImageCopyTexture source = {};
+                    source.texture = texture;
+                    source.mipLevel = levelCount - 1;
+                    source.origin = { 0, 0, 0 };
+                    source.aspect = TextureAspect::All;
+                    ImageCopyBuffer target = {};
+                    target.buffer = readback;
+                    target.layout.offset = 0;
+                    target.layout.bytesPerRow = 256;
+                    target.layout.rowsPerImage = 1;
+                    Extent3D copySize;
+                    copySize.width = 1;
+                    copySize.height = 1;
+                    copySize.depthOrArrayLayers = 1;
+                    encoder.copyTextureToBuffer(source, target, copySize);
+                }
+                CommandBufferDescriptor cmdBufferDescriptor = {};
+                CommandBuffer command = encoder.finish(cmdBufferDescriptor);
+                encoder.release();
+                Clock::time_point start = Clock::now();
+                queue.submit(1, &command);
+                command.release();
+                gpuProfiler.afterSubmit();
+                WaitForQueue();
+                wallMs[method] += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                while (gpuProfiler.hasPendingReadback()) {
+                    PollDevice(true);
+                }
+                // the profiler stops at 16 passes per frame, only count complete frames
+                if (gpuProfiler.isEnabled() && gpuProfiler.lastFrameMs() >= 0.0 && (method == 0 || levelCount <= 17)) {
+                    gpuMs[method] += gpuProfiler.lastFrameMs();
+                    ++gpuRuns[method];
+                }
+            }
+
+            bool mapped = false;
+            auto mapCallback = readback.mapAsync(MapMode::Read, 0, 256, [&mapped](BufferMapAsyncStatus) { mapped = true; });
+            while (!mapped) {
+                PollDevice(true);
+            }
+            const uint8_t* texel = static_cast<const uint8_t*>(readback.getConstMappedRange(0, 256));
+            for (int c = 0; texel && c < 3; ++c) {
+                double expected = 255.0 * toSrgb(mean[c] / (static_cast<double>(width) * height));
+                error[method] = std::max(error[method], std::abs(texel[c] - expected));
+            }
+            readback.unmap();
+        }
+
+        std::cout << std::fixed << std::setprecision(3) << "  " << width << "x" << height << ", " << levelCount << " levels:" << std::endl;
+        const char* names[2] = { "compute", "blits  " };
+        const char* unit[2] = { " dispatch(es)", " pass(es)    " };
+        for (int method = 0; method < 2; ++method) {
+            std::cout << "    " << names[method] << " " << std::setw(2) << steps[method] << unit[method] << " ";
+            if (gpuRuns[method] > 0) {
+                std::cout << gpuMs[method] / gpuRuns[method] << " ms GPU, ";
+            }
+            std::cout << wallMs[method] / kRuns << " ms submit to done, 1x1 level off the true average by "
+                << std::setprecision(1) << error[method] << "/255" << std::setprecision(3) << std::endl;
+        }
+        if (gpuRuns[0] > 0 && gpuRuns[1] > 0) {
+            std::cout << "    compute is x" << (gpuMs[1] / gpuRuns[1]) / (gpuMs[0] / gpuRuns[0]) << " on GPU time" << std::endl;
+        }
+        std::cout << std::defaultfloat;
+
+        GpuMemory::untrack(readback);
+        readback.destroy();
+        readback.release();
+        GpuMemory::untrack(texture);
+        texture.destroy();
+        texture.release();
+    }
+}
+
+void Application::ReportTextureCompression(uint32_t size) {
+    using Clock = std::chrono::steady_clock;
+    // whole blocks, so that the device may take them as they are
+    size = std::max(4u, size & ~3u);
+
+    // gradients, noise and an alpha ramp, then its mips with a plain 2x2 average
+    std::vector<Image> chain(1);
+    chain.reserve(32); // keeps `base` valid while levels get added
+    Image& base = chain[0];
+    base.width = size;
+    base.height = size;
+    base.bytesPerRow = (4 * size + 255) & ~255u;
+    base.pixels.resize(static_cast<size_t>(base.bytesPerRow) * size);
+    std::mt19937 rng(size);
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            uint8_t* texel = &base.pixels[static_cast<size_t>(y) * base.bytesPerRow + 4 * x];
+            int noise = static_cast<int>(rng() % 17) - 8;
+            texel[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(255 * x / size) + noise, 0, 255));
+            texel[1] = static_cast<uint8_t>(std::clamp(static_cast<int>(255 * y / size) + noise, 0, 255));
+            texel[2] = static_cast<uint8_t>(std::clamp(128 + static_cast<int>(100 * std::sin(x * 0.05f) * std::cos(y * 0.07f)) + noise, 0, 255));
+            texel[3] = static_cast<uint8_t>(255 * (x + y) / (2 * size));
+        }
+    }
+    while (chain.back().width > 1 || chain.back().height > 1) {
+        const Image& source = chain.back();
+        Image level;
+        level.width = std::max(1u, source.width / 2);
+        level.height = std::max(1u, source.height / 2);
+        level.bytesPerRow = (4 * level.width + 255) & ~255u;
+        level.pixels.resize(static_cast<size_t>(level.bytesPerRow) * level.height);
+        for (uint32_t y = 0; y < level.height; ++y) {
+            for (uint32_t x = 0; x < level.width; ++x) {
+                for (int c = 0; c < 4; ++c) {
+                    uint32_t x1 = std::min(2 * x + 1, source.width - 1), y1 = std::min(2 * y + 1, source.height - 1);
+                    auto at = [&](uint32_t sx, uint32_t sy) { return source.pixels[static_cast<size_t>(sy) * source.bytesPerRow + 4 * sx + c]; };
+                    level.pixels[static_cast<size_t>(y) * level.bytesPerRow + 4 * x + c] =
+                        static_cast<uint8_t>((at(2 * x, 2 * y) + at(x1, 2 * y) + at(2 * x, y1) + at(x1, y1) + 2) / 4);
+                }
+            }
+        }
+        chain.push_back(std::move(level));
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "webgpu-compression-bench";
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    const TextureFormat formats[] = { TextureFormat::RGBA8UnormSrgb, TextureFormat::BC1RGBAUnormSrgb, TextureFormat::BC3RGBAUnormSrgb };
+    std::vector<std::filesystem::path> paths;
+    std::vector<double> encodeMs;
+    std::vector<double> errors; // RMS over RGB of level 0, in 8 bit steps
+    for (TextureFormat format : formats) {
+        Clock::time_point start = Clock::now();
+        CompressedImage file;
+        file.format = format;
+        file.width = size;
+        file.height = size;
+        uint32_t blockBytes = compressedBlockBytes(format);
+        std::vector<uint8_t> blocks;
+        for (const Image& level : chain) {
+            CompressedImage::Level info;
+            info.width = level.width;
+            info.height = level.height;
+            info.offset = file.data.size();
+            if (blockBytes == 0) {
+                info.bytesPerRow = level.bytesPerRow;
+                info.rows = level.height;
+                file.data.insert(file.data.end(), level.pixels.begin(), level.pixels.end());
+            }
+            else {
+                compressBlocks(format, level, blocks);
+                info.bytesPerRow = (level.width + 3) / 4 * blockBytes;
+                info.rows = (level.height + 3) / 4;
+                file.data.insert(file.data.end(), blocks.begin(), blocks.end());
+            }
+            info.size = file.data.size() - info.offset;
+            file.levels.push_back(info);
+        }
+        encodeMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+        double squares = 0.0;
+        Image decoded;
+        if (blockBytes > 0 && decompressBlocks(format, file.data.data(), file.levels[0].size, size, size, decoded)) {
+            for (uint32_t y = 0; y < size; ++y) {
+                for (uint32_t x = 0; x < size; ++x) {
+                    for (int c = 0; c < 3; ++c) {
+                        double difference = base.pixels[static_cast<size_t>(y) * base.bytesPerRow + 4 * x + c]
+                            - decoded.pixels[static_cast<size_t>(y) * decoded.bytesPerRow + 4 * x + c];
+                        squares += difference * difference;
+                    }
+                }
+            }
+        }
+        errors.push_back(std::sqrt(squares / (3.0 * size * size)));
+
+        paths.push_back(directory / (std::string(compressedFormatName(format)) + ".ktx2"));
+        if (!ResourceManager::writeKtx2(paths.back(), file)) {
+            std::cerr << "Could not write " << paths.back().string() << std::endl;
+            return;
+        }
+    }
+
+    std::cout << "Device texture compression: BC " << (textureCompression.bc ? "yes" : "no") << ", ETC2 "
+        << (textureCompression.etc2 ? "yes" : "no") << ", ASTC " << (textureCompression.astc ? "yes" : "no")
+        << (options.textureCompression ? "" : " (--no-compression)") << std::endl;
+    // the encoders' pool is idle outside of frames
+    std::vector<LoadedTexture> textures = textureLoader.load(paths, *threadPool);
+    WaitForQueue();
+
+    auto mib = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+    uint64_t rgba8Bytes = textures[0].bytes;
+    const TextureLoader::Stats& stats = textureLoader.lastStats();
+    std::cout << std::fixed << std::setprecision(2) << size << "x" << size << " with " << chain.size() << " levels, loaded in "
+        << stats.wallMs << " ms (" << mib(stats.storedBytes) << " MiB uploaded as stored, " << mib(stats.decodedBytes)
+        << " MiB decompressed):" << std::endl;
+    for (size_t i = 0; i < textures.size(); ++i) {
+        std::cout << "  " << std::left << std::setw(6) << compressedFormatName(formats[i]) << std::right;
+        if (!textures[i].isValid()) {
+            std::cout << "failed to load" << std::endl;
+            continue;
+        }
+        bool asBlocks = compressedBlockBytes(textures[i].format) > 0;
+        std::cout << std::setw(8) << mib(textures[i].bytes) << " MiB on the GPU";
+        if (i > 0) {
+            std::cout << (asBlocks ? " as blocks" : " decompressed on the CPU") << ", encoded in " << encodeMs[i]
+                << " ms, RMS error " << errors[i];
+            if (asBlocks && rgba8Bytes > 0) {
+                std::cout << ", " << mib(rgba8Bytes - textures[i].bytes) << " MiB saved (x"
+                    << static_cast<double>(rgba8Bytes) / textures[i].bytes << ")";
+            }
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::defaultfloat;
+    textureLoader.reportCompression(std::cout);
+
+    for (LoadedTexture& texture : textures) {
+        TextureLoader::release(texture);
+    }
+    std::filesystem::remove_all(directory, error);
+}
+
+TextureView Application::GetNextTargetView() {
+    if (options.headless) {
+        // a fresh view each frame keeps ownership the same as with surface views, MainLoop releases it
+        return wgpuTextureCreateView(offscreenTexture, nullptr);
+    }
+    return GetNextSurfaceTextureView();
+}
+
 TextureView Application::GetNextSurfaceTextureView() {
     SurfaceTexture surfaceTexture;
     // surface texture is not an object, but container for multiple returns
     // .status returns succes, .suboptimal might not issues, .texture is what we actually draw
     surface.getCurrentTexture(&surfaceTexture);
+
+    if (surfaceTexture.status == SurfaceGetCurrentTextureStatus::Outdated
+        || surfaceTexture.status == SurfaceGetCurrentTextureStatus::Lost) {
+        // swap chain no longer matches the window: reconfigure right away (no debounce, we can't draw
+        // otherwise) and try exactly once more. If that fails too we skip the frame instead of looping.
+#ifndef WEBGPU_BACKEND_WGPU
+        if (surfaceTexture.texture) wgpuTextureRelease(surfaceTexture.texture);
+#endif
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        ConfigureSurface(static_cast<uint32_t>(width), static_cast<uint32_t>(height), true);
+        if (surfaceConfig.width == 0 || surfaceConfig.height == 0) {
+            return nullptr;
+        }
+        surface.getCurrentTexture(&surfaceTexture);
+    }
+
     if (surfaceTexture.status != SurfaceGetCurrentTextureStatus::Success) {
+        // Timeout, OutOfMemory, DeviceLost or a second Outdated: drop this frame
+#ifndef WEBGPU_BACKEND_WGPU
+        if (surfaceTexture.texture) wgpuTextureRelease(surfaceTexture.texture);
+#endif
         return nullptr;
     }
+    if (surfaceTexture.suboptimal && !resizePending
+        && (surfaceConfig.width != suboptimalWidth || surfaceConfig.height != suboptimalHeight)) {
+        // still presentable, so let the debounced path pick up the new size. Forced, since the size
+        // may not have changed at all (rotation, another output...): if the surface is still
+        // suboptimal after that at this size, there is nothing better to do than present it as is
+        suboptimalWidth = surfaceConfig.width;
+        suboptimalHeight = surfaceConfig.height;
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        OnFramebufferResize(window, width, height);
+        resizeForced = true;
+    }
 
-    // texture view may represent a sub part of the texture. This stuff is all just copy pasted for now. 
+    // texture view may represent a sub part of the texture. Descriptor is filled once in ConfigureSurface
     Texture texture = surfaceTexture.texture;
-    TextureViewDescriptor viewDescriptor;
-    viewDescriptor.label = "Surface texture view";
-    viewDescriptor.format = texture.getFormat();
-    viewDescriptor.dimension = TextureViewDimension::_2D;
-    viewDescriptor.baseMipLevel = 0;
-    viewDescriptor.mipLevelCount = 1;
-    viewDescriptor.baseArrayLayer = 0;
-    viewDescriptor.arrayLayerCount = 1;
-    viewDescriptor.aspect = TextureAspect::All;
-    TextureView targetView = texture.createView(viewDescriptor);
+    TextureView targetView = texture.createView(surfaceViewDesc);
 
 #ifndef WEBGPU_BACKEND_WGPU
     wgpuTextureRelease(surfaceTexture.texture);
@@ -330,17 +2018,325 @@ TextureView Application::GetNextSurfaceTextureView() {
     return targetView;
 }
 
+void Application::ConfigureSurface(uint32_t width, uint32_t height, bool force) {
+    resizePending = false;
+    resizeForced = false;
+    if (!force && width == surfaceConfig.width && height == surfaceConfig.height) {
+        return;
+    }
+    surfaceConfig.width = width;
+    surfaceConfig.height = height;
+    if (width == 0 || height == 0) {
+        // minimized, a zero sized configuration is invalid so keep the old one until we come back
+        return;
+    }
+    surface.configure(surfaceConfig);
+
+    // the view never changes between frames of the same configuration
+    surfaceViewDesc.label = "Surface texture view";
+    surfaceViewDesc.format = surfaceFormat;
+    surfaceViewDesc.dimension = TextureViewDimension::_2D;
+    surfaceViewDesc.baseMipLevel = 0;
+    surfaceViewDesc.mipLevelCount = 1;
+    surfaceViewDesc.baseArrayLayer = 0;
+    surfaceViewDesc.arrayLayerCount = 1;
+    surfaceViewDesc.aspect = TextureAspect::All;
+
+    // only the ratio changes, pipelines and buffers are untouched
+    UpdateAspectRatio(width, height);
+    // size dependent targets and passes. Targets of the old size are not coming back
+    BuildFrameGraph(width, height);
+    texturePool.onResize(width, height);
+}
+
+void Application::UpdateAspectRatio(uint32_t width, uint32_t height) {
+    // Both dynamic slots need it
+    float ratio = static_cast<float>(width) / static_cast<float>(height);
+    queue.writeBuffer(uniformAllocation.buffer, uniformAllocation.offset + offsetof(MyUniforms, ratio), &ratio, sizeof(float));
+    queue.writeBuffer(uniformAllocation.buffer, uniformAllocation.offset + uniformStride + offsetof(MyUniforms, ratio), &ratio, sizeof(float));
+}
+
+void Application::InitializeOffscreenTarget(uint32_t width, uint32_t height) {
+    // same role as the surface texture, plus CopySrc / TextureBinding so frames can be read back
+    TextureDescriptor textureDesc = {};
+    textureDesc.label = "Offscreen target";
+    textureDesc.dimension = TextureDimension::_2D;
+    textureDesc.size = { width, height, 1 };
+    textureDesc.format = surfaceFormat;
+    textureDesc.mipLevelCount = 1;
+    textureDesc.sampleCount = 1;
+    textureDesc.usage = TextureUsage::RenderAttachment | TextureUsage::CopySrc | TextureUsage::TextureBinding;
+    textureDesc.viewFormatCount = 0;
+    textureDesc.viewFormats = nullptr;
+    offscreenTexture = GpuMemory::createTexture(device, textureDesc, MemoryCategory::RenderTarget);
+    offscreenSampleView = wgpuTextureCreateView(offscreenTexture, nullptr);
+
+    if (IsCapturing()) {
+        std::error_code error;
+        std::filesystem::create_directories(options.outputDir, error);
+    }
+
+    CaptureFormat capture = GetCaptureFormat();
+    if (IsCapturing() && capture == CaptureFormat::Rgba) {
+        // texture to buffer copies need rows aligned to 256 bytes
+        uint64_t frameSize = static_cast<uint64_t>(ceilToNextMultiple(4 * width, 256)) * height;
+        OpenSharedFrames(frameSize);
+        readbackRing.initialize(device, options.readbackSlots, frameSize, [this](const ReadbackFrame& frame) {
+            if (sharedFrames.isOpen()) {
+                sharedFrames.publish(frame.data, frame.size, frame.width, frame.height, frame.bytesPerRow, frame.height, SharedFrameFormat::Rgba8, frame.frameIndex);
+            }
+            // benchmarks measure the transfer, not PNG encoding
+            else if (!benchmark) SaveFrame(frame);
+        });
+    }
+    else if (IsCapturing()) {
+        YuvFormat yuvFormat = capture == CaptureFormat::Nv12 ? YuvFormat::NV12 : YuvFormat::I420;
+        // the offscreen target is sRGB, so the shader sees linear values and has to encode them again
+        if (!yuvConverter.initialize(device, width, height, yuvFormat, true)) {
+            exit(1);
+        }
+        OpenSharedFrames(yuvConverter.outputSize());
+        if (!benchmark && !sharedFrames.isOpen()) {
+            std::string path = options.captureOutput;
+            if (path.empty()) {
+                const char* name = yuvFormat == YuvFormat::NV12 ? "capture.nv12" : "capture.y4m";
+                path = (std::filesystem::path(options.outputDir) / name).string();
+            }
+            if (!yuvWriter.open(path, yuvFormat, width, height, 60)) {
+                std::cerr << "Could not open " << path << " for writing" << std::endl;
+                exit(1);
+            }
+        }
+        readbackRing.initialize(device, options.readbackSlots, yuvConverter.outputSize(), [this, yuvFormat](const ReadbackFrame& frame) {
+            if (sharedFrames.isOpen()) {
+                SharedFrameFormat format = yuvFormat == YuvFormat::NV12 ? SharedFrameFormat::Nv12 : SharedFrameFormat::I420;
+                sharedFrames.publish(frame.data, frame.size, frame.width, frame.height,
+                    YuvConverter::padWidth(frame.width), YuvConverter::padHeight(frame.height), format, frame.frameIndex);
+            }
+            else if (!benchmark) yuvWriter.write(frame);
+        });
+    }
+
+    UpdateAspectRatio(width, height);
+    BuildFrameGraph(width, height);
+}
+
+void Application::OpenSharedFrames(uint64_t frameSize) {
+    if (options.sharedMemory.empty()) {
+        return;
+    }
+    if (!sharedFrames.open(options.sharedMemory, options.sharedSlots, frameSize)) {
+        exit(1);
+    }
+    std::cout << "Publishing frames to shared memory " << options.sharedMemory << std::endl;
+}
+
+void Application::SaveFrame(const ReadbackFrame& frame) const {
+    std::ostringstream filename;
+    filename << "frame_" << std::setw(5) << std::setfill('0') << frame.frameIndex << ".png";
+    std::filesystem::path path = std::filesystem::path(options.outputDir) / filename.str();
+
+    if (!ResourceManager::writePng(path, frame.width, frame.height, frame.data, frame.bytesPerRow)) {
+        std::cerr << "Could not write " << path << std::endl;
+    }
+    if (options.overdraw) {
+        ReportOverdraw(frame);
+    }
+}
+
+void Application::ReportOverdraw(const ReadbackFrame& frame) const {
+    // fs_overdraw adds 1/16 of red per fragment, in linear space: undo the target's sRGB encoding
+    constexpr double kStepsPerUnit = 16.0;
+    uint64_t coveredPixels = 0;
+    uint64_t shadedFragments = 0;
+    uint32_t maxFragments = 0;
+    for (uint32_t y = 0; y < frame.height; ++y) {
+        const uint8_t* row = frame.data + static_cast<uint64_t>(y) * frame.bytesPerRow;
+        for (uint32_t x = 0; x < frame.width; ++x) {
+            uint8_t red = row[4 * x];
+            if (red == 0) continue;
+            double encoded = red / 255.0;
+            double linear = encoded <= 0.04045 ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+            uint32_t fragments = static_cast<uint32_t>(std::lround(linear * kStepsPerUnit));
+            ++coveredPixels;
+            shadedFragments += fragments;
+            maxFragments = std::max(maxFragments, fragments);
+        }
+    }
+    double average = coveredPixels > 0 ? static_cast<double>(shadedFragments) / coveredPixels : 0.0;
+    std::cout << "Frame " << frame.frameIndex << " overdraw: " << average << " fragment(s) shaded per covered pixel, max "
+        << maxFragments << " (saturates at 16), " << coveredPixels << " pixel(s) covered" << std::endl;
+}
+
+void Application::PollDevice(bool wait) {
+#if defined(WEBGPU_BACKEND_DAWN)
+    device.tick();
+    if (wait) {
+        // Dawn has no blocking poll, don't spin too hard
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+#elif defined(WEBGPU_BACKEND_WGPU)
+    wgpuDevicePoll(device, wait, nullptr);
+#else
+    (void)wait;
+#endif
+}
+
+void Application::WaitForQueue() {
+    bool done = false;
+    auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+    while (!done) {
+        PollDevice(true);
+    }
+}
+
+void Application::ApplyPendingResize() {
+    // During a live drag the framebuffer callback fires every few milliseconds. Reconfiguring on each
+    // event makes every frame pay for a swap chain rebuild, so wait until the size has settled.
+    // The compositor stretches the previous size meanwhile; Outdated is still handled immediately.
+    if (resizePending && glfwGetTime() - lastResizeEventTime >= kResizeDebounceSeconds) {
+        ConfigureSurface(pendingWidth, pendingHeight, resizeForced);
+    }
+}
+
+void Application::OnKey(GLFWwindow* window, int key, int /* scancode */, int action, int /* mods */) {
+    Application* that = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+    // P pauses and resumes the animation
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        that->SetAnimating(!that->animating);
+    }
+    // F9 dumps the CPU trace recorded so far, handy to catch a hitch while it happens
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS && Trace::isEnabled()) {
+        if (Trace::exportChromeJson(that->options.tracePath)) {
+            std::cout << "Wrote CPU trace to " << that->options.tracePath << std::endl;
+        }
+    }
+}
+
+void Application::OnFramebufferResize(GLFWwindow* window, int width, int height) {
+    // only record the request, reconfiguration happens in MainLoop
+    Application* that = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+    that->resizePending = true;
+    that->pendingWidth = static_cast<uint32_t>(width);
+    that->pendingHeight = static_cast<uint32_t>(height);
+    that->lastResizeEventTime = glfwGetTime();
+    // ApplyPendingResize needs a frame once the debounce delay is over, even if nothing else happens
+    that->ScheduleRedraw(kResizeDebounceSeconds);
+}
+
+void Application::OnWindowRefresh(GLFWwindow* window) {
+    // the window system lost our content (uncovered, restored...)
+    Application* that = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+    that->RequestRedraw();
+}
+
+bool Application::WantsFrame() {
+    // timers fire in any mode, resizes schedule some even when rendering continuously
+    if (!redrawTimers.empty()) {
+        double now = glfwGetTime();
+        auto due = std::remove_if(redrawTimers.begin(), redrawTimers.end(), [now](double deadline) {
+            return deadline <= now;
+        });
+        if (due != redrawTimers.end()) {
+            redrawTimers.erase(due, redrawTimers.end());
+            frameDirty = true;
+        }
+    }
+    // continuous mode, and benchmarks which need every frame
+    if (!options.onDemand || benchmark || animating) {
+        return true;
+    }
+    return frameDirty;
+}
+
+void Application::ScheduleRedraw(double delaySeconds) {
+    redrawTimers.push_back(glfwGetTime() + delaySeconds);
+}
+
+void Application::WaitForEvents() {
+    TRACE_SCOPE("wait events");
+    ++idleWaits;
+#ifndef __EMSCRIPTEN__
+    if (redrawTimers.empty()) {
+        glfwWaitEvents();
+    }
+    else {
+        double next = *std::min_element(redrawTimers.begin(), redrawTimers.end());
+        // a zero timeout would return right away and spin
+        glfwWaitEventsTimeout(std::max(next - glfwGetTime(), 0.001));
+    }
+#else
+    // the browser drives the loop, there is nothing to block on: just skip the frame
+    glfwPollEvents();
+#endif
+}
+
+void Application::SetAnimating(bool animate) {
+    animating = animate;
+    // a stopped simulation thread costs nothing while idle
+    simulation.setPaused(!animate);
+    RequestRedraw();
+}
+
 void Application::InitializePipeline() {
     ////////////// programmable stages
     std::cout << "Creating shader module…" << std::endl;
-    ShaderModule shaderModule = ResourceManager::loadShaderModule(RESOURCE_DIR "/shader.wgsl", device);
+    // source read by LoadAssets
+    startup.begin("shader module");
+    ShaderModule shaderModule = ResourceManager::createShaderModule(shaderSource, device);
+    startup.end("shader module");
     std::cout << "Shader Module: " << shaderModule << std::endl;
     
     if (shaderModule == nullptr) {
-        std::cerr << "Could not load shader" << std::endl;
+        std::cerr << "Could not create shader module" << std::endl;
         exit(1);
     }
 
+    /////////// Describe pipeline layout
+    // binding layouts: uniforms, then the scene texture and its sampler
+    std::vector<BindGroupLayoutEntry> bindingLayouts(3, Default);
+    BindGroupLayoutEntry& bindingLayout = bindingLayouts[0];
+    bindingLayout.binding = 0; // as used in @binding attribute in shader
+    bindingLayout.visibility = ShaderStage::Vertex | ShaderStage::Fragment; // stage that needs to access these resources
+    // fill out one of buffer, sampler + texture, storageTexture
+    bindingLayout.buffer.type = BufferBindingType::Uniform;
+    bindingLayout.buffer.minBindingSize = sizeof(MyUniforms);
+    // makes binding dynamic so that we can offset it between draw calls
+    bindingLayout.buffer.hasDynamicOffset = true;
+
+    BindGroupLayoutEntry& textureBindingLayout = bindingLayouts[1];
+    textureBindingLayout.binding = 1;
+    textureBindingLayout.visibility = ShaderStage::Fragment;
+    textureBindingLayout.texture.sampleType = TextureSampleType::Float;
+    textureBindingLayout.texture.viewDimension = TextureViewDimension::_2D;
+
+    BindGroupLayoutEntry& samplerBindingLayout = bindingLayouts[2];
+    samplerBindingLayout.binding = 2;
+    samplerBindingLayout.visibility = ShaderStage::Fragment;
+    samplerBindingLayout.sampler.type = SamplerBindingType::Filtering;
+
+    // Create a bind group layout
+    BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+    bindGroupLayoutDesc.entryCount = static_cast<uint32_t>(bindingLayouts.size());
+    bindGroupLayoutDesc.entries = bindingLayouts.data();
+    bindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
+
+    // create pipeline layout
+    PipelineLayoutDescriptor layoutDesc{};
+    layoutDesc.bindGroupLayoutCount = 1;
+    layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
+    layout = device.createPipelineLayout(layoutDesc);
+
+    // backends may compile the shader for real only here
+    StartupProfiler::Phase phase(startup, "pipelines");
+    pipeline = CreateScenePipeline(shaderModule, ScenePass::Color);
+    if (options.depth == DepthMode::Prepass) {
+        depthPrepassPipeline = CreateScenePipeline(shaderModule, ScenePass::DepthPrepass);
+    }
+    shaderModule.release();
+}
+
+RenderPipeline Application::CreateScenePipeline(ShaderModule shaderModule, ScenePass pass) {
     ////////// Specify vertex buffer layout
     VertexBufferLayout vertexBufferLayout;
     std::vector<VertexAttribute> vertexAttribs(2);
@@ -383,7 +2379,8 @@ void Application::InitializePipeline() {
     // fragment shader invoked for each fragment, receives interpolated values & output the final color of fragment
     FragmentState fragmentState;
 	fragmentState.module = shaderModule;
-	fragmentState.entryPoint = "fs_main";
+	// the heatmap shader counts fragments instead of coloring them
+	fragmentState.entryPoint = options.overdraw ? "fs_overdraw" : "fs_main";
 	fragmentState.constantCount = 0;
 	fragmentState.constants = nullptr;
 
@@ -397,6 +2394,11 @@ void Application::InitializePipeline() {
     blendState.alpha.srcFactor = BlendFactor::Zero;
     blendState.alpha.dstFactor = BlendFactor::One;
     blendState.alpha.operation = BlendOperation::Add;
+    if (options.overdraw) {
+        // heatmap: dst + src, so the red channel counts the fragments shaded on each pixel
+        blendState.color.srcFactor = BlendFactor::One;
+        blendState.color.dstFactor = BlendFactor::One;
+    }
 
     ColorTargetState colorTarget;
     colorTarget.format = surfaceFormat;
@@ -406,11 +2408,28 @@ void Application::InitializePipeline() {
     // one target (one output color attachment)
     fragmentState.targetCount = 1;
     fragmentState.targets = &colorTarget;
-    pipelineDesc.fragment = &fragmentState;
+    // the depth prepass only rasterizes, no fragment shader at all
+    pipelineDesc.fragment = pass == ScenePass::DepthPrepass ? nullptr : &fragmentState;
 
     // Describe stencil/depth pipeline state
-    // not used for now, used to discard fragments that are behind other fragments on the same pixel
-    pipelineDesc.depthStencil = nullptr;
+    // discards fragments that are behind other fragments on the same pixel
+    DepthStencilState depthStencilState = Default;
+    if (pass == ScenePass::DepthPrepass || options.depth == DepthMode::On) {
+        // keep the closest fragment, and remember its depth
+        depthStencilState.depthCompare = CompareFunction::Less;
+        depthStencilState.depthWriteEnabled = true;
+    }
+    else {
+        // color after a prepass: the depth buffer already holds the closest depth, only the
+        // fragment that produced it gets shaded
+        depthStencilState.depthCompare = CompareFunction::Equal;
+        depthStencilState.depthWriteEnabled = false;
+    }
+    depthStencilState.format = depthFormat;
+    // no stencil buffer
+    depthStencilState.stencilReadMask = 0;
+    depthStencilState.stencilWriteMask = 0;
+    pipelineDesc.depthStencil = options.depth == DepthMode::Off ? nullptr : &depthStencilState;
 
     // Describe multi-sampling pipeline state
     //can split pixels into sub-elements called samples , fragment assoc to sample. value of pixel calculated as average of samples
@@ -419,32 +2438,9 @@ void Application::InitializePipeline() {
     pipelineDesc.multisample.mask = ~0u; // all bits on
     pipelineDesc.multisample.alphaToCoverageEnabled = false; 
 
-    /////////// Describe pipeline layout
-    // binding layout
-    BindGroupLayoutEntry bindingLayout = Default;
-    bindingLayout.binding = 0; // as used in @binding attribute in shader
-    bindingLayout.visibility = ShaderStage::Vertex | ShaderStage::Fragment; // stage that needs to access these resources
-    // fill out one of buffer, sampler + texture, storageTexture
-    bindingLayout.buffer.type = BufferBindingType::Uniform;
-    bindingLayout.buffer.minBindingSize = sizeof(MyUniforms);
-    // makes binding dynamic so that we can offset it between draw calls
-    bindingLayout.buffer.hasDynamicOffset = true;
-
-    // Create a bind group layout
-    BindGroupLayoutDescriptor bindGroupLayoutDesc{};
-    bindGroupLayoutDesc.entryCount = 1;
-    bindGroupLayoutDesc.entries = &bindingLayout;
-    bindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
-
-    // create pipeline layout
-    PipelineLayoutDescriptor layoutDesc{};
-    layoutDesc.bindGroupLayoutCount = 1;
-    layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
-    layout = device.createPipelineLayout(layoutDesc);
     pipelineDesc.layout = layout; 
 
-    pipeline = device.createRenderPipeline(pipelineDesc);
-    shaderModule.release();
+    return device.createRenderPipeline(pipelineDesc);
 }
 
 RequiredLimits Application::GetRequiredLimits(Adapter adapter) {
@@ -456,13 +2452,14 @@ RequiredLimits Application::GetRequiredLimits(Adapter adapter) {
 
     requiredLimits.limits.maxVertexAttributes = 2; // position, color 
     requiredLimits.limits.maxVertexBuffers = 1;
-    requiredLimits.limits.maxBufferSize = 15 * 5 * sizeof(float); // 15 = num points, 5 = attributes per point
+    // was 15 * 5 * sizeof(float) for the points alone, readback and query buffers need much more
+    requiredLimits.limits.maxBufferSize = supportedLimits.limits.maxBufferSize;
     requiredLimits.limits.maxVertexBufferArrayStride = 5 * sizeof(float); 
-    // necessary for surface configuration
-    requiredLimits.limits.maxTextureDimension1D = 480;
-    requiredLimits.limits.maxTextureDimension2D = 640;
-    // max of 3 floats forwarded from vertex to fragment shader
-    requiredLimits.limits.maxInterStageShaderComponents = 3; 
+    // necessary for surface configuration -- window is resizable so ask for whatever the adapter can do
+    requiredLimits.limits.maxTextureDimension1D = supportedLimits.limits.maxTextureDimension1D;
+    requiredLimits.limits.maxTextureDimension2D = supportedLimits.limits.maxTextureDimension2D;
+    // max of 5 floats forwarded from vertex to fragment shader: color and texture coordinates
+    requiredLimits.limits.maxInterStageShaderComponents = 5; 
 
     requiredLimits.limits.maxBindGroups = 1; 
     requiredLimits.limits.maxUniformBuffersPerShaderStage = 1;
@@ -479,81 +2476,127 @@ RequiredLimits Application::GetRequiredLimits(Adapter adapter) {
 
     // Define the uniformstride variable while we're at it
     // stride must be rounded to closest multiple of minUniformBufferOffsetAlignment
-    uniformStride = ceilToNextMultiple((uint32_t)sizeof(MyUniforms), (uint32_t)requiredLimits.limits.minUniformBufferOffsetAlignment);
+    uniformAlignment = requiredLimits.limits.minUniformBufferOffsetAlignment;
+    uniformStride = ceilToNextMultiple((uint32_t)sizeof(MyUniforms), uniformAlignment);
 
     return requiredLimits;
 }
 
 void Application::InitializeBuffers() {
-    // de-duplicated point buffer
-    // coords are relative to window dimensions
-    std::vector<float> pointData;
-    // list of indices referencing positions in pointdata
-    std::vector<uint16_t> indexData;
-
-    // hardcording the file path here is an issue depending on the directory from which command is called
-    // Instead use auto generated path from cmake (alternatively could use command line arg), could switch to just being careful for distribution
-    // define RESOURCE_DIR "/home/me/code/myproject/resources"
-    bool success = ResourceManager::loadGeometry(RESOURCE_DIR "/webgpu.txt", pointData, indexData);
-    if (!success) {
-        std::cerr << "could not load geometry... " << std::endl;
-        exit(1);
-    }
-
+    // pointData: de-duplicated points, coords are relative to window dimensions
+    // indexData: list of indices referencing positions in pointdata
+    // both were read by LoadAssets
     indexCount = static_cast<uint32_t>(indexData.size());
+    // one createBuffer per usage class for all the meshes there will ever be, not one per mesh
+    bufferAllocator.initialize(device, 4 << 20, &lifetimes);
+    stagingBelt.initialize(device, 1 << 20, &lifetimes);
+    lifetimes.initialize(queue);
 	
-	// Create index buffer (GPU side)
-	BufferDescriptor bufferDesc;
-	bufferDesc.size = indexData.size() * sizeof(uint16_t);
+	// Index range (GPU side)
+	uint64_t indexSize = indexData.size() * sizeof(uint16_t);
     // write buffer must copy num bytes that is multiple of 4
-    bufferDesc.size = (bufferDesc.size + 3) & ~3; // round up to next multiple of 4
+    indexSize = (indexSize + 3) & ~3; // round up to next multiple of 4
     indexData.resize((indexData.size() + 1) & ~1);
-	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Index; // Index usage here!
-	bufferDesc.mappedAtCreation = false;
-	indexBuffer = device.createBuffer(bufferDesc);
-
-    // Upload index data to the buffer
-	queue.writeBuffer(indexBuffer, 0, indexData.data(), bufferDesc.size);
-
-    // point buffer
-    bufferDesc.size = pointData.size() * sizeof(float);
-    bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Vertex;
-    pointBuffer = device.createBuffer(bufferDesc);
-
-    // Upload vertex data to the buffer
-	queue.writeBuffer(pointBuffer, 0, pointData.data(), bufferDesc.size);
-
-    // uniform buffer
-    bufferDesc.size = uniformStride + sizeof(MyUniforms);
-    bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform; 
-    bufferDesc.mappedAtCreation = false;
-    uniformBuffer = device.createBuffer(bufferDesc);
+	indexAllocation = bufferAllocator.allocate(BufferClass::Index, indexSize);
+
+    // point range
+    uint64_t pointSize = pointData.size() * sizeof(float);
+    pointAllocation = bufferAllocator.allocate(BufferClass::Vertex, pointSize);
+
+    // Upload both through the belt: its first chunk is created mapped, so the data is written
+    // straight into GPU visible memory instead of going through writeBuffer's own staging copy
+    CommandEncoderDescriptor encoderDesc = {};
+    encoderDesc.label = "Initial upload";
+    CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+    stagingBelt.write(encoder, indexAllocation.buffer, indexAllocation.offset, indexData.data(), indexSize);
+    stagingBelt.write(encoder, pointAllocation.buffer, pointAllocation.offset, pointData.data(), pointSize);
+    CommandBufferDescriptor cmdBufferDescriptor = {};
+    CommandBuffer uploadCommand = encoder.finish(cmdBufferDescriptor);
+    encoder.release();
+    stagingBelt.finish();
+    queue.submit(1, &uploadCommand);
+    uploadCommand.release();
+    stagingBelt.recall();
+    lifetimes.onSubmit();
+    // uploaded, the CPU copies are not needed anymore
+    pointData = {};
+    indexData = {};
+
+    // uniform range, bound at its offset so it must be aligned like dynamic offsets are
+    uniformAllocation = bufferAllocator.allocate(BufferClass::Uniform, uniformStride + sizeof(MyUniforms), uniformAlignment);
 
     MyUniforms uniforms;
+    // ratio is written by ConfigureSurface
+    uniforms.ratio = 1.0f;
     // upload first value
     uniforms.time = 1.0f; 
     uniforms.color = { 0.0f, 1.0f, 0.4f, 1.0f };
-    queue.writeBuffer(uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
+    uniforms.depth = kDrawDepths[0];
+    queue.writeBuffer(uniformAllocation.buffer, uniformAllocation.offset, &uniforms, sizeof(MyUniforms));
 
     // upload second value -- nonzero offset
     uniforms.time = -1.0f; 
     uniforms.color = { 1.0f, 1.0f, 1.0f, 0.7f };
-    queue.writeBuffer(uniformBuffer, uniformStride, &uniforms, sizeof(MyUniforms));
+    uniforms.depth = kDrawDepths[1];
+    queue.writeBuffer(uniformAllocation.buffer, uniformAllocation.offset + uniformStride, &uniforms, sizeof(MyUniforms));
+}
+
+void Application::InitializeTextures() {
+    // without the generator textures still load, with a single level
+    bool hasMipmaps = mipmaps.initialize(device);
+    textureLoader.initialize(device, queue, hasMipmaps ? &mipmaps : nullptr, textureCompression);
+    if (!sceneCompressed.levels.empty()) {
+        sceneTexture = textureLoader.uploadCompressed(sceneCompressed, "Scene texture");
+        textureLoader.reportCompression(std::cout);
+        sceneCompressed = CompressedImage();
+    }
+    if (!sceneTexture.isValid() && sceneImage.pixels.empty()) {
+        // no --texture: one white texel leaves the scene's colors as they are
+        sceneImage.width = 1;
+        sceneImage.height = 1;
+        sceneImage.bytesPerRow = 256;
+        sceneImage.pixels.assign(sceneImage.bytesPerRow, 255);
+    }
+    if (!sceneTexture.isValid()) {
+        sceneTexture = textureLoader.upload(sceneImage, "Scene texture");
+    }
+    // uploaded, the CPU copy is not needed anymore
+    sceneImage = Image();
+
+    // the texture repeats over the scene
+    SamplerDescriptor samplerDesc;
+    samplerDesc.addressModeU = AddressMode::Repeat;
+    samplerDesc.addressModeV = AddressMode::Repeat;
+    samplerDesc.addressModeW = AddressMode::Repeat;
+    samplerDesc.magFilter = FilterMode::Linear;
+    samplerDesc.minFilter = FilterMode::Linear;
+    samplerDesc.mipmapFilter = MipmapFilterMode::Linear;
+    samplerDesc.lodMinClamp = 0.0f;
+    samplerDesc.lodMaxClamp = 32.0f;
+    samplerDesc.compare = CompareFunction::Undefined;
+    samplerDesc.maxAnisotropy = 1;
+    sceneSampler = device.createSampler(samplerDesc);
 }
 
 void Application::InitializeBindGroups() {
-    BindGroupEntry binding{};
+    std::vector<BindGroupEntry> bindings(3);
 
     // setup binding
+    BindGroupEntry& binding = bindings[0];
     binding.binding = 0; // index of binding
-    binding.buffer = uniformBuffer; // buffer it is bound to
-    binding.offset = 0; // offset to enable multiple block reads
+    binding.buffer = uniformAllocation.buffer; // buffer it is bound to
+    binding.offset = uniformAllocation.offset; // where our range starts in the shared block, dynamic offsets add to it
     binding.size = sizeof(MyUniforms);
 
+    bindings[1].binding = 1;
+    bindings[1].textureView = sceneTexture.view;
+    bindings[2].binding = 2;
+    bindings[2].sampler = sceneSampler;
+
     BindGroupDescriptor bindGroupDesc{};
     bindGroupDesc.layout = bindGroupLayout;
     // must be as many bindings as declared in render pipeline layout
-    bindGroupDesc.entryCount = 1;
-    bindGroupDesc.entries = &binding;
+    bindGroupDesc.entryCount = static_cast<uint32_t>(bindings.size());
+    bindGroupDesc.entries = bindings.data();
     bindGroup = device.createBindGroup(bindGroupDesc);
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+/**
+* The naive mip chain, kept to compare against mipmap.wgsl: one render pass per level, every
+* pixel samples the level above at its center with a linear filter. That is a 2x2 average for even
+* sizes, and skips texels for odd ones. sRGB goes through the views' formats.
+*/
+
+@group(0) @binding(0) var source: texture_2d<f32>;
+@group(0) @binding(1) var sourceSampler: sampler;
+
+struct VertexOutput {
+	@builtin(position) position: vec4f,
+	@location(0) uv: vec2f,
+};
+
+// one triangle covering the target, no vertex buffer
+@vertex
+fn vs_main(@builtin(vertex_index) index: u32) -> VertexOutput {
+	let corner = vec2f(f32((index << 1u) & 2u), f32(index & 2u));
+	var out: VertexOutput;
+	out.position = vec4f(corner * vec2f(2.0, -2.0) + vec2f(-1.0, 1.0), 0.0, 1.0);
+	out.uv = corner;
+	return out;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+	return textureSample(source, sourceSampler, in.uv);
+}
@@ -0,0 +1,111 @@
+/**
+* Mip chain generation. Each dispatch reads one level and writes up to four levels below it: a
+* workgroup of 8x8 threads writes an 8x8 tile of the first one, then keeps halving that tile in
+* workgroup memory for the 4x4, 2x2 and 1x1 texels of the next ones, without going back to the
+* texture. The host only chains a level when the one above it has an even size, so those are
+* exact 2x2 averages; the first level of a dispatch reads the texture and handles odd sizes with
+* 3 tap filters, so that every source texel weighs the same.
+*
+* Storage textures can't be sRGB: the texture is rgba8unorm and the shader decodes and encodes
+* sRGB itself, averaging in linear space.
+*/
+
+struct Params {
+	levelCount: u32, // levels written by this dispatch, 1 to 4
+	srgb: u32, // texels are sRGB encoded
+};
+
+@group(0) @binding(0) var source: texture_2d<f32>;
+@group(0) @binding(1) var out1: texture_storage_2d<rgba8unorm, write>;
+@group(0) @binding(2) var out2: texture_storage_2d<rgba8unorm, write>;
+@group(0) @binding(3) var out3: texture_storage_2d<rgba8unorm, write>;
+@group(0) @binding(4) var out4: texture_storage_2d<rgba8unorm, write>;
+@group(0) @binding(5) var<uniform> params: Params;
+
+// linear colors of the tile, the level being reduced keeps every `step`th texel
+var<workgroup> tile: array<vec4f, 64>;
+
+fn toLinear(color: vec4f) -> vec4f {
+	if (params.srgb == 0u) {
+		return color;
+	}
+	let rgb = select(pow((color.rgb + 0.055) / 1.055, vec3f(2.4)), color.rgb / 12.92, color.rgb <= vec3f(0.04045));
+	return vec4f(rgb, color.a);
+}
+
+fn toStored(color: vec4f) -> vec4f {
+	if (params.srgb == 0u) {
+		return color;
+	}
+	let rgb = select(1.055 * pow(color.rgb, vec3f(1.0 / 2.4)) - 0.055, color.rgb * 12.92, color.rgb <= vec3f(0.0031308));
+	return vec4f(rgb, color.a);
+}
+
+// weights of the source texels 2x, 2x + 1 and 2x + 2 under destination texel x, along one axis
+fn taps(x: u32, sourceSize: u32) -> vec3f {
+	if (sourceSize == 1u) {
+		return vec3f(1.0, 0.0, 0.0);
+	}
+	if ((sourceSize & 1u) == 0u) {
+		return vec3f(0.5, 0.5, 0.0);
+	}
+	// odd: the destination has n = size / 2 texels, each covers 2 + 1/n source texels
+	let n = f32(sourceSize / 2u);
+	let fx = f32(x);
+	return vec3f(n - fx, n, fx + 1.0) / (2.0 * n + 1.0);
+}
+
+fn store(level: u32, coords: vec2u, color: vec4f) {
+	let stored = toStored(color);
+	if (level == 2u) {
+		if (all(coords < textureDimensions(out2))) {
+			textureStore(out2, coords, stored);
+		}
+	}
+	else if (level == 3u) {
+		if (all(coords < textureDimensions(out3))) {
+			textureStore(out3, coords, stored);
+		}
+	}
+	else if (all(coords < textureDimensions(out4))) {
+		textureStore(out4, coords, stored);
+	}
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_main(@builtin(global_invocation_id) id: vec3u, @builtin(local_invocation_id) local: vec3u) {
+	let sourceSize = textureDimensions(source);
+	var color = vec4f(0.0);
+	if (all(id.xy < textureDimensions(out1))) {
+		let wx = taps(id.x, sourceSize.x);
+		let wy = taps(id.y, sourceSize.y);
+		let base = vec2i(id.xy * 2u);
+		let last = vec2i(sourceSize) - 1;
+		for (var j = 0; j < 3; j++) {
+			for (var i = 0; i < 3; i++) {
+				let weight = wx[i] * wy[j];
+				if (weight > 0.0) {
+					color += weight * toLinear(textureLoad(source, min(base + vec2i(i, j), last), 0));
+				}
+			}
+		}
+		textureStore(out1, id.xy, toStored(color));
+	}
+	tile[local.y * 8u + local.x] = color;
+
+	// each further level: threads on multiples of 2 * step average the 2x2 block of the level above
+	var step = 1u;
+	for (var level = 2u; level <= 4u; level++) {
+		workgroupBarrier();
+		if (level > params.levelCount) {
+			break;
+		}
+		if (local.x % (2u * step) == 0u && local.y % (2u * step) == 0u) {
+			let index = local.y * 8u + local.x;
+			let average = 0.25 * (tile[index] + tile[index + step] + tile[index + 8u * step] + tile[index + 9u * step]);
+			tile[index] = average;
+			store(level, id.xy / (2u * step), average);
+		}
+		step *= 2u;
+	}
+}
@@ -0,0 +1,103 @@
+/**
+* Converts the final color target to 4:2:0 YUV (BT.709, limited range) in a storage buffer, so that
+* reading frames back moves 1.5 bytes per pixel instead of 4.
+* Each invocation handles an 8x2 block of pixels: 4 words of luma (two per row) and 4 chroma pairs.
+* Sizes are padded to a multiple of 8 x 2 so that every write is a whole u32.
+*/
+
+struct Params {
+	width: u32, // source size
+	height: u32,
+	paddedWidth: u32, // width rounded up to 8, row stride of the luma plane
+	paddedHeight: u32, // height rounded up to 2
+	format: u32, // 0 = NV12 (interleaved UV plane), 1 = I420 (separate U and V planes)
+	srgbEncode: u32, // 1 when the source view decodes sRGB, so values must be encoded again
+	_pad0: u32,
+	_pad1: u32,
+};
+
+@group(0) @binding(0) var source: texture_2d<f32>;
+@group(0) @binding(1) var<storage, read_write> yuv: array<u32>;
+@group(0) @binding(2) var<uniform> params: Params;
+
+fn linearToSrgb(c: vec3f) -> vec3f {
+	let low = c * 12.92;
+	let high = 1.055 * pow(c, vec3f(1.0 / 2.4)) - 0.055;
+	return select(high, low, c <= vec3f(0.0031308));
+}
+
+// clamp to edge so that padding repeats the last row / column
+fn loadRgb(x: u32, y: u32) -> vec3f {
+	let coords = vec2u(min(x, params.width - 1u), min(y, params.height - 1u));
+	let rgb = textureLoad(source, coords, 0).rgb;
+	if (params.srgbEncode == 1u) {
+		return linearToSrgb(rgb);
+	}
+	return rgb;
+}
+
+fn luma(rgb: vec3f) -> f32 {
+	return dot(rgb, vec3f(0.2126, 0.7152, 0.0722));
+}
+
+fn toByte(v: f32) -> u32 {
+	return u32(clamp(round(v), 0.0, 255.0));
+}
+
+fn pack4(a: u32, b: u32, c: u32, d: u32) -> u32 {
+	return a | (b << 8u) | (c << 16u) | (d << 24u);
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_main(@builtin(global_invocation_id) id: vec3u) {
+	let bx = id.x * 8u;
+	let by = id.y * 2u;
+	if (bx >= params.paddedWidth || by >= params.paddedHeight) {
+		return;
+	}
+
+	var lumaBytes: array<u32, 16>;
+	var cb: array<u32, 4>;
+	var cr: array<u32, 4>;
+	for (var i = 0u; i < 4u; i++) {
+		// one 2x2 quad shares a chroma sample
+		let x = bx + 2u * i;
+		let p00 = loadRgb(x, by);
+		let p10 = loadRgb(x + 1u, by);
+		let p01 = loadRgb(x, by + 1u);
+		let p11 = loadRgb(x + 1u, by + 1u);
+		lumaBytes[2u * i] = toByte(16.0 + 219.0 * luma(p00));
+		lumaBytes[2u * i + 1u] = toByte(16.0 + 219.0 * luma(p10));
+		lumaBytes[8u + 2u * i] = toByte(16.0 + 219.0 * luma(p01));
+		lumaBytes[8u + 2u * i + 1u] = toByte(16.0 + 219.0 * luma(p11));
+
+		let avg = 0.25 * (p00 + p10 + p01 + p11);
+		let y = luma(avg);
+		cb[i] = toByte(128.0 + 224.0 * (avg.b - y) / 1.8556);
+		cr[i] = toByte(128.0 + 224.0 * (avg.r - y) / 1.5748);
+	}
+
+	// luma plane, two rows of 8 bytes
+	let row0 = (by * params.paddedWidth + bx) / 4u;
+	let row1 = row0 + params.paddedWidth / 4u;
+	yuv[row0] = pack4(lumaBytes[0], lumaBytes[1], lumaBytes[2], lumaBytes[3]);
+	yuv[row0 + 1u] = pack4(lumaBytes[4], lumaBytes[5], lumaBytes[6], lumaBytes[7]);
+	yuv[row1] = pack4(lumaBytes[8], lumaBytes[9], lumaBytes[10], lumaBytes[11]);
+	yuv[row1 + 1u] = pack4(lumaBytes[12], lumaBytes[13], lumaBytes[14], lumaBytes[15]);
+
+	let lumaSize = params.paddedWidth * params.paddedHeight;
+	let chromaRow = by / 2u;
+	if (params.format == 0u) {
+		// NV12: one plane of U,V pairs, same stride as luma
+		let uv = (lumaSize + chromaRow * params.paddedWidth + bx) / 4u;
+		yuv[uv] = pack4(cb[0], cr[0], cb[1], cr[1]);
+		yuv[uv + 1u] = pack4(cb[2], cr[2], cb[3], cr[3]);
+	} else {
+		// I420: U plane then V plane, half the luma stride
+		let chromaStride = params.paddedWidth / 2u;
+		let chromaSize = chromaStride * (params.paddedHeight / 2u);
+		let offset = chromaRow * chromaStride + bx / 2u;
+		yuv[(lumaSize + offset) / 4u] = pack4(cb[0], cb[1], cb[2], cb[3]);
+		yuv[(lumaSize + chromaSize + offset) / 4u] = pack4(cr[0], cr[1], cr[2], cr[3]);
+	}
+}
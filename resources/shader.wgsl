@@ -11,15 +11,20 @@ struct VertexInput {
 
 /* struct w fields labeled as builtins, locations used as output of vertex shader (thus input of fragment shader) */
 struct VertexOutput {
-	@builtin(position) position: vec4f,
+	// invariant: the depth prepass and the color pass must compute bit identical depths for the Equal test
+	@builtin(position) @invariant position: vec4f,
 	// The location here does not refer to a vertex attribute, it just means that this field must be handled by the rasterizer.
 	@location(0) color: vec3f,
+	// the geometry has no texture coordinates, the texture is mapped along x and y
+	@location(1) uv: vec2f,
 };
 
 /** structure holding uniform values */
 struct MyUniforms {
 	color: vec4f,
 	time: f32, 
+	ratio: f32, // width / height of target surface, updated on resize
+	depth: f32, // depth of the whole draw in [0, 1), smaller is closer
 };
 
 // simple uniform declaration. 
@@ -27,16 +32,21 @@ struct MyUniforms {
 // binding(0) is the buffer to which uTime is bound
 // group defines the binding group & thus also about memory location
 @group(0) @binding(0) var<uniform> uMyUniforms: MyUniforms; 
+// loaded with --texture, 1x1 white otherwise. sRGB: samples come out linear
+@group(0) @binding(1) var sceneTexture: texture_2d<f32>;
+@group(0) @binding(2) var sceneSampler: sampler;
 
 @vertex
 fn vs_main(in: VertexInput) -> VertexOutput {
 	var out: VertexOutput; 
-    let ratio = 640.0 / 480.0; // width & height of target surface. Fixes incorrect ratio
+    let ratio = uMyUniforms.ratio; // width & height of target surface. Fixes incorrect ratio
 	var offset = vec2f(-0.6875, -0.463); // offset
 	// move scene depending on uTime
 	offset += 0.3 * vec2f(cos(uMyUniforms.time), sin(uMyUniforms.time));
-	out.position = vec4f(in.position.x + offset.x, (in.position.y + offset.y) * ratio, 0.0, 1.0); 
+	out.position = vec4f(in.position.x + offset.x, (in.position.y + offset.y) * ratio, uMyUniforms.depth, 1.0); 
 	out.color = in.color; // forward the color attribute to the fragment shader
+	// y down in textures, up in the scene
+	out.uv = vec2f(in.position.x, -in.position.y);
 	return out;
 }
 
@@ -46,5 +56,14 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f {
 	// applying a gamma correction to the color
 	// converting input sRGB color to linear before the target surface converts back to sRGB
 	let linear_color = pow(color, vec3f(2.2));
-	return vec4f(linear_color, 1.0); // use the interpolated color coming from the vertex shader
+	let texel = textureSample(sceneTexture, sceneSampler, in.uv).rgb;
+	return vec4f(linear_color * texel, 1.0); // use the interpolated color coming from the vertex shader
+}
+
+// overdraw heatmap: every shaded fragment adds one step of red, blended additively
+const OVERDRAW_STEP: f32 = 1.0 / 16.0;
+
+@fragment
+fn fs_overdraw(in: VertexOutput) -> @location(0) vec4f {
+	return vec4f(OVERDRAW_STEP, 0.0, 0.0, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+/**
+* Stretches the dynamic resolution scene target over the whole surface with bilinear filtering.
+* The scene is rendered into the top left corner of a target sized for the largest scale, `uvScale`
+* is the fraction of it that the current scale covers.
+*/
+
+struct Params {
+	uvScale: vec2f,
+	// last texel centers of the rendered area: filtering must not reach past it into stale pixels
+	uvMax: vec2f,
+};
+
+@group(0) @binding(0) var source: texture_2d<f32>;
+@group(0) @binding(1) var sourceSampler: sampler;
+@group(0) @binding(2) var<uniform> params: Params;
+
+struct VertexOutput {
+	@builtin(position) position: vec4f,
+	@location(0) uv: vec2f,
+};
+
+// one triangle covering the screen, no vertex buffer
+@vertex
+fn vs_main(@builtin(vertex_index) index: u32) -> VertexOutput {
+	let corner = vec2f(f32((index << 1u) & 2u), f32(index & 2u));
+	var out: VertexOutput;
+	out.position = vec4f(corner * vec2f(2.0, -2.0) + vec2f(-1.0, 1.0), 0.0, 1.0);
+	out.uv = corner * params.uvScale;
+	return out;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+	return textureSample(source, sourceSampler, min(in.uv, params.uvMax));
+}
@@ -0,0 +1,5 @@
+// stb_image_write.c
+// Implementation of the single header PNG writer vendored with glfw. Compiled as C since the
+// header relies on C initialization rules that trip our C++ warnings.
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
@@ -0,0 +1,132 @@
+// shm_consumer.cpp
+// Reference consumer for `App --headless --shm NAME`: reads frames in place from the shared
+// memory ring, and reports delivery latency and throughput.
+//
+//   shm_consumer NAME [--frames N] [--hold-ms MS] [--json PATH]
+//
+// --hold-ms keeps each frame that long before releasing it, to see how the App behaves with a
+// slow consumer (it drops frames rather than waiting).
+#include "SharedFrameRing.h"
+#include "Stats.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage(const char* program) {
+	std::cerr << "Usage: " << program << " NAME [options]\n"
+		<< "  --frames N     stop after N frames (default: until the App exits)\n"
+		<< "  --hold-ms MS   keep each frame MS milliseconds before releasing it\n"
+		<< "  --json PATH    write the report as JSON to PATH\n";
+}
+
+// Read every cache line of the frame, standing for whatever a real consumer would do with it
+uint64_t touch(const uint8_t* pixels, uint64_t size) {
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < size; i += 64) {
+		sum += pixels[i];
+	}
+	return sum;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	std::string name = argv[1];
+	uint64_t maxFrames = 0;
+	uint32_t holdMs = 0;
+	std::string jsonPath;
+	for (int i = 2; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc) {
+			maxFrames = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--hold-ms" && i + 1 < argc) {
+			holdMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (arg == "--json" && i + 1 < argc) {
+			jsonPath = argv[++i];
+		}
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	// the App may not have created the ring yet
+	SharedFrameReader reader;
+	auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	while (!reader.open(name)) {
+		if (std::chrono::steady_clock::now() > giveUp) {
+			std::cerr << "No frame ring named " << name << std::endl;
+			return 1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	const SharedFrameHeader* info = reader.info();
+	std::cout << "Attached to " << name << ": " << info->slotCount << " slots of "
+		<< info->slotSize << " bytes" << std::endl;
+
+	std::vector<double> latencyMs;
+	uint64_t frames = 0;
+	uint64_t bytes = 0;
+	uint64_t checksum = 0;
+	uint64_t firstDropped = info->dropped.load();
+	std::chrono::steady_clock::time_point first, last;
+
+	SharedFrameView frame;
+	while (maxFrames == 0 || frames < maxFrames) {
+		if (!reader.acquire(frame, 1000)) {
+			if (reader.writerClosed()) break;
+			continue; // nothing for a second, keep waiting
+		}
+		uint64_t now = sharedFrameClockNs();
+		latencyMs.push_back(static_cast<double>(now - frame.slot->publishTimeNs) * 1e-6);
+		checksum += touch(frame.pixels, frame.slot->size);
+		if (holdMs > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(holdMs));
+		}
+		last = std::chrono::steady_clock::now();
+		if (frames == 0) first = last;
+		++frames;
+		bytes += frame.slot->size;
+		reader.release(frame);
+	}
+	uint64_t dropped = info->dropped.load() - firstDropped;
+	// throughput over the span between the first and the last frame, so the wait for the App to
+	// start does not count
+	double seconds = std::chrono::duration<double>(last - first).count();
+	double fps = frames > 1 && seconds > 0.0 ? static_cast<double>(frames - 1) / seconds : 0.0;
+	double mbPerS = frames > 1 && seconds > 0.0 ? static_cast<double>(bytes) * (frames - 1) / frames / seconds / 1e6 : 0.0;
+	Summary latency = Summary::of(latencyMs);
+
+	std::cout << "Received " << frames << " frame(s), writer dropped " << dropped << "\n"
+		<< "  " << fps << " frames/s, " << mbPerS << " MB/s\n"
+		<< "  publish to acquire latency: p50 " << latency.p50 << " ms, p99 " << latency.p99
+		<< " ms, max " << latency.max << " ms\n"
+		<< "  (checksum " << checksum << ")" << std::endl;
+
+	if (!jsonPath.empty()) {
+		std::ofstream out(jsonPath);
+		out << "{\n"
+			<< "  \"frames\": " << frames << ",\n"
+			<< "  \"writer_dropped\": " << dropped << ",\n"
+			<< "  \"frames_per_s\": " << fps << ",\n"
+			<< "  \"mb_per_s\": " << mbPerS << ",\n"
+			<< "  \"latency_ms\": ";
+		latency.writeJson(out);
+		out << "\n}\n";
+	}
+	return 0;
+}